@@ -1,40 +1,233 @@
 #include "FFME.h"
 #include "miscellaneous.h"
+#include <limits.h>
+
+
+/* Creation of a luma view.
+   Inputs:
+   -data: first pixel of the unsigned 8 bit luma plane.
+   -width: width in pixels.
+   -height: height in pixels.
+   -stride: bytes between the beginning of consecutive rows.
+   Outputs: luma view.
+*/
+FFMELumaView lumaView(unsigned char* data, int width, int height, int stride)
+{
+	FFMELumaView luma;
+	luma.data = data;
+	luma.width = width;
+	luma.height = height;
+	luma.stride = stride;
+	return luma;
+}
+
+
+/* Luma view of the Y plane of a NV12 or I420 buffer. In both formats the full resolution Y plane is stored first, and
+   the chroma planes are not used.
+   Inputs:
+   -buffer: beginning of the NV12 or I420 buffer.
+   -width: width in pixels.
+   -height: height in pixels.
+   -strideY: bytes between the beginning of consecutive rows of the Y plane.
+   Outputs: luma view.
+*/
+FFMELumaView lumaViewYUV420(unsigned char* buffer, int width, int height, int strideY)
+{
+	return lumaView(buffer, width, height, strideY);
+}
+
+
+/* Creation of a list of correspondences. All the arrays are reserved in a single contiguous block.
+   Inputs:
+   -maxNoCorr: maximum number of correspondences that can be stored.
+   Outputs: list of correspondences.
+*/
+FFMECorrList* createCorrList(int maxNoCorr)
+{
+	FFMECorrList* corrList = (FFMECorrList*)cvAlloc(sizeof(FFMECorrList));
+	corrList->idx1 = (int*)cvAlloc(maxNoCorr * (2*sizeof(int) + 2*sizeof(float)));
+	corrList->idx2 = corrList->idx1 + maxNoCorr;
+	corrList->dist1 = (float*)(corrList->idx2 + maxNoCorr);
+	corrList->dist2 = corrList->dist1 + maxNoCorr;
+	corrList->noCorr = 0;
+	corrList->maxNoCorr = maxNoCorr;
+	return corrList;
+}
+
+
+/* Release of a list of correspondences.
+   Inputs:
+   -corrList: (input/output) list of correspondences. It is set to NULL.
+   Outputs: --
+*/
+void releaseCorrList(FFMECorrList** corrList)
+{
+	if(*corrList)
+	{
+		cvFree(&((*corrList)->idx1));
+		cvFree(corrList);
+	}
+}
+
+
+/* Creation of a match result. All the arrays are reserved in a single contiguous block.
+   Inputs:
+   -maxNoQueries: maximum number of singular points of the first image that can be stored.
+   Outputs: match result.
+*/
+FFMEMatchResult* createMatchResult(int maxNoQueries)
+{
+	FFMEMatchResult* matchResult = (FFMEMatchResult*)cvAlloc(sizeof(FFMEMatchResult));
+	matchResult->idx1 = (int*)cvAlloc(maxNoQueries * (2*sizeof(int) + 2*sizeof(float) + sizeof(CvPoint2D32f)));
+	matchResult->idx2 = matchResult->idx1 + maxNoQueries;
+	matchResult->dist1 = (float*)(matchResult->idx2 + maxNoQueries);
+	matchResult->dist2 = matchResult->dist1 + maxNoQueries;
+	matchResult->predPtos = (CvPoint2D32f*)(matchResult->dist2 + maxNoQueries);
+	matchResult->noQueries = 0;
+	matchResult->maxNoQueries = maxNoQueries;
+	return matchResult;
+}
+
+
+/* Release of a match result.
+   Inputs:
+   -matchResult: (input/output) match result. It is set to NULL.
+   Outputs: --
+*/
+void releaseMatchResult(FFMEMatchResult** matchResult)
+{
+	if(*matchResult)
+	{
+		cvFree(&((*matchResult)->idx1));
+		cvFree(matchResult);
+	}
+}
+
+
+/* Coordinates of the points of a list of correspondences.
+   Inputs:
+   -corrList: list of correspondences.
+   -singPtos1: array of locations related to the singular points in the first image.
+   -singPtos2: array of locations related to the singular points in the second image.
+   -ptos1: (input/output) array of locations of the points of the first image of each correspondence. It can be NULL.
+    The function doesn't reserve memory.
+   -ptos2: (input/output) array of locations of the points of the second image of each correspondence. It can be NULL.
+    The function doesn't reserve memory.
+   Outputs: --
+*/
+void getCorrPtos(FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, CvPoint2D32f* ptos1, CvPoint2D32f* ptos2)
+{
+	int i;
+	for(i=0;i<corrList->noCorr;i++)
+	{
+		if(ptos1)
+		{
+			ptos1[i] = singPtos1[corrList->idx1[i]];
+		}
+		if(ptos2)
+		{
+			ptos2[i] = singPtos2[corrList->idx2[i]];
+		}
+	}
+}
 
 
 FFME::FFME(void)
 {
+	m_engine = 0;
+	m_ownEngine = false;
+	m_matchOnly = false;
+	m_horGradient_S161C = 0;
+	m_verGradient_S161C = 0;
+	m_magGradient_32F1C = 0;
+	m_phaseGradient_32F1C = 0;
+	m_cornerness_32F1C = 0;
+	m_decimated_U81C = 0;
+	m_decimation = DECIMATION;
+	m_width = 0;
+	m_height = 0;
+	m_origin = 0;
+	m_maxNoKeyPoints = 0;
+	m_LutMagGradient = 0;
+	m_LutPhaseGradient = 0;
+	m_LutAtanInt = 0;
+	m_ptosGrad = 0;
+	m_ptosCornerness = 0;
+	m_noPtosGrad = 0;
+	m_noPtosCornerness = 0;
+	m_capCandidates = 0;
+	m_idxBest1 = 0;
+	m_idxBest2 = 0;
+	m_minDist1Best1 = 0;
+	m_minDist2Best1 = 0;
+	m_minDist1Best2 = 0;
+	m_minDist2Best2 = 0;
+	m_gridPrior = 0;
+	m_noVectGridPrior = 0;
+	m_capWidth = 0;
+	m_capHeight = 0;
+	m_capNoKeyPoints = 0;
+	m_capNoCellsGrid = 0;
+	m_weightsDescInt = 0;
+	m_capWeightsDescInt = 0;
+	m_histDescInt = 0;
+	m_capHistDescInt = 0;
+	m_cornernessBand = 0;
+	m_capCornernessBand = 0;
+	m_noPreFilterTested = 0;
+	m_noPreFilterRejected = 0;
+	m_noPreFilterFalseRej = 0;
+	m_tilesGradient = false;
+	m_levelTiles = 0;
+	m_runsTiles = 0;
+	m_noRunsTiles = 0;
+	m_minMaxTiles = 0;
+	m_capTiles = 0;
+	m_capMinMaxTiles = 0;
+	m_noTiles = 0;
+	m_noTilesFlat = 0;
+	m_noTilesSkipped = 0;
+	STATS_CODE_M(m_noMatchedStats = 0);
 }
 
 FFME::~FFME(void)
 {
-	int i;
-	int noElem = 255*8+1; //Range of possible values for the gradient calculated using a Sobel mask.
-	
 	//Release memory.
 	cvReleaseImage(&m_horGradient_S161C);
 	cvReleaseImage(&m_verGradient_S161C);
 	cvReleaseImage(&m_magGradient_32F1C);
 	cvReleaseImage(&m_phaseGradient_32F1C);
 	cvReleaseImage(&m_cornerness_32F1C);
+	cvReleaseImage(&m_decimated_U81C);
 	cvFree(&m_ptosGrad);
 	cvFree(&m_ptosCornerness);
-
-    //Release LUTs memory.
-	for(i=0;i<noElem;i++)
-	{
-		cvFree(&(m_LutMagGradient[i]));
-	}
-	cvFree(&m_LutMagGradient);
-	for(i=0;i<noElem;i++)
+	cvFree(&m_idxBest1);
+	cvFree(&m_idxBest2);
+	cvFree(&m_minDist1Best1);
+	cvFree(&m_minDist2Best1);
+	cvFree(&m_minDist1Best2);
+	cvFree(&m_minDist2Best2);
+	cvFree(&m_gridPrior);
+	cvFree(&m_noVectGridPrior);
+	cvFree(&m_weightsDescInt);
+	cvFree(&m_histDescInt);
+	cvFree(&m_cornernessBand);
+	cvFree(&m_levelTiles);
+	cvFree(&m_runsTiles);
+	cvFree(&m_noRunsTiles);
+	cvFree(&m_minMaxTiles);
+
+	//The engine is only released if it is private.
+	if(m_ownEngine)
 	{
-		cvFree(&(m_LutPhaseGradient[i]));
+		delete m_engine;
 	}
-	cvFree(&m_LutPhaseGradient);
 }
 
 
-/* Initialization of memory and look-up tables.
+/* Initialization of memory and look-up tables. The object creates its own engine (configuration and look-up tables).
+   It can be called again: the private engine (look-up tables) is kept, the configuration is reset to the default
+   one, and the memory is reused if it is big enough.
    Inputs:
    -width: image width.
    -height: image height.
@@ -44,80 +237,215 @@ FFME::~FFME(void)
 */
 void FFME::iniFFME(int width, int height, int origin, int maxNoKeyPoints)
 {
-	int i,j;
-	int noElem = 255*8+1; //Maximum value for the gradient calculated by means of a Sobel mask.
-	int shift = -255*4; 
- 
-
-	m_maxNoKeyPoints = maxNoKeyPoints;
-	m_widthArrayHist = WIDTH_ARRAY_HIST;
-	m_widthSubWinHist = WIDTH_SUBWIN_HIST;
-	m_noBinsOriHist = NO_BINS_ORI_HIST;
-	m_maxRespCompDesc = (float)MAX_RESP_COMP_DESC;
-	m_threshGradMag = THRESH_GRAD_MAG;
-	m_threshHarris = THRESH_HARRIS;
-	m_widthWinHarris = WIDTH_WIN_HARRIS;
-	m_widthWinNonMaxSup = WIDTH_WIN_NONMAXSUP;
-	m_threshRatSecBest = (float)THRESH_RATIO_SECOND_BEST_CORR;
-	m_radMaxSearch = RAD_MAX_SEARCH;
-	
-
-	//Memory reserving for images.
-	m_horGradient_S161C = cvCreateImage(cvSize(width, height), IPL_DEPTH_16S,1);
-	m_horGradient_S161C->origin = origin;
-	m_verGradient_S161C = cvCreateImage(cvSize(width, height), IPL_DEPTH_16S,1);
-	m_verGradient_S161C->origin = origin;
-	m_magGradient_32F1C = cvCreateImage(cvSize(width, height), IPL_DEPTH_32F,1);
-	m_magGradient_32F1C->origin = origin;
-	m_phaseGradient_32F1C = cvCreateImage(cvSize(width, height), IPL_DEPTH_32F,1);
-	m_phaseGradient_32F1C->origin = origin;
-	m_cornerness_32F1C = cvCreateImage(cvSize(width, height), IPL_DEPTH_32F,1);
-	m_cornerness_32F1C->origin = origin;
+	FFMEEngine* engine = m_engine;
+	if(!m_ownEngine)
+	{
+		engine = new FFMEEngine;
+		engine->iniEngine();
+	}
+	m_ownEngine = false; //The engine is not released by the next call.
+	iniFFME(engine, width, height, origin, maxNoKeyPoints);
+	m_ownEngine = true;
+}
 
 
-	//Gradient magnitude look-up table.
-	m_LutMagGradient = (float**)cvAlloc(noElem * sizeof(float*)); 
-	for(i=0;i<noElem;i++)
+/* Initialization of memory bound to a shared engine. The object is a lightweight workspace: it takes the configuration
+   of the engine (it can be changed afterwards without affecting the engine or other objects) and uses its look-up
+   tables, which are not duplicated. Several objects bound to the same engine can be used concurrently, one per thread,
+   without locks. The engine must outlive the object. It can be called again: the memory is reused if it is big enough.
+   An object that only matches the points detected and described by other objects (e.g. the matching of a video
+   stream, which keeps its motion prior) can skip the images and lists of the detection and the description, which
+   are the bulk of the memory of a workspace.
+   Inputs:
+   -engine: initialized engine. It is not owned by the object.
+   -width: image width.
+   -height: image height.
+   -origin: image origin (field of the OpenCV IplImage structure).
+   -maxNoKeyPoints: maximum number of keypoints that can be detected in an image. Used for memory reserving purposes.
+   -matchOnly: flag to indicate if only the memory of the matching and the motion prior is reserved. The detection
+    and the description functions can not be used then.
+   Output: --
+*/
+void FFME::iniFFME(FFMEEngine* engine, int width, int height, int origin, int maxNoKeyPoints, bool matchOnly)
+{
+	//Previous private engine.
+	if(m_ownEngine && m_engine != engine)
 	{
-		m_LutMagGradient[i] = (float*)cvAlloc(noElem * sizeof(float));
+		delete m_engine;
 	}
-	for(i=0;i<noElem;i++) //Setup of the table.
+	m_engine = engine;
+	m_ownEngine = false;
+	m_matchOnly = matchOnly;
+	m_widthArrayHist = engine->m_widthArrayHist;
+	m_widthSubWinHist = engine->m_widthSubWinHist;
+	m_noBinsOriHist = engine->m_noBinsOriHist;
+	m_maxRespCompDesc = engine->m_maxRespCompDesc;
+	m_threshGradMag = engine->m_threshGradMag;
+	m_threshHarris = engine->m_threshHarris;
+	m_widthWinHarris = engine->m_widthWinHarris;
+	m_widthWinNonMaxSup = engine->m_widthWinNonMaxSup;
+	m_threshRatSecBest = engine->m_threshRatSecBest;
+	m_radMaxSearch = engine->m_radMaxSearch;
+	m_motionPrior = MOTION_PRIOR_NONE;
+	m_widthCellGrid = WIDTH_CELL_MOTION_GRID;
+	m_noTreesKdForest = NO_TREES_KDFOREST;
+	m_noChecksKdForest = NO_CHECKS_KDFOREST;
+	m_noThreads = NO_THREADS;
+	m_maxNoCandidates = MAX_NO_CANDIDATES;
+	m_decimation = DECIMATION;
+	m_heightBand = HEIGHT_BAND;
+	m_preFilterCorner = PRE_FILTER_CORNER;
+	m_preFilterFactor = PRE_FILTER_FACTOR;
+	m_verifyPreFilter = false;
+	m_skipFlatTiles = SKIP_FLAT_TILES;
+	m_widthTileFlat = WIDTH_TILE_FLAT;
+
+	//Look-up tables of the engine.
+	m_LutMagGradient = engine->getLutMagGradient();
+	m_LutPhaseGradient = engine->getLutPhaseGradient();
+	m_LutAtanInt = engine->getLutAtanInt();
+
+	//Memory reserving.
+	reconfigureFFME(width, height, origin, maxNoKeyPoints);
+}
+
+
+/* Change of the frame size and of the maximum number of keypoints, keeping the configuration and the look-up tables.
+   The memory is only reserved again if it is not big enough (the capacity never decreases), so switching between
+   resolutions does not reallocate once the biggest one has been used. The motion prior is reset, since it refers to
+   the previous frames. With decimation, the images are reserved with the decimated size. An object only used for the
+   matching (see 'iniFFME()') only reserves the memory of the matching and the motion prior.
+   Inputs:
+   -width: image width.
+   -height: image height.
+   -origin: image origin (field of the OpenCV IplImage structure).
+   -maxNoKeyPoints: maximum number of keypoints that can be detected in an image. Used for memory reserving purposes.
+   Output: --
+*/
+void FFME::reconfigureFFME(int width, int height, int origin, int maxNoKeyPoints)
+{
+	int noCellsGrid;
+	int widthDec = width / m_decimation;
+	int heightDec = height / m_decimation;
+	m_width = width;
+	m_height = height;
+	m_origin = origin;
+	m_maxNoKeyPoints = maxNoKeyPoints;
+	m_motionPrior = MOTION_PRIOR_NONE;
+
+	//Images (not used by an object only used for the matching). They are reserved again only if the new size exceeds
+	//the capacity in any dimension.
+	if(!m_matchOnly)
 	{
-		for(j=0;j<noElem;j++)
+		if(widthDec > m_capWidth || heightDec > m_capHeight)
+		{
+			m_capWidth = MAX(widthDec, m_capWidth);
+			m_capHeight = MAX(heightDec, m_capHeight);
+			cvReleaseImage(&m_horGradient_S161C);
+			cvReleaseImage(&m_verGradient_S161C);
+			cvReleaseImage(&m_magGradient_32F1C);
+			cvReleaseImage(&m_phaseGradient_32F1C);
+			cvReleaseImage(&m_cornerness_32F1C);
+			cvReleaseImage(&m_decimated_U81C);
+			m_horGradient_S161C = cvCreateImage(cvSize(m_capWidth, m_capHeight), IPL_DEPTH_16S,1);
+			m_verGradient_S161C = cvCreateImage(cvSize(m_capWidth, m_capHeight), IPL_DEPTH_16S,1);
+			m_magGradient_32F1C = cvCreateImage(cvSize(m_capWidth, m_capHeight), IPL_DEPTH_32F,1);
+			m_phaseGradient_32F1C = cvCreateImage(cvSize(m_capWidth, m_capHeight), IPL_DEPTH_32F,1);
+			m_cornerness_32F1C = cvCreateImage(cvSize(m_capWidth, m_capHeight), IPL_DEPTH_32F,1);
+		}
+		if(m_decimation > 1 && m_decimated_U81C == 0)
+		{
+			m_decimated_U81C = cvCreateImage(cvSize(m_capWidth, m_capHeight), IPL_DEPTH_8U,1);
+		}
+		resizeImage(m_horGradient_S161C, widthDec, heightDec, origin);
+		resizeImage(m_verGradient_S161C, widthDec, heightDec, origin);
+		resizeImage(m_magGradient_32F1C, widthDec, heightDec, origin);
+		resizeImage(m_phaseGradient_32F1C, widthDec, heightDec, origin);
+		resizeImage(m_cornerness_32F1C, widthDec, heightDec, origin);
+		if(m_decimated_U81C != 0)
 		{
-			m_LutMagGradient[i][j] = sqrt((float)((shift+i)*(shift+i)+(shift+j)*(shift+j)));
+			resizeImage(m_decimated_U81C, widthDec, heightDec, origin);
 		}
 	}
 
+	//List of points. The lists grow on demand up to the number of pixels.
+	if(!m_matchOnly && m_ptosGrad == 0)
+	{
+		m_capCandidates = MIN(INI_NO_CANDIDATES, widthDec * heightDec);
+		m_ptosGrad = (FFMEPackedPto*)cvAlloc(m_capCandidates * sizeof(FFMEPackedPto));
+		m_ptosCornerness = (FFMEPackedPto*)cvAlloc(m_capCandidates * sizeof(FFMEPackedPto));
+	}
+	m_noPtosGrad = 0;
+	m_noPtosCornerness = 0;
 
-	//Gradient phase look-up table (0,2*pi).
-	m_LutPhaseGradient = (float**)cvAlloc(noElem * sizeof(float*)); //Memory reserving.
-	const float c2pi = (float)(2*CV_PI);
-	for(i=0;i<noElem;i++)
+	//Cross-check matching.
+	if(maxNoKeyPoints > m_capNoKeyPoints)
 	{
-		m_LutPhaseGradient[i] = (float*)cvAlloc(noElem * sizeof(float));
+		m_capNoKeyPoints = maxNoKeyPoints;
+		cvFree(&m_idxBest1);
+		cvFree(&m_idxBest2);
+		cvFree(&m_minDist1Best1);
+		cvFree(&m_minDist2Best1);
+		cvFree(&m_minDist1Best2);
+		cvFree(&m_minDist2Best2);
+		m_idxBest1 = (int*)cvAlloc(maxNoKeyPoints * sizeof(int));
+		m_idxBest2 = (int*)cvAlloc(maxNoKeyPoints * sizeof(int));
+		m_minDist1Best1 = (float*)cvAlloc(maxNoKeyPoints * sizeof(float));
+		m_minDist2Best1 = (float*)cvAlloc(maxNoKeyPoints * sizeof(float));
+		m_minDist1Best2 = (float*)cvAlloc(maxNoKeyPoints * sizeof(float));
+		m_minDist2Best2 = (float*)cvAlloc(maxNoKeyPoints * sizeof(float));
 	}
-	for(i=0;i<noElem;i++) //Setup of the table.
+
+	//Motion grid.
+	m_noColsGrid = (width + m_widthCellGrid - 1) / m_widthCellGrid;
+	m_noRowsGrid = (height + m_widthCellGrid - 1) / m_widthCellGrid;
+	noCellsGrid = m_noColsGrid * m_noRowsGrid;
+	if(noCellsGrid > m_capNoCellsGrid)
 	{
-		for(j=0;j<noElem;j++)
-		{
-			float tmp = atan2((float)(shift+i), (float)(shift+j));
-			//Correct the phase to [0,2pi].
-			if(tmp >= 0)
-			{
-				m_LutPhaseGradient[i][j] = tmp;
-			}
-			else
-			{
-				m_LutPhaseGradient[i][j] = tmp + c2pi;
-			}
-		}
+		m_capNoCellsGrid = noCellsGrid;
+		cvFree(&m_gridPrior);
+		cvFree(&m_noVectGridPrior);
+		m_gridPrior = (CvPoint2D32f*)cvAlloc(noCellsGrid * sizeof(CvPoint2D32f));
+		m_noVectGridPrior = (int*)cvAlloc(noCellsGrid * sizeof(int));
+	}
+}
+
+
+/* Set the decimation factor. The input images are decimated with a box filter (SSE2 if it is available) before the
+   gradient, so the detection and the description work on an image with 'decimation'^2 times less pixels. The matching
+   and all the coordinates (singular points and correspondences) remain in the space of the input images: a pixel of
+   the decimated image is mapped to the center of its block. The search radius and the motion grid are also in input
+   pixels. The motion prior is reset. Before 'iniFFME()' there is nothing to reconfigure, and 'iniFFME()' restores the
+   default factor (DECIMATION), so the function must be called after it.
+   Inputs:
+   -decimation: decimation factor (1, 2 or 4). Other factors are clamped to the greatest valid one not above them.
+   Output: --
+*/
+void FFME::setDecimation(int decimation)
+{
+	m_decimation = (decimation >= 4)? 4 : ((decimation >= 2)? 2 : 1);
+	if(m_width > 0)
+	{
+		reconfigureFFME(m_width, m_height, m_origin, m_maxNoKeyPoints);
 	}
+}
 
 
-	//Reserving memory for the list of points.
-	m_ptosGrad = (CvPoint2D32f*)cvAlloc(width * height * sizeof(CvPoint2D32f));
-	m_ptosCornerness = (CvPoint2D32f*)cvAlloc(width * height * sizeof(CvPoint2D32f));
+/* Change of the size of an image without reserving memory. The image keeps its row step, so the new size must not
+   exceed the one used to create it.
+   Inputs:
+   -img: (input/output) image.
+   -width: new width.
+   -height: new height.
+   -origin: image origin (field of the OpenCV IplImage structure).
+   Output: --
+*/
+void FFME::resizeImage(IplImage* img, int width, int height, int origin)
+{
+	img->width = width;
+	img->height = height;
+	img->imageSize = img->widthStep * height;
+	img->origin = origin;
 }
 
 
@@ -131,11 +459,22 @@ void FFME::iniFFME(int width, int height, int origin, int maxNoKeyPoints)
 */
 void FFME::singPtoDetFunc(IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos)
 {
+	STATS_START_M(ticksDet);
+	STATS_START_M(ticks);
 	gradientSobel(img_U81C); //Computes the gradient.
+	STATS_LAP_M(STATS_GRADIENT, ticks);
 	gradMagFunc(); //Computes the gradient magnitud.
+	STATS_LAP_M(STATS_GRAD_MAG, ticks);
 	gradMagThresh(m_threshGradMag, 16); //Selection of points by thresholding of the gradient magnitude.
+	STATS_LAP_M(STATS_GRAD_MAG_THRESH, ticks);
 	cornerThresh(m_threshHarris, m_widthWinHarris); //Selection of points by cornerness restriction.
+	STATS_LAP_M(STATS_CORNER_THRESH, ticks);
     nonMinSupCorner(m_widthWinNonMaxSup, singPtos, noSingPtos); //Final point selection through non-minimal supression in the cornerness space.
+	STATS_LAP_M(STATS_NON_MIN_SUP, ticks);
+	STATS_STOP_M(STATS_DETECTION, ticksDet);
+	STATS_FUNNEL_M(FUNNEL_GRADIENT, m_noPtosGrad);
+	STATS_FUNNEL_M(FUNNEL_CORNERNESS, m_noPtosCornerness);
+	STATS_FUNNEL_M(FUNNEL_NON_MIN_SUP, *noSingPtos);
 }
 
 
@@ -148,11 +487,152 @@ void FFME::singPtoDetFunc(IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSin
 */
 void FFME::singPtoDetLut(IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos)
 {
+	STATS_START_M(ticksDet);
+	STATS_START_M(ticks);
 	gradientSobel(img_U81C);//Computes the gradient.
+	STATS_LAP_M(STATS_GRADIENT, ticks);
 	gradMagLut();//Computes the gradient.
+	STATS_LAP_M(STATS_GRAD_MAG, ticks);
 	gradMagThresh(m_threshGradMag, 16); //Selection of points by thresholding of the gradient magnitude.
+	STATS_LAP_M(STATS_GRAD_MAG_THRESH, ticks);
 	cornerThresh(m_threshHarris, m_widthWinHarris); //Selection of points by cornerness restriction.
+	STATS_LAP_M(STATS_CORNER_THRESH, ticks);
     nonMinSupCorner(m_widthWinNonMaxSup, singPtos, noSingPtos); //Final point selection through non-minimal supression in the cornerness space.
+	STATS_LAP_M(STATS_NON_MIN_SUP, ticks);
+	STATS_STOP_M(STATS_DETECTION, ticksDet);
+	STATS_FUNNEL_M(FUNNEL_GRADIENT, m_noPtosGrad);
+	STATS_FUNNEL_M(FUNNEL_CORNERNESS, m_noPtosCornerness);
+	STATS_FUNNEL_M(FUNNEL_NON_MIN_SUP, *noSingPtos);
+}
+
+
+/* Singular point detection based on functions over a luma view. The view is processed in place, without copies.
+   Input:
+   -luma: view of the unsigned 8 bit luma plane. Its size must be the one of the initialization.
+   Output:
+   -singPtos: (input/output) array of detected singular points. The function doesn't reserve memory.
+   -noSingPtos: (input/output) number of detected singular points.
+*/
+void FFME::singPtoDetFunc(FFMELumaView* luma, CvPoint2D32f* singPtos, int* noSingPtos)
+{
+	singPtoDetFunc(wrapLuma(luma), singPtos, noSingPtos);
+}
+
+
+/* Singular point detection based on LUT over a luma view. The view is processed in place, without copies.
+   Input:
+   -luma: view of the unsigned 8 bit luma plane. Its size must be the one of the initialization.
+   Output:
+   -singPtos: (input/output) array of detected singular points. The function doesn't reserve memory.
+   -noSingPtos: (input/output) number of detected singular points.
+*/
+void FFME::singPtoDetLut(FFMELumaView* luma, CvPoint2D32f* singPtos, int* noSingPtos)
+{
+	singPtoDetLut(wrapLuma(luma), singPtos, noSingPtos);
+}
+
+/* Singular point detection by bands of rows (cache-blocked). The stages of 'singPtoDetLut()' are run band by band, so
+   the gradient of a band is thresholded and used by the structure tensor while it is still in the cache, and the 
+   non minimal supression is done with a rolling window (a ring of cornerness rows) that follows the bands. The 
+   cornerness image of the whole frame is not used. The gradient magnitude is thresholded on squared values, so the 
+   points are the ones of 'singPtoDetLut()' (for integer thresholds). The gradient of the whole image and its magnitude
+   are stored as in the rest of detection functions, since they are used by the description. The candidate points
+   that can be obtained by 'getGradPtos()' and 'getCornerPtos()' are only the ones of the last band.
+   Input:
+   -img_U81C: unsigned 8 bit input image.
+   Output:
+   -singPtos: (input/output) array of detected singular points. The function doesn't reserve memory.
+   -noSingPtos: (input/output) number of detected singular points.
+*/
+void FFME::singPtoDetBand(IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos)
+{
+	int i, j, row0, row1, rowSobel, noCandidates, width, height;
+	int rWin = cvRound((m_widthWinHarris-1)/2.0);
+	int rWinNonMaxSup = cvFloor((m_widthWinNonMaxSup-1)/2.0);
+	int heightBand = MAX(m_heightBand, 1);
+	int noRowsRing = heightBand + 2*rWinNonMaxSup; //Rows of the band plus the rows of the rolling window.
+	int threshSq = cvCeil(m_threshGradMag * m_threshGradMag); //Squared threshold (the magnitude is not computed).
+	float* cornerness;
+	bool full = false;
+	STATS_START_M(ticksDet);
+	STATS_CODE_M(int noPtosCornerness = 0); //Points of all the bands that fulfill the cornerness restriction.
+
+	if(m_decimation > 1)
+	{
+		decimate(img_U81C);
+		img_U81C = m_decimated_U81C;
+	}
+	width = m_horGradient_S161C->width;
+	height = m_horGradient_S161C->height;
+
+	//Ring of cornerness rows (the band parameters can change between calls).
+	if(noRowsRing * width > m_capCornernessBand)
+	{
+		m_capCornernessBand = noRowsRing * width;
+		cvFree(&m_cornernessBand);
+		m_cornernessBand = (float*)cvAlloc(m_capCornernessBand * sizeof(float));
+	}
+
+	*noSingPtos = 0;
+	m_tilesGradient = false; //The whole gradient is computed.
+	m_noPtosCornerness = 0;
+	m_noPreFilterTested = 0;
+	m_noPreFilterRejected = 0;
+	m_noPreFilterFalseRej = 0;
+	noCandidates = 0;
+	rowSobel = 0;
+	for(row0=0; row0<height && !full; row0+=heightBand)
+	{
+		row1 = MIN(row0 + heightBand, height);
+
+		//Gradient of the band and of the rows below it used by the structure tensor.
+		gradientSobelRows(img_U81C, rowSobel, MIN(row1 + rWin, height));
+		rowSobel = MIN(row1 + rWin, height);
+
+		//Selection of points by thresholding of the squared gradient magnitude.
+		gradMagThreshRows(threshSq, 16, row0, row1, &noCandidates);
+
+		//Selection of points by cornerness restriction. The rows of the band are cleared in the ring.
+		for(i=row0;i<row1;i++)
+		{
+			cornerness = m_cornernessBand + (i % noRowsRing) * width;
+			for(j=0;j<width;j++)
+			{
+				cornerness[j] = FLT_MAX;
+			}
+		}
+		if(m_noPtosCornerness + m_noPtosGrad > m_capCandidates)
+		{
+			growCandidates(m_noPtosCornerness + m_noPtosGrad, width * height);
+		}
+		STATS_CODE_M(noPtosCornerness -= m_noPtosCornerness);
+		cornerThreshRows(m_threshHarris, m_widthWinHarris, m_cornernessBand, noRowsRing);
+		STATS_CODE_M(noPtosCornerness += m_noPtosCornerness);
+
+		//Non-minimal supression of the rows whose window is complete (all the rows in the last band).
+		full = !nonMinSupCornerRows(m_widthWinNonMaxSup, (row1 == height)? height : row1 - rWinNonMaxSup, 
+			                        m_cornernessBand, noRowsRing, singPtos, noSingPtos);
+	}
+
+	//Rest of the gradient (used by the description).
+	gradientSobelRows(img_U81C, rowSobel, height);
+	STATS_STOP_M(STATS_DETECTION, ticksDet);
+	STATS_FUNNEL_M(FUNNEL_GRADIENT, noCandidates);
+	STATS_FUNNEL_M(FUNNEL_CORNERNESS, noPtosCornerness);
+	STATS_FUNNEL_M(FUNNEL_NON_MIN_SUP, *noSingPtos);
+}
+
+
+/* Singular point detection by bands of rows over a luma view. The view is processed in place, without copies.
+   Input:
+   -luma: view of the unsigned 8 bit luma plane. Its size must be the one of the initialization.
+   Output:
+   -singPtos: (input/output) array of detected singular points. The function doesn't reserve memory.
+   -noSingPtos: (input/output) number of detected singular points.
+*/
+void FFME::singPtoDetBand(FFMELumaView* luma, CvPoint2D32f* singPtos, int* noSingPtos)
+{
+	singPtoDetBand(wrapLuma(luma), singPtos, noSingPtos);
 }
 
 
@@ -171,13 +651,20 @@ void FFME::singPtoDescFunc(CvPoint2D32f* singPtos, int noSingPtos, float** descr
     int i;
 	int lengthDesc = m_widthArrayHist*m_widthArrayHist*m_noBinsOriHist;
 	int noBytesDescriptor = lengthDesc * sizeof(float);
+	float offset = (m_decimation - 1) * 0.5f; //Center of the decimated pixels.
+	CvPoint2D32f pto;
+	STATS_START_M(ticksDesc);
+	STATS_START_M(ticks);
 	gradPhaseFunc(); //Computes de gradient phase.
+	STATS_LAP_M(STATS_GRAD_PHASE, ticks);
 	for(i=0;i<noSingPtos;i++)
 	{
 		//Inicialization of the descriptor.
 		memset(descriptors[i], 0, noBytesDescriptor);
-		//Computes the orientation histograms related to the singular point.
-		orientHist(singPtos+i, descriptors[i]);
+		//Computes the orientation histograms related to the singular point (in the decimated image).
+		pto.x = (singPtos[i].x - offset) / m_decimation;
+		pto.y = (singPtos[i].y - offset) / m_decimation;
+		orientHist(&pto, descriptors[i]);
 		
 		if(normDesc)
 		{
@@ -185,6 +672,9 @@ void FFME::singPtoDescFunc(CvPoint2D32f* singPtos, int noSingPtos, float** descr
 			normDescrip(descriptors[i], lengthDesc, m_maxRespCompDesc);
 		}
 	}
+	STATS_LAP_M(STATS_ORIENT_HIST, ticks);
+	STATS_STOP_M(STATS_DESCRIPTION, ticksDesc);
+	STATS_FUNNEL_M(FUNNEL_DESCRIBED, noSingPtos);
 }
 
 
@@ -203,13 +693,20 @@ void FFME::singPtoDescLut(CvPoint2D32f* singPtos, int noSingPtos, float** descri
 	int i;
 	int lengthDesc = m_widthArrayHist*m_widthArrayHist*m_noBinsOriHist;
 	int noBytesDescriptor = lengthDesc * sizeof(float);
+	float offset = (m_decimation - 1) * 0.5f; //Center of the decimated pixels.
+	CvPoint2D32f pto;
+	STATS_START_M(ticksDesc);
+	STATS_START_M(ticks);
 	gradPhaseLut();//Computes de gradient phase.
+	STATS_LAP_M(STATS_GRAD_PHASE, ticks);
 	for(i=0;i<noSingPtos;i++)
 	{
 		//Inicialization of the descriptor.
 		memset(descriptors[i], 0, noBytesDescriptor);
-		//Computes the orientation histograms related to the singular point.
-		orientHist(singPtos+i, descriptors[i]);
+		//Computes the orientation histograms related to the singular point (in the decimated image).
+		pto.x = (singPtos[i].x - offset) / m_decimation;
+		pto.y = (singPtos[i].y - offset) / m_decimation;
+		orientHist(&pto, descriptors[i]);
 
 		if(normDesc)
 		{
@@ -217,9 +714,14 @@ void FFME::singPtoDescLut(CvPoint2D32f* singPtos, int noSingPtos, float** descri
 			normDescrip(descriptors[i], lengthDesc, m_maxRespCompDesc);
 		}
 	}
+	STATS_LAP_M(STATS_ORIENT_HIST, ticks);
+	STATS_STOP_M(STATS_DESCRIPTION, ticksDesc);
+	STATS_FUNNEL_M(FUNNEL_DESCRIBED, noSingPtos);
 }
 
-/*Matching of singular points. The second nearest neighbord restriction is applied.
+/*Matching of singular points. The second nearest neighbord restriction is applied. The search window of each point is
+  centered on the location predicted by the motion prior (see 'setMotionPriorXXX()'), or on the point itself if there
+  is no prior.
   Inputs:
   -singPtos1: array of locations related to the singular points in the first image.
   -noSingPtos1: number of singular points in the first image.
@@ -237,200 +739,2156 @@ void FFME::matchSingPtos(CvPoint2D32f* singPtos1, int noSingPtos1, float** descr
 						 CvPoint2D32f** correspondences, int* noCorr)
 {
 	int i,j;
-	int lengthDesc = m_widthArrayHist*m_widthArrayHist*m_noBinsOriHist;
-	float dist;
 	*noCorr = 0;
+	STATS_START_M(ticks);
+	STATS_CODE_M(m_noMatchedStats = 0);
 
 	for(i=0; i < noSingPtos1; i++)
 	{
-		float x1 = singPtos1[i].x;
-		float y1 = singPtos1[i].y;
-		float* desc1 = descriptors1[i];
-		float minDist1 = FLT_MAX;
-		float minDist2 = FLT_MAX;
-		int j1 = -1;
-		int j2 = -1;
-
-		for(j = 0; j < noSingPtos2; j++)
-		{
-			float x2 = singPtos2[j].x;
-			float y2 = singPtos2[j].y;
-			float* desc2 = descriptors2[j];
-			
-			//Maximum radius search restriction. Manhattan distance.
-			if(m_radMaxSearch >= abs(x2-x1) && m_radMaxSearch >= abs(y2-y1))
-			{
-				//Similarity measure between descriptor based on Euclidean distance.
-				euclDist(desc1, desc2, lengthDesc, &dist);
-
-				//Check if it is the most similar.
-				if(dist < minDist1 )
-				{
-					minDist1 = dist;
-					j1 = j;
-				}
-				//Check if it is the second most similar.
-				else if(dist < minDist2)
-				{
-					minDist2 = dist;
-					j2 = j;
-				}
-			}
-		}
-
-		
-		if (j1 != -1 && j2 != -1)
+		j = searchCorr(singPtos1+i, descriptors1[i], singPtos2, noSingPtos2, descriptors2);
+		if(j != -1)
 		{
-			//Second nearest neighbor restriction.
-			if(minDist1 <= minDist2 * m_threshRatSecBest)
-			{
-				correspondences[*noCorr][0] = singPtos1[i];
-				correspondences[*noCorr][1] = singPtos2[j1];
-				(*noCorr)++;
-			}
-		}
-		//Only one correspondence exists, so it is supposed correct.
-		else if(j1 != -1 && j2 == -1)
-		{		
 			correspondences[*noCorr][0] = singPtos1[i];
-			correspondences[*noCorr][1] = singPtos2[j1];
+			correspondences[*noCorr][1] = singPtos2[j];
 			(*noCorr)++;
 		}
 	}
+	STATS_STOP_M(STATS_MATCHING, ticks);
+	STATS_FUNNEL_M(FUNNEL_MATCHED, m_noMatchedStats);
+	STATS_FUNNEL_M(FUNNEL_ACCEPTED, *noCorr);
 }
 
 
-//****************************************************************************************
-// Private functions
-//****************************************************************************************
-
-
-/* Compute the horizontal and vertical image gradient based on Sobel. The image gradient is not
-   normalized, and its range is (-4*255, 4*255). The results are stored in class members: 
-   m_horGradient_S161C and m_verGradient_S161C respectively.
-   Inputs:
-   -img_U81C: unsigned 8 bit 1 channel image.
-   Outputs: --
+/*Matching of singular points distributing the search among several threads ('m_noThreads'). The points of the first 
+  image are partitioned in contiguous blocks, one per thread, and the correspondence of each point is stored in its own 
+  slot. Then, the correspondences are compacted in the order of the points of the first image, so the result is 
+  identical to the one of 'matchSingPtos()'. Without OpenMP support the search is done by the calling thread.
+  Inputs:
+  -singPtos1: array of locations related to the singular points in the first image.
+  -noSingPtos1: number of singular points in the first image. It can not be greater than 'm_maxNoKeyPoints'.
+  -descriptors1: array of descriptors related to the singular points in the first image.
+  -singPtos2: array of locations related to the singular points in the second image.
+  -noSingPtos2: number of singular points in the second image.
+  -descriptors2: array of descriptors related to the singular points in the second image.
+  -correspondences: (input/output) Nx2 array of correspondences. The first column stores the points 
+   of the first image and the second column the points of the second image. Each row represents a correspondence.
+  -noCorr: (input/output) number of correspondences.
+  Outputs: --
 */
-void FFME::gradientSobel(IplImage* img_U81C)
+void FFME::matchSingPtosPar(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                    CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, 
+						    CvPoint2D32f** correspondences, int* noCorr)
 {
-	cvSobel( img_U81C, m_horGradient_S161C, 1, 0, 3 ); //Horizontal.
-	cvSobel( img_U81C, m_verGradient_S161C, 0, 1, 3 ); //Vertical.
-}
+	int i,j;
+	*noCorr = 0;
 
+	matchSingPtosIdx(singPtos1, noSingPtos1, descriptors1, singPtos2, noSingPtos2, descriptors2, m_idxBest1);
 
-/* Compute the gradient magnitude based on functions. The result is stored in the class member:
-   m_magGradient_32F1C.
-*/
-void FFME::gradMagFunc()
-{
-	int i,j;
-	for(i=0;i<m_horGradient_S161C->height;i++)
+	//Compaction of the correspondences.
+	for(i=0; i < noSingPtos1; i++)
 	{
-		for(j=0;j<m_horGradient_S161C->width;j++)
+		j = m_idxBest1[i];
+		if(j != -1)
 		{
-			int dx = pixelImgS161C_M(m_horGradient_S161C, i, j);
-			int dy = pixelImgS161C_M(m_verGradient_S161C, i, j);
-			pixelImg32F1C_M(m_magGradient_32F1C, i, j) = sqrt((float)(dx*dx + dy*dy)); 
+			correspondences[*noCorr][0] = singPtos1[i];
+			correspondences[*noCorr][1] = singPtos2[j];
+			(*noCorr)++;
 		}
 	}
 }
 
 
-//Compute the gradient magnitude based on LUT.
-void FFME::gradMagLut()
+/*Matching of singular points returning, for each point of the first image, the index of its correspondence in the 
+  second image. The search is distributed among several threads ('m_noThreads') like in 'matchSingPtosPar()'. The second
+  nearest neighbor restriction is applied.
+  Inputs:
+  -singPtos1: array of locations related to the singular points in the first image.
+  -noSingPtos1: number of singular points in the first image.
+  -descriptors1: array of descriptors related to the singular points in the first image.
+  -singPtos2: array of locations related to the singular points in the second image.
+  -noSingPtos2: number of singular points in the second image.
+  -descriptors2: array of descriptors related to the singular points in the second image.
+  -idxCorr: (input/output) array of 'noSingPtos1' elements with the index of the corresponding point in the second 
+   image, or -1 if the point has no reliable correspondence. The function doesn't reserve memory.
+  Outputs: --
+*/
+void FFME::matchSingPtosIdx(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                    CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, int* idxCorr)
 {
-	int i,j;
-	int shift = 255*4; //Shift for accessing to the LUT.
-	for(i=0;i<m_horGradient_S161C->height;i++)
+	int i;
+	STATS_START_M(ticks);
+	STATS_CODE_M(m_noMatchedStats = 0);
+
+#ifdef _OPENMP
+	int noThreads = (m_noThreads > 0) ? m_noThreads : omp_get_num_procs();
+	#pragma omp parallel for num_threads(noThreads) schedule(static)
+#endif
+	for(i=0; i < noSingPtos1; i++)
+	{
+		idxCorr[i] = searchCorr(singPtos1+i, descriptors1[i], singPtos2, noSingPtos2, descriptors2);
+	}
+
+#ifdef FFME_STATS
+	int noAccepted = 0;
+	for(i=0; i < noSingPtos1; i++)
+	{
+		if(idxCorr[i] != -1)
+		{
+			noAccepted++;
+		}
+	}
+	STATS_STOP_M(STATS_MATCHING, ticks);
+	STATS_FUNNEL_M(FUNNEL_MATCHED, m_noMatchedStats);
+	STATS_FUNNEL_M(FUNNEL_ACCEPTED, noAccepted);
+#endif
+}
+
+
+/*Matching of singular points returning a compact list of correspondences. Each correspondence stores the indices of the
+  singular points and the descriptor distances to the best and second best candidates, so later stages can work by index
+  and measure the reliability of the correspondence. The search is distributed among several threads ('m_noThreads') and
+  the correspondences are stored in the order of the points of the first image. The second nearest neighbor 
+  restriction is applied.
+  Inputs:
+  -singPtos1: array of locations related to the singular points in the first image.
+  -noSingPtos1: number of singular points in the first image. It can not be greater than 'm_maxNoKeyPoints'.
+  -descriptors1: array of descriptors related to the singular points in the first image.
+  -singPtos2: array of locations related to the singular points in the second image.
+  -noSingPtos2: number of singular points in the second image.
+  -descriptors2: array of descriptors related to the singular points in the second image.
+  -corrList: (input/output) list of correspondences. The correspondences that exceed its capacity are discarded.
+  Outputs: --
+*/
+void FFME::matchSingPtos(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                 CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, FFMECorrList* corrList)
+{
+	int i,j;
+	corrList->noCorr = 0;
+	STATS_START_M(ticks);
+	STATS_CODE_M(m_noMatchedStats = 0);
+
+#ifdef _OPENMP
+	int noThreads = (m_noThreads > 0) ? m_noThreads : omp_get_num_procs();
+	#pragma omp parallel for num_threads(noThreads) schedule(static)
+#endif
+	for(i=0; i < noSingPtos1; i++)
+	{
+		m_idxBest1[i] = searchCorr(singPtos1+i, descriptors1[i], singPtos2, noSingPtos2, descriptors2, 
+			                       m_minDist1Best1+i, m_minDist2Best1+i);
+	}
+
+	//Compaction of the correspondences.
+	for(i=0; i < noSingPtos1 && corrList->noCorr < corrList->maxNoCorr; i++)
+	{
+		j = m_idxBest1[i];
+		if(j != -1)
+		{
+			corrList->idx1[corrList->noCorr] = i;
+			corrList->idx2[corrList->noCorr] = j;
+			corrList->dist1[corrList->noCorr] = m_minDist1Best1[i];
+			corrList->dist2[corrList->noCorr] = m_minDist2Best1[i];
+			corrList->noCorr++;
+		}
+	}
+	STATS_STOP_M(STATS_MATCHING, ticks);
+	STATS_FUNNEL_M(FUNNEL_MATCHED, m_noMatchedStats);
+	STATS_FUNNEL_M(FUNNEL_ACCEPTED, corrList->noCorr);
+}
+
+
+/*Search of the best and second best candidates of the singular points of the first image, without applying any 
+  restriction. It is the expensive part of the matching (all the descriptor comparisons), and its result can be filtered
+  several times with 'filterMatches', e.g. to explore different thresholds. The search radius and the motion prior
+  used are the current ones, so they bound the restrictions that can be applied later, and the locations predicted by
+  the motion prior are stored for the radius restriction. The search is distributed among 
+  several threads ('m_noThreads').
+  Inputs:
+  -singPtos1: array of locations related to the singular points in the first image.
+  -noSingPtos1: number of singular points in the first image. Only the first 'maxNoQueries' points of the match result
+   are searched.
+  -descriptors1: array of descriptors related to the singular points in the first image.
+  -singPtos2: array of locations related to the singular points in the second image.
+  -noSingPtos2: number of singular points in the second image.
+  -descriptors2: array of descriptors related to the singular points in the second image.
+  -matchResult: (input/output) match result.
+  Outputs: --
+*/
+void FFME::matchSingPtos(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                 CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, FFMEMatchResult* matchResult)
+{
+	int i;
+	matchResult->noQueries = MIN(noSingPtos1, matchResult->maxNoQueries);
+	STATS_START_M(ticks);
+
+#ifdef _OPENMP
+	int noThreads = (m_noThreads > 0) ? m_noThreads : omp_get_num_procs();
+	#pragma omp parallel for num_threads(noThreads) schedule(static)
+#endif
+	for(i=0; i < matchResult->noQueries; i++)
+	{
+		searchBest2(singPtos1+i, descriptors1[i], singPtos2, noSingPtos2, descriptors2, 
+			        matchResult->idx1+i, matchResult->dist1+i, matchResult->idx2+i, matchResult->dist2+i);
+		predictPto(singPtos1+i, &matchResult->predPtos[i].x, &matchResult->predPtos[i].y);
+	}
+
+#ifdef FFME_STATS
+	//The accepted correspondences are recorded by 'filterMatches()'.
+	int noMatched = 0;
+	for(i=0; i < matchResult->noQueries; i++)
+	{
+		if(matchResult->idx1[i] != -1)
+		{
+			noMatched++;
+		}
+	}
+	STATS_STOP_M(STATS_MATCHING, ticks);
+	STATS_FUNNEL_M(FUNNEL_MATCHED, noMatched);
+#endif
+}
+
+
+/*Restrictions over a match result. No descriptor is compared, so the cost is linear in the number of points. With the 
+  same parameters used in the search, the correspondences are the same as the ones of 'matchSingPtos'.
+  The radius restriction is conservative: the best candidate is rejected if it is outside the new radius, and the 
+  second best candidate is kept although it is outside, so the ratio restriction can be stricter than the one of a new
+  search with the smaller radius. Radii greater than the one used in the search have no effect. The radius is measured
+  from the locations predicted with the motion prior of the search, which are stored in the match result, so the prior
+  can be changed between the search and the restrictions (e.g. with the correspondences of the search).
+  The restrictions use buffers of the reserved number of keypoints (at least 'm_maxNoKeyPoints'), so only the points of
+  the first image that fit in them are filtered, and with the uniqueness restriction the candidates whose index exceeds
+  it are rejected.
+  Inputs:
+  -matchResult: match result.
+  -singPtos1: array of locations related to the singular points in the first image (the radius restriction uses the
+   predicted locations of the match result).
+  -singPtos2: array of locations related to the singular points in the second image.
+  -noSingPtos2: number of singular points in the second image.
+  -threshRatSecBest: threshold for the second nearest neighbor restriction (1 disables it).
+  -radMaxSearch: maximum radius (Manhattan distance) between the location predicted by the motion prior and the 
+   corresponding point.
+  -unique: flag to indicate if the uniqueness restriction is applied. If several points of the first image correspond 
+   to the same point of the second image, only the one with the lowest descriptor distance is kept.
+  -corrList: (input/output) list of correspondences. The correspondences that exceed its capacity are discarded.
+  Outputs: --
+*/
+void FFME::filterMatches(FFMEMatchResult* matchResult, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, int noSingPtos2,
+		                 float threshRatSecBest, float radMaxSearch, bool unique, FFMECorrList* corrList)
+{
+	int i, j;
+	int noQueries = MIN(matchResult->noQueries, m_capNoKeyPoints); //Capacity of the buffers of the restrictions.
+	CvPoint2D32f* predPtos = matchResult->predPtos;
+	corrList->noCorr = 0;
+	if(unique)
+	{
+		noSingPtos2 = MIN(noSingPtos2, m_capNoKeyPoints);
+	}
+
+	//Second nearest neighbor and radius restrictions.
+	for(i=0; i < noQueries; i++)
+	{
+		j = matchResult->idx1[i];
+		if(j != -1 && matchResult->idx2[i] != -1 && matchResult->dist1[i] > matchResult->dist2[i] * threshRatSecBest)
+		{
+			j = -1;
+		}
+		if(j != -1)
+		{
+			if(radMaxSearch < abs(singPtos2[j].x-predPtos[i].x) || radMaxSearch < abs(singPtos2[j].y-predPtos[i].y))
+			{
+				j = -1;
+			}
+		}
+		if(unique && j >= noSingPtos2)
+		{
+			j = -1;
+		}
+		m_idxBest1[i] = j;
+	}
+
+	//Uniqueness restriction. Selection of the best point of the first image for each point of the second image.
+	if(unique)
+	{
+		for(j=0; j < noSingPtos2; j++)
+		{
+			m_idxBest2[j] = -1;
+		}
+		for(i=0; i < noQueries; i++)
+		{
+			j = m_idxBest1[i];
+			if(j != -1 && (m_idxBest2[j] == -1 || matchResult->dist1[i] < matchResult->dist1[m_idxBest2[j]]))
+			{
+				m_idxBest2[j] = i;
+			}
+		}
+	}
+
+	//Compaction of the correspondences.
+	for(i=0; i < noQueries && corrList->noCorr < corrList->maxNoCorr; i++)
+	{
+		j = m_idxBest1[i];
+		if(j != -1 && (!unique || m_idxBest2[j] == i))
+		{
+			corrList->idx1[corrList->noCorr] = i;
+			corrList->idx2[corrList->noCorr] = j;
+			corrList->dist1[corrList->noCorr] = matchResult->dist1[i];
+			corrList->dist2[corrList->noCorr] = matchResult->dist2[i];
+			corrList->noCorr++;
+		}
+	}
+	STATS_FUNNEL_M(FUNNEL_ACCEPTED, corrList->noCorr);
+}
+
+
+/*Global matching of singular points based on an approximate nearest neighbor search. The maximum radius search
+  restriction is not applied, so it is suitable for unbounded motion (image registration, shot re-identification...).
+  A randomized kd-forest of 'm_noTreesKdForest' trees is built over the descriptors of the second image, and each 
+  point of the first image compares at most 'm_noChecksKdForest' descriptors. The second nearest neighbor restriction
+  is applied.
+  Inputs:
+  -singPtos1: array of locations related to the singular points in the first image.
+  -noSingPtos1: number of singular points in the first image.
+  -descriptors1: array of descriptors related to the singular points in the first image.
+  -singPtos2: array of locations related to the singular points in the second image.
+  -noSingPtos2: number of singular points in the second image.
+  -descriptors2: array of descriptors related to the singular points in the second image.
+  -correspondences: (input/output) Nx2 array of correspondences. The first column stores the points 
+   of the first image and the second column the points of the second image. Each row represents a correspondence.
+  -noCorr: (input/output) number of correspondences.
+  Outputs: --
+*/
+void FFME::matchSingPtosGlobal(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                       CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, 
+						       CvPoint2D32f** correspondences, int* noCorr)
+{
+	int i;
+	int lengthDesc = m_widthArrayHist*m_widthArrayHist*m_noBinsOriHist;
+	int j1, j2;
+	float minDist1, minDist2;
+	*noCorr = 0;
+	STATS_START_M(ticks);
+	STATS_CODE_M(int noMatched = 0);
+
+	//Approximate nearest neighbor index of the second image.
+	m_kdForest.buildForest(descriptors2, noSingPtos2, lengthDesc, m_noTreesKdForest);
+
+	for(i=0; i < noSingPtos1; i++)
+	{
+		m_kdForest.searchNN2(descriptors1[i], m_noChecksKdForest, &j1, &minDist1, &j2, &minDist2);
+		STATS_CODE_M(noMatched += (j1 != -1));
+
+		//Second nearest neighbor restriction. If only one correspondence exists, it is supposed correct.
+		if(j1 != -1 && (j2 == -1 || minDist1 <= minDist2 * m_threshRatSecBest))
+		{
+			correspondences[*noCorr][0] = singPtos1[i];
+			correspondences[*noCorr][1] = singPtos2[j1];
+			(*noCorr)++;
+		}
+	}
+	STATS_STOP_M(STATS_MATCHING, ticks);
+	STATS_FUNNEL_M(FUNNEL_MATCHED, noMatched);
+	STATS_FUNNEL_M(FUNNEL_ACCEPTED, *noCorr);
+}
+
+
+/*Matching of singular points with the mutual nearest neighbor restriction (cross-check). Every pair of points inside
+  the search radius is compared only once, and the best and second best correspondences are updated for both points of 
+  the pair. A correspondence is accepted if each point is the best correspondence of the other one, and the second 
+  nearest neighbor restriction is fulfilled in both directions. The best and second best correspondences are updated 
+  like in 'matchSingPtos()' (a new best one does not become the second best), so without motion prior the result is 
+  the one of matching the images in both directions with 'matchSingPtos()' and keeping the mutual correspondences, but
+  at the cost of a single pass. With a motion prior, the search windows of the points of the second image are the 
+  ones of the first image (the prior is not inverted).
+  Inputs:
+  -singPtos1: array of locations related to the singular points in the first image.
+  -noSingPtos1: number of singular points in the first image. It can not be greater than 'm_maxNoKeyPoints'.
+  -descriptors1: array of descriptors related to the singular points in the first image.
+  -singPtos2: array of locations related to the singular points in the second image.
+  -noSingPtos2: number of singular points in the second image. It can not be greater than 'm_maxNoKeyPoints'.
+  -descriptors2: array of descriptors related to the singular points in the second image.
+  -correspondences: (input/output) Nx2 array of correspondences. The first column stores the points 
+   of the first image and the second column the points of the second image. Each row represents a correspondence.
+  -noCorr: (input/output) number of correspondences.
+  Outputs: --
+*/
+void FFME::matchSingPtosCross(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                      CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, 
+						      CvPoint2D32f** correspondences, int* noCorr)
+{
+	int i,j;
+	int lengthDesc = m_widthArrayHist*m_widthArrayHist*m_noBinsOriHist;
+	float dist;
+	*noCorr = 0;
+	STATS_START_M(ticks);
+	STATS_CODE_M(int noMatched = 0);
+
+	//Initialization of the best and second best correspondences.
+	for(i=0; i < noSingPtos1; i++)
+	{
+		m_idxBest1[i] = -1;
+		m_minDist1Best1[i] = FLT_MAX;
+		m_minDist2Best1[i] = FLT_MAX;
+	}
+	for(j=0; j < noSingPtos2; j++)
+	{
+		m_idxBest2[j] = -1;
+		m_minDist1Best2[j] = FLT_MAX;
+		m_minDist2Best2[j] = FLT_MAX;
+	}
+
+	//Single traversal of the candidate pairs.
+	for(i=0; i < noSingPtos1; i++)
+	{
+		float x1, y1;
+		float* desc1 = descriptors1[i];
+
+		//The search window is centered on the location predicted by the motion prior.
+		predictPto(singPtos1+i, &x1, &y1);
+
+		for(j = 0; j < noSingPtos2; j++)
+		{
+			float x2 = singPtos2[j].x;
+			float y2 = singPtos2[j].y;
+			
+			//Maximum radius search restriction. Manhattan distance.
+			if(m_radMaxSearch >= abs(x2-x1) && m_radMaxSearch >= abs(y2-y1))
+			{
+				//Similarity measure between descriptor based on Euclidean distance.
+				euclDist(desc1, descriptors2[j], lengthDesc, &dist);
+
+				//Best and second best correspondences of the point of the first image.
+				if(dist < m_minDist1Best1[i])
+				{
+					m_minDist1Best1[i] = dist;
+					m_idxBest1[i] = j;
+				}
+				else if(dist < m_minDist2Best1[i])
+				{
+					m_minDist2Best1[i] = dist;
+				}
+
+				//Best and second best correspondences of the point of the second image.
+				if(dist < m_minDist1Best2[j])
+				{
+					m_minDist1Best2[j] = dist;
+					m_idxBest2[j] = i;
+				}
+				else if(dist < m_minDist2Best2[j])
+				{
+					m_minDist2Best2[j] = dist;
+				}
+			}
+		}
+	}
+
+	//Mutual nearest neighbor and second nearest neighbor restrictions. If only one candidate exists, 
+	//the second best distance is FLT_MAX and the restriction is fulfilled.
+	for(i=0; i < noSingPtos1; i++)
+	{
+		j = m_idxBest1[i];
+		STATS_CODE_M(noMatched += (j != -1));
+		if(j != -1 && m_idxBest2[j] == i)
+		{
+			if(m_minDist1Best1[i] <= m_minDist2Best1[i] * m_threshRatSecBest &&
+			   m_minDist1Best2[j] <= m_minDist2Best2[j] * m_threshRatSecBest)
+			{
+				correspondences[*noCorr][0] = singPtos1[i];
+				correspondences[*noCorr][1] = singPtos2[j];
+				(*noCorr)++;
+			}
+		}
+	}
+	STATS_STOP_M(STATS_MATCHING, ticks);
+	STATS_FUNNEL_M(FUNNEL_MATCHED, noMatched);
+	STATS_FUNNEL_M(FUNNEL_ACCEPTED, *noCorr);
+}
+
+
+/* Singular point detection in fixed-point arithmetic (integer pipeline). It is intended for processors with a poor
+   floating point throughput: the gradient magnitude is thresholded on squared values, the structure tensor is summed
+   in 64 bit integers and the Harris condition is checked with integer products (the threshold is rounded to 1/16). 
+   The magnitude and phase images are not computed.
+   Input:
+   -img_U81C: unsigned 8 bit input image.
+   Output:
+   -singPtos: (input/output) array of detected singular points. The function doesn't reserve memory.
+   -noSingPtos: (input/output) number of detected singular points.
+*/
+void FFME::singPtoDetInt(IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos)
+{
+	int threshSq = cvCeil(m_threshGradMag * m_threshGradMag); //Squared threshold (the magnitude is not computed).
+	STATS_START_M(ticksDet);
+	STATS_START_M(ticks);
+	gradientSobel(img_U81C); //Computes the gradient.
+	STATS_LAP_M(STATS_GRADIENT, ticks);
+	gradMagThreshInt(threshSq, 16); //Selection of points by thresholding of the squared gradient magnitude.
+	STATS_LAP_M(STATS_GRAD_MAG_THRESH, ticks);
+	cornerThreshInt(m_threshHarris, m_widthWinHarris); //Selection of points by cornerness restriction.
+	STATS_LAP_M(STATS_CORNER_THRESH, ticks);
+	nonMinSupCornerInt(m_widthWinNonMaxSup, singPtos, noSingPtos); //Final point selection through non-minimal supression.
+	STATS_LAP_M(STATS_NON_MIN_SUP, ticks);
+	STATS_STOP_M(STATS_DETECTION, ticksDet);
+	STATS_FUNNEL_M(FUNNEL_GRADIENT, m_noPtosGrad);
+	STATS_FUNNEL_M(FUNNEL_CORNERNESS, m_noPtosCornerness);
+	STATS_FUNNEL_M(FUNNEL_NON_MIN_SUP, *noSingPtos);
+}
+
+
+/* Singular point detection in fixed-point arithmetic over a luma view. The view is processed in place, without copies.
+   Input:
+   -luma: view of the unsigned 8 bit luma plane. Its size must be the one of the initialization.
+   Output:
+   -singPtos: (input/output) array of detected singular points. The function doesn't reserve memory.
+   -noSingPtos: (input/output) number of detected singular points.
+*/
+void FFME::singPtoDetInt(FFMELumaView* luma, CvPoint2D32f* singPtos, int* noSingPtos)
+{
+	singPtoDetInt(wrapLuma(luma), singPtos, noSingPtos);
+}
+
+
+/* Singular point description in fixed-point arithmetic. It must be called after 'singPtoDetInt()' (or any other 
+   detection function) over the same image, since it uses its gradient. The magnitude and the orientation of the 
+   gradient are computed only in the neighborhood of the points (integer square root and arctangent LUT), and the
+   histograms are accumulated with fixed-point weights. The descriptors are normalized like the floating point ones and
+   quantized to unsigned 8 bit components (scale SCALE_DESC_INT, saturated to 255), so they take four times less memory.
+   Input:
+   -singPtos: array of detected singular points.
+   -noSingPtos: number of detected singular points.
+   -descriptors: (input/output) array of descriptors corresponding to the singular points. Each one has 
+    'm_widthArrayHist'*'m_widthArrayHist'*'m_noBinsOriHist' elements. The function doesn't reserve memory.
+   Output: --
+*/
+void FFME::singPtoDescInt(CvPoint2D32f* singPtos, int noSingPtos, unsigned char** descriptors)
+{
+	int i, j, r, s, radius;
+	int lengthDesc = m_widthArrayHist*m_widthArrayHist*m_noBinsOriHist;
+	int width = m_widthArrayHist * m_widthSubWinHist; //Width in pixels of the neighborhood.
+	float exponent = (float)(m_widthArrayHist * m_widthArrayHist * 0.5); //Exponent of the Gaussian smoothing.
+	float offset = (m_decimation - 1) * 0.5f; //Center of the decimated pixels.
+	float rbin0, cbin0;
+	STATS_START_M(ticksDesc);
+
+	//Memory reserving (the descriptor parameters can change between calls).
+	if(width * width > m_capWeightsDescInt)
+	{
+		m_capWeightsDescInt = width * width;
+		cvFree(&m_weightsDescInt);
+		m_weightsDescInt = (int*)cvAlloc(m_capWeightsDescInt * sizeof(int));
+	}
+	if(lengthDesc > m_capHistDescInt)
+	{
+		m_capHistDescInt = lengthDesc;
+		cvFree(&m_histDescInt);
+		m_histDescInt = (int*)cvAlloc(m_capHistDescInt * sizeof(int));
+	}
+
+	//Gaussian weights (Q12) of the neighborhood. They are the same for all the points.
+	radius = width / 2;
+	for(i=0;i<width;i++)
+	{
+		for(j=0;j<width;j++)
+		{
+			if((width % 2) != 0)
+			{
+				rbin0 = (float)(i - radius) / m_widthSubWinHist;
+				cbin0 = (float)(j - radius) / m_widthSubWinHist;
+			}
+			else
+			{
+				rbin0 = (float)(i - radius + 0.5) / m_widthSubWinHist;
+				cbin0 = (float)(j - radius + 0.5) / m_widthSubWinHist;
+			}
+			m_weightsDescInt[i*width+j] = cvRound(4096 * exp(-(cbin0*cbin0 + rbin0*rbin0) / exponent));
+		}
+	}
+
+	STATS_START_M(ticks);
+	for(i=0;i<noSingPtos;i++)
+	{
+		//Location of the singular point in the decimated image.
+		r = cvRound((singPtos[i].y - offset) / m_decimation);
+		s = cvRound((singPtos[i].x - offset) / m_decimation);
+		memset(m_histDescInt, 0, lengthDesc * sizeof(int));
+		orientHistInt(r, s, m_histDescInt);
+		normDescripInt(m_histDescInt, lengthDesc, m_maxRespCompDesc, descriptors[i]);
+	}
+	STATS_LAP_M(STATS_ORIENT_HIST, ticks);
+	STATS_STOP_M(STATS_DESCRIPTION, ticksDesc);
+	STATS_FUNNEL_M(FUNNEL_DESCRIBED, noSingPtos);
+}
+
+
+/*Matching of singular points with integer descriptors (see 'singPtoDescInt()'). The distances are squared integer
+  Euclidean distances, and the second nearest neighbord restriction is checked with integer products, so the result 
+  is the one of 'matchSingPtos()' up to the quantization of the descriptors. The search window and the motion prior
+  are the ones of 'matchSingPtos()'.
+  Inputs:
+  -singPtos1: array of locations related to the singular points in the first image.
+  -noSingPtos1: number of singular points in the first image.
+  -descriptors1: array of integer descriptors related to the singular points in the first image.
+  -singPtos2: array of locations related to the singular points in the second image.
+  -noSingPtos2: number of singular points in the second image.
+  -descriptors2: array of integer descriptors related to the singular points in the second image.
+  -correspondences: (input/output) Nx2 array of correspondences. The first column stores the points 
+   of the first image and the second column the points of the second image. Each row represents a correspondence.
+  -noCorr: (input/output) number of correspondences.
+  Outputs: --
+*/
+void FFME::matchSingPtosInt(CvPoint2D32f* singPtos1, int noSingPtos1, unsigned char** descriptors1, 
+		                    CvPoint2D32f* singPtos2, int noSingPtos2, unsigned char** descriptors2, 
+						    CvPoint2D32f** correspondences, int* noCorr)
+{
+	int i,j;
+	*noCorr = 0;
+	STATS_START_M(ticks);
+	STATS_CODE_M(m_noMatchedStats = 0);
+
+	for(i=0; i < noSingPtos1; i++)
+	{
+		j = searchCorrInt(singPtos1+i, descriptors1[i], singPtos2, noSingPtos2, descriptors2);
+		if(j != -1)
+		{
+			correspondences[*noCorr][0] = singPtos1[i];
+			correspondences[*noCorr][1] = singPtos2[j];
+			(*noCorr)++;
+		}
+	}
+	STATS_STOP_M(STATS_MATCHING, ticks);
+	STATS_FUNNEL_M(FUNNEL_MATCHED, m_noMatchedStats);
+	STATS_FUNNEL_M(FUNNEL_ACCEPTED, *noCorr);
+}
+
+
+/*Set a coarse motion grid computed from the correspondences of the previous frames as motion prior. The image is divided
+  in cells of 'm_widthCellGrid' pixels, and the motion vector of each cell is the average of the correspondences whose
+  point of the second image falls inside it. In this way, the grid obtained matching the frames t-1 and t predicts the 
+  motion of the points of the frame t in the matching with the frame t+1. Cells without correspondences take the 
+  average motion of the whole image.
+  Inputs:
+  -correspondences: Nx2 array of correspondences obtained by the function 'matchSingPtosXXX()'.
+  -noCorr: number of correspondences.
+  Outputs: --
+*/
+void FFME::setMotionPriorGrid(CvPoint2D32f** correspondences, int noCorr)
+{
+	int i, c, r;
+	int noCells = m_noColsGrid * m_noRowsGrid;
+	CvPoint2D32f avgMotion = cvPoint2D32f(0, 0);
+
+	for(i=0;i<noCells;i++)
+	{
+		m_gridPrior[i] = cvPoint2D32f(0, 0);
+		m_noVectGridPrior[i] = 0;
+	}
+
+	//Accumulation of the motion vectors in the cells.
+	for(i=0;i<noCorr;i++)
+	{
+		float dx = correspondences[i][1].x - correspondences[i][0].x;
+		float dy = correspondences[i][1].y - correspondences[i][0].y;
+		c = MIN(MAX(cvFloor(correspondences[i][1].x / m_widthCellGrid), 0), m_noColsGrid-1);
+		r = MIN(MAX(cvFloor(correspondences[i][1].y / m_widthCellGrid), 0), m_noRowsGrid-1);
+		m_gridPrior[r*m_noColsGrid+c].x += dx;
+		m_gridPrior[r*m_noColsGrid+c].y += dy;
+		m_noVectGridPrior[r*m_noColsGrid+c]++;
+		avgMotion.x += dx;
+		avgMotion.y += dy;
+	}
+	if(noCorr > 0)
+	{
+		avgMotion.x /= noCorr;
+		avgMotion.y /= noCorr;
+	}
+
+	//Average motion of each cell.
+	for(i=0;i<noCells;i++)
+	{
+		if(m_noVectGridPrior[i] > 0)
+		{
+			m_gridPrior[i].x /= m_noVectGridPrior[i];
+			m_gridPrior[i].y /= m_noVectGridPrior[i];
+		}
+		else
+		{
+			m_gridPrior[i] = avgMotion;
+		}
+	}
+
+	m_motionPrior = MOTION_PRIOR_GRID;
+}
+
+
+//****************************************************************************************
+// Private functions
+//****************************************************************************************
+
+
+/* Compute the horizontal and vertical image gradient based on Sobel. The image gradient is not
+   normalized, and its range is (-4*255, 4*255). The results are stored in class members: 
+   m_horGradient_S161C and m_verGradient_S161C respectively. With the flat region pre-rejection, the
+   flat tiles that are far from the rest are skipped here and in the following stages (see 'flatTiles()').
+   Inputs:
+   -img_U81C: unsigned 8 bit 1 channel image.
+   Outputs: --
+*/
+void FFME::gradientSobel(IplImage* img_U81C)
+{
+	if(m_decimation > 1)
+	{
+		decimate(img_U81C);
+		img_U81C = m_decimated_U81C;
+	}
+	m_tilesGradient = m_skipFlatTiles;
+	if(m_skipFlatTiles)
+	{
+		flatTiles(img_U81C);
+		gradientSobelTiles(img_U81C);
+	}
+	else
+	{
+		cvSobel( img_U81C, m_horGradient_S161C, 1, 0, 3 ); //Horizontal.
+		cvSobel( img_U81C, m_verGradient_S161C, 0, 1, 3 ); //Vertical.
+	}
+}
+
+
+//Rounded average of two values (same rounding as the SSE2 average instructions).
+#define AVG_DECIMATION(a, b) (((a) + (b) + 1) >> 1)
+
+#ifdef SSE_DECIMATION
+/* Average of the pairs of adjacent pixels of 32 consecutive pixels.
+   Inputs:
+   -a: first 16 pixels.
+   -b: last 16 pixels.
+   -mask: 0x00FF in each 16 bit element.
+   Outputs: 16 averages.
+*/
+static inline __m128i avgPairsSSE(__m128i a, __m128i b, __m128i mask)
+{
+	__m128i avgA = _mm_avg_epu16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+	__m128i avgB = _mm_avg_epu16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8));
+	return _mm_packus_epi16(avgA, avgB);
+}
+#endif
+
+
+/* Decimation of the input image with a box filter of size 'm_decimation' (2 or 4). The filter and the subsampling are
+   done in a single pass: each output pixel is the average of its block, computed as a tree of rounded averages of 
+   pairs (first the rows, then the columns), with SSE2 if it is available (16 output pixels per iteration). The result
+   is stored in the class member m_decimated_U81C.
+   Inputs:
+   -img_U81C: unsigned 8 bit input image.
+   Output: --
+*/
+void FFME::decimate(IplImage* img_U81C)
+{
+	int i, j, k;
+	int width = m_decimated_U81C->width;
+	int height = m_decimated_U81C->height;
+	unsigned char* src[4];
+	unsigned char* dst;
+	int col[4];
+
+	for(i=0;i<height;i++)
+	{
+		for(k=0;k<m_decimation;k++)
+		{
+			src[k] = (unsigned char*)(img_U81C->imageData + (i*m_decimation + k)*img_U81C->widthStep);
+		}
+		dst = (unsigned char*)(m_decimated_U81C->imageData + i*m_decimated_U81C->widthStep);
+		j = 0;
+
+#ifdef SSE_DECIMATION
+		__m128i mask = _mm_set1_epi16(0x00FF);
+		__m128i r[4];
+		if(m_decimation == 2)
+		{
+			for(;j<=width-16;j+=16)
+			{
+				r[0] = _mm_avg_epu8(_mm_loadu_si128((__m128i*)(src[0]+2*j)), _mm_loadu_si128((__m128i*)(src[1]+2*j)));
+				r[1] = _mm_avg_epu8(_mm_loadu_si128((__m128i*)(src[0]+2*j+16)), _mm_loadu_si128((__m128i*)(src[1]+2*j+16)));
+				_mm_storeu_si128((__m128i*)(dst+j), avgPairsSSE(r[0], r[1], mask));
+			}
+		}
+		else
+		{
+			for(;j<=width-16;j+=16)
+			{
+				for(k=0;k<4;k++)
+				{
+					r[k] = _mm_avg_epu8(
+						_mm_avg_epu8(_mm_loadu_si128((__m128i*)(src[0]+4*j+16*k)), _mm_loadu_si128((__m128i*)(src[1]+4*j+16*k))),
+						_mm_avg_epu8(_mm_loadu_si128((__m128i*)(src[2]+4*j+16*k)), _mm_loadu_si128((__m128i*)(src[3]+4*j+16*k))));
+				}
+				_mm_storeu_si128((__m128i*)(dst+j), avgPairsSSE(avgPairsSSE(r[0], r[1], mask), avgPairsSSE(r[2], r[3], mask), mask));
+			}
+		}
+#endif
+
+		//Rest of the row (or whole row without SSE2).
+		for(;j<width;j++)
+		{
+			if(m_decimation == 2)
+			{
+				col[0] = AVG_DECIMATION(src[0][2*j], src[1][2*j]);
+				col[1] = AVG_DECIMATION(src[0][2*j+1], src[1][2*j+1]);
+				dst[j] = (unsigned char)AVG_DECIMATION(col[0], col[1]);
+			}
+			else
+			{
+				for(k=0;k<4;k++)
+				{
+					col[k] = AVG_DECIMATION(AVG_DECIMATION(src[0][4*j+k], src[1][4*j+k]), AVG_DECIMATION(src[2][4*j+k], src[3][4*j+k]));
+				}
+				dst[j] = (unsigned char)AVG_DECIMATION(AVG_DECIMATION(col[0], col[1]), AVG_DECIMATION(col[2], col[3]));
+			}
+		}
+	}
+}
+
+
+/* Image header over a luma view. Only the header is initialized, the data of the view are not copied.
+   Inputs:
+   -luma: view of the unsigned 8 bit luma plane.
+   Outputs: header of the view (class member m_lumaHeader).
+*/
+IplImage* FFME::wrapLuma(FFMELumaView* luma)
+{
+	cvInitImageHeader(&m_lumaHeader, cvSize(luma->width, luma->height), IPL_DEPTH_8U, 1, m_horGradient_S161C->origin);
+	cvSetData(&m_lumaHeader, luma->data, luma->stride);
+	return &m_lumaHeader;
+}
+
+
+/* Compute the gradient magnitude based on functions. The result is stored in the class member:
+   m_magGradient_32F1C.
+*/
+void FFME::gradMagFunc()
+{
+	int i,j,k,noRuns;
+	int* runs;
+	for(i=0;i<m_horGradient_S161C->height;i++)
+	{
+		tileRuns(i, TILE_NEIGHBOR, &runs, &noRuns); //Columns that are not skipped.
+		for(k=0;k<noRuns;k++)
+		{
+			for(j=runs[2*k];j<runs[2*k+1];j++)
+			{
+				int dx = pixelImgS161C_M(m_horGradient_S161C, i, j);
+				int dy = pixelImgS161C_M(m_verGradient_S161C, i, j);
+				pixelImg32F1C_M(m_magGradient_32F1C, i, j) = sqrt((float)(dx*dx + dy*dy)); 
+			}
+		}
+	}
+}
+
+
+//Compute the gradient magnitude based on LUT.
+void FFME::gradMagLut()
+{
+	int i,j,k,noRuns;
+	int* runs;
+	int shift = 255*4; //Shift for accessing to the LUT.
+	for(i=0;i<m_horGradient_S161C->height;i++)
+	{
+		tileRuns(i, TILE_NEIGHBOR, &runs, &noRuns); //Columns that are not skipped.
+		for(k=0;k<noRuns;k++)
+		{
+			for(j=runs[2*k];j<runs[2*k+1];j++)
+			{
+				pixelImg32F1C_M(m_magGradient_32F1C, i, j) = 
+					m_LutMagGradient[pixelImgS161C_M(m_verGradient_S161C, i, j) + shift][pixelImgS161C_M(m_horGradient_S161C, i, j) + shift];
+			}
+		}
+	}
+}
+
+
+/* Selection of points by gradient magnitude thresholding. The 'noPix' nearer from image borders are discarded.
+   The points are stored with packed coordinates, and the list grows (row by row) up to 'm_maxNoCandidates' points.
+   Inputs:
+   -thresh: gradient magnitude threshold. You must take into account that the gradient magnitud range is [0,].
+   -noPix: number of pixels discarded from the image borders.
+   Output: --
+*/
+void FFME::gradMagThresh(float thresh, int noPix)
+{
+	int i,j,k,noRuns;
+	int* runs;
+	int width = m_magGradient_32F1C->width;
+	int height = m_magGradient_32F1C->height;
+	int maxNoCandidates = width * height;
+	int limit;
+	m_noPtosGrad = 0;
+	int condition1 = height-noPix;
+	int condition2 = width-noPix;
+	if(m_maxNoCandidates > 0 && m_maxNoCandidates < maxNoCandidates)
+	{
+		maxNoCandidates = m_maxNoCandidates;
+	}
+	for(i=noPix;i<condition1;i++)
+	{
+		//Capacity for a whole row.
+		if(m_noPtosGrad + condition2 - noPix > m_capCandidates && m_capCandidates < maxNoCandidates)
+		{
+			growCandidates(m_noPtosGrad + condition2 - noPix, maxNoCandidates);
+		}
+		limit = MIN(m_capCandidates, maxNoCandidates);
+		tileRuns(i, TILE_NON_FLAT, &runs, &noRuns); //The flat tiles have no candidate points.
+		for(k=0;k<noRuns;k++)
+		{
+			for(j=MAX(runs[2*k], noPix);j<MIN(runs[2*k+1], condition2);j++)
+			{
+				if(pixelImg32F1C_M(m_magGradient_32F1C, i, j) >= thresh)
+				{
+					if(m_noPtosGrad == limit)
+					{
+						return;
+					}
+					m_ptosGrad[m_noPtosGrad].x = (unsigned short)j;
+					m_ptosGrad[m_noPtosGrad].y = (unsigned short)i;
+					m_noPtosGrad++;
+				}
+			}
+		}
+	}
+}
+
+
+/* Growth of the lists of candidate points. The capacity is doubled (at least) and the stored points are kept.
+   Inputs:
+   -noCandidates: required number of candidate points.
+   -maxNoCandidates: maximum capacity.
+   Output: --
+*/
+void FFME::growCandidates(int noCandidates, int maxNoCandidates)
+{
+	FFMEPackedPto* ptos;
+	int capCandidates = MAX(2 * m_capCandidates, noCandidates);
+	if(capCandidates > maxNoCandidates)
+	{
+		capCandidates = maxNoCandidates;
+	}
+
+	ptos = (FFMEPackedPto*)cvAlloc(capCandidates * sizeof(FFMEPackedPto));
+	memcpy(ptos, m_ptosGrad, m_noPtosGrad * sizeof(FFMEPackedPto));
+	cvFree(&m_ptosGrad);
+	m_ptosGrad = ptos;
+	ptos = (FFMEPackedPto*)cvAlloc(capCandidates * sizeof(FFMEPackedPto));
+	memcpy(ptos, m_ptosCornerness, m_noPtosCornerness * sizeof(FFMEPackedPto));
+	cvFree(&m_ptosCornerness);
+	m_ptosCornerness = ptos;
+	m_capCandidates = capCandidates;
+}
+
+
+/* Conversion of packed points to floating point coordinates.
+   Inputs:
+   -packed: array of packed points.
+   -noPtos: number of points.
+   -ptos: (input/output) array of points. The function doesn't reserve memory.
+   Output: --
+*/
+void FFME::unpackPtos(FFMEPackedPto* packed, int noPtos, CvPoint2D32f* ptos)
+{
+	int i;
+	float scale = (float)m_decimation; //Mapping to the space of the input image.
+	float offset = (m_decimation - 1) * 0.5f;
+	for(i=0;i<noPtos;i++)
+	{
+		ptos[i] = cvPoint2D32f(packed[i].x * scale + offset, packed[i].y * scale + offset);
+	}
+}
+
+
+/* Selection of points of high cornerness. 
+   Inputs:
+   -thresh: cornerness threshold based on Harris condition (ratio of eigenvalues).
+   -sizeWin: size of the window used to calculate the cornerness.
+   Output: --
+*/
+void FFME::cornerThresh(float thresh, int sizeWin)
+{
+	int i, u, v;
+	int rWin = cvRound((sizeWin-1)/2.0);
+	float avgdx, avgdy, avgdxdy, trace, det, cornerness;
+	float harrisCond = (thresh+1)*(thresh+1)/thresh; //Harris condition for cornerness.
+	float threshPre = thresh * m_preFilterFactor;
+	float harrisCondPre = (threshPre+1)*(threshPre+1)/threshPre; //Relaxed Harris condition of the quick rejection.
+	bool rejected;
+	m_noPtosCornerness = 0;
+	m_noPreFilterTested = 0;
+	m_noPreFilterRejected = 0;
+	m_noPreFilterFalseRej = 0;
+	cvSet(m_cornerness_32F1C, cvScalar(FLT_MAX)); //Sparse cornerness map that is used by 'nonMinSupCorner()' function.
+
+	for(i=0;i<m_noPtosGrad;i++)
+	{
+		CvPoint pto = cvPoint(m_ptosGrad[i].x, m_ptosGrad[i].y);
+		
+		//The point is discarded if its neighborhood is not inside the image bounds. 
+		if(checkSquareReg(m_horGradient_S161C, pto.y, pto.x, rWin))
+		{		
+			//Quick rejection. In verification mode, the rejected points are evaluated to count the wrong rejections.
+			rejected = false;
+			if(m_preFilterCorner)
+			{
+				m_noPreFilterTested++;
+				if(preFilterCorner(pto, rWin, harrisCondPre))
+				{
+					m_noPreFilterRejected++;
+					if(!m_verifyPreFilter)
+					{
+						continue;
+					}
+					rejected = true;
+				}
+			}
+
+			avgdx = 0;
+			avgdy = 0;
+			avgdxdy = 0;
+			int condition1 = pto.y + rWin;
+			int condition2 = pto.x + rWin;
+			for(v=pto.y-rWin; v<=condition1; v++)
+			{
+				for(u=pto.x-rWin; u<=condition2; u++)
+				{
+					//Matrix A of Harris: average gradient matrix. The average is not isotropic.
+					int dxTmp = pixelImgS161C_M(m_horGradient_S161C, v, u);
+					int dyTmp = pixelImgS161C_M(m_verGradient_S161C, v, u);
+					avgdx += dxTmp * dxTmp;
+					avgdy += dyTmp * dyTmp;
+					avgdxdy += dxTmp * dyTmp;;
+				}
+			}
+
+			trace = avgdx + avgdy;
+			det = avgdx * avgdy - avgdxdy * avgdxdy;
+			//The point is discarded if its determinant is negative or zero.
+			if(det > 0)
+			{
+				cornerness = trace * trace / det;
+				//Check the corner restriction.
+				if(cornerness < harrisCond && rejected)
+				{
+					m_noPreFilterFalseRej++;
+				}
+				else if(cornerness < harrisCond)
+				{
+					m_ptosCornerness[m_noPtosCornerness++] = m_ptosGrad[i];
+					pixelImg32F1C_M(m_cornerness_32F1C, pto.y, pto.x) = cornerness;
+				}
+			}
+		}
+	}
+}
+
+
+/* Quick rejection of a candidate point before the evaluation of the full structure tensor (see 'setPreFilterParam()').
+   The tensor is summed only over a sparse set of gradients of the window: the center, its 4 neighbors and the 8 pixels
+   at the border of the window (corners and middle points). The point is rejected if the directions of these gradients
+   are not diverse enough, i.e. if they do not fulfill a Harris condition 'm_preFilterFactor' times looser than the
+   one of the full tensor. Points on straight edges have parallel gradients, so most of them are rejected here.
+   Inputs:
+   -pto: candidate point. Its window must be inside the image bounds.
+   -rWin: half width of the window used to calculate the cornerness.
+   -harrisCond: relaxed Harris condition.
+   Output: true if the point is rejected.
+*/
+bool FFME::preFilterCorner(CvPoint pto, int rWin, float harrisCond)
+{
+	int k, dxTmp, dyTmp;
+	float avgdx = 0, avgdy = 0, avgdxdy = 0, trace, det;
+	int offsets[NO_SAMPLES_PRE_FILTER][2] = {{0,0}, {-1,0}, {1,0}, {0,-1}, {0,1}, {-rWin,-rWin}, {0,-rWin}, {rWin,-rWin},
+	                                         {-rWin,0}, {rWin,0}, {-rWin,rWin}, {0,rWin}, {rWin,rWin}};
+
+	for(k=0;k<NO_SAMPLES_PRE_FILTER;k++)
+	{
+		dxTmp = pixelImgS161C_M(m_horGradient_S161C, pto.y + offsets[k][1], pto.x + offsets[k][0]);
+		dyTmp = pixelImgS161C_M(m_verGradient_S161C, pto.y + offsets[k][1], pto.x + offsets[k][0]);
+		avgdx += dxTmp * dxTmp;
+		avgdy += dyTmp * dyTmp;
+		avgdxdy += dxTmp * dyTmp;
+	}
+
+	trace = avgdx + avgdy;
+	det = avgdx * avgdy - avgdxdy * avgdxdy;
+	return det <= 0 || trace * trace >= harrisCond * det;
+}
+
+
+/* Non minimal supression in the cornerness space.
+   Inputs:
+   -sizeWin: Size of the window size used to compute the non minimal supression restriction.
+   -ptos: (input/output) array of points that fulfill the non minimal supression restriction, in the space of the input
+          image (see 'setDecimation()'). The function doesn't reserve memory.
+   -noPtos: (input/output) number of points that fulfill the non minimal supression restriction.
+   Output: --
+*/
+void FFME::nonMinSupCorner(int sizeWin, CvPoint2D32f* ptos, int* noPtos)
+{
+    int i, v, u;
+	int rWin = cvFloor((sizeWin-1)/2.0);
+	float scale = (float)m_decimation; //Mapping to the space of the input image.
+	float offset = (m_decimation - 1) * 0.5f;
+	*noPtos = 0;
+
+	for(i=0;i<m_noPtosCornerness;i++)
+	{
+		CvPoint pto = cvPoint(m_ptosCornerness[i].x, m_ptosCornerness[i].y);
+		float val = pixelImg32F1C_M(m_cornerness_32F1C, pto.y, pto.x);
+		int condition1 = pto.y+rWin;
+		int condition2 = pto.x+rWin;
+		if( val > 0 )//Check for minimum.
+		{
+			for( v = pto.y-rWin; v <= condition1; v++ )
+			{
+				for( u = pto.x-rWin; u <= condition2; u++ )
+				{
+					if( val > pixelImg32F1C_M(m_cornerness_32F1C, v, u))
+					{
+						goto noMin;
+					}
+				}
+			}
+			
+			//Check the maximum number of singular points allowed.
+			if((*noPtos) <= (m_maxNoKeyPoints - 1))
+			{
+				ptos[(*noPtos)++] = cvPoint2D32f(pto.x * scale + offset, pto.y * scale + offset);
+			}
+			else
+			{
+				return;
+			} 
+		}
+
+		noMin:
+		;
+	}
+}
+
+
+/*--Banded detection--*/
+
+//Sobel masks of a pixel given the previous, current and next rows and the previous, current and next columns.
+#define SOBEL_HOR(up, cur, down, l, r) ((up)[r] - (up)[l] + 2*((cur)[r] - (cur)[l]) + (down)[r] - (down)[l])
+#define SOBEL_VER(up, down, l, c, r) ((down)[l] + 2*(down)[c] + (down)[r] - (up)[l] - 2*(up)[c] - (up)[r])
+
+
+/* Compute the horizontal and vertical image gradient based on Sobel of a range of columns of a row. The borders are
+   replicated and, like 'cvSobel()', the vertical gradient is inverted in images with bottom-left origin (the previous
+   and next rows are exchanged), so the result is the one of 'gradientSobel()'. It is shared by the banded detection
+   and the flat region pre-rejection. The results are stored in the row of the class members m_horGradient_S161C and
+   m_verGradient_S161C.
+   Inputs:
+   -img_U81C: unsigned 8 bit 1 channel image (already decimated).
+   -row: row of the image.
+   -col0: first column.
+   -col1: column after the last one.
+   Outputs: --
+*/
+void FFME::gradientSobelRow(IplImage* img_U81C, int row, int col0, int col1)
+{
+	int j;
+	int width = img_U81C->width;
+	int height = img_U81C->height;
+	int flip = (img_U81C->origin != 0); //Bottom-left origin: the rows are exchanged.
+	unsigned char* up = &pixelImgU81C_M(img_U81C, flip? MIN(row+1, height-1) : MAX(row-1, 0), 0);
+	unsigned char* cur = &pixelImgU81C_M(img_U81C, row, 0);
+	unsigned char* down = &pixelImgU81C_M(img_U81C, flip? MAX(row-1, 0) : MIN(row+1, height-1), 0);
+	short* dx = &pixelImgS161C_M(m_horGradient_S161C, row, 0);
+	short* dy = &pixelImgS161C_M(m_verGradient_S161C, row, 0);
+
+	//Inner columns.
+	for(j=MAX(col0, 1);j<MIN(col1, width-1);j++)
+	{
+		dx[j] = (short)SOBEL_HOR(up, cur, down, j-1, j+1);
+		dy[j] = (short)SOBEL_VER(up, down, j-1, j, j+1);
+	}
+	//Border columns.
+	if(col0 == 0)
+	{
+		dx[0] = (short)SOBEL_HOR(up, cur, down, 0, MIN(1, width-1));
+		dy[0] = (short)SOBEL_VER(up, down, 0, 0, MIN(1, width-1));
+	}
+	if(col1 == width)
+	{
+		dx[width-1] = (short)SOBEL_HOR(up, cur, down, MAX(width-2, 0), width-1);
+		dy[width-1] = (short)SOBEL_VER(up, down, MAX(width-2, 0), width-1, width-1);
+	}
+}
+
+
+/* Compute the horizontal and vertical image gradient of a range of rows based on Sobel ('gradientSobelRow()'), so the
+   result is the one of 'gradientSobel()'. The results are stored in the rows of the class members
+   m_horGradient_S161C and m_verGradient_S161C. The gradient magnitude of the rows is also computed based on LUT
+   (m_magGradient_32F1C), since it is used by the description.
+   Inputs:
+   -img_U81C: unsigned 8 bit 1 channel image (already decimated).
+   -row0: first row.
+   -row1: row after the last one.
+   Outputs: --
+*/
+void FFME::gradientSobelRows(IplImage* img_U81C, int row0, int row1)
+{
+	int i, j;
+	int width = img_U81C->width;
+	int shift = 255*4; //Shift for accessing to the LUT.
+	short *dx, *dy;
+	float* mag;
+
+	for(i=row0;i<row1;i++)
+	{
+		gradientSobelRow(img_U81C, i, 0, width);
+
+		//Gradient magnitude of the row, while the gradient is in the cache.
+		dx = &pixelImgS161C_M(m_horGradient_S161C, i, 0);
+		dy = &pixelImgS161C_M(m_verGradient_S161C, i, 0);
+		mag = &pixelImg32F1C_M(m_magGradient_32F1C, i, 0);
+		for(j=0;j<width;j++)
+		{
+			mag[j] = m_LutMagGradient[dy[j] + shift][dx[j] + shift];
+		}
+	}
+}
+
+
+/* Selection of the points of a range of rows by thresholding of the squared gradient magnitude. The 'noPix' nearer from
+   image borders are discarded. The list of candidate points only keeps the points of the range, and the total number of
+   candidate points of the image is limited to 'm_maxNoCandidates' like in 'gradMagThresh()'.
+   Inputs:
+   -threshSq: squared gradient magnitude threshold.
+   -noPix: number of pixels discarded from the image borders.
+   -row0: first row.
+   -row1: row after the last one.
+   -noCandidates: (input/output) number of candidate points of the image.
+   Output: --
+*/
+void FFME::gradMagThreshRows(int threshSq, int noPix, int row0, int row1, int* noCandidates)
+{
+	int i,j;
+	int width = m_horGradient_S161C->width;
+	int height = m_horGradient_S161C->height;
+	int maxNoCandidates = width * height;
+	int condition1 = MIN(row1, height-noPix);
+	int condition2 = width-noPix;
+	m_noPtosGrad = 0;
+	if(m_maxNoCandidates > 0 && m_maxNoCandidates < maxNoCandidates)
+	{
+		maxNoCandidates = m_maxNoCandidates;
+	}
+	for(i=MAX(row0, noPix);i<condition1;i++)
+	{
+		//Capacity for a whole row.
+		if(m_noPtosGrad + condition2 - noPix > m_capCandidates)
+		{
+			growCandidates(m_noPtosGrad + condition2 - noPix, width * height);
+		}
+		short* rowDx = &pixelImgS161C_M(m_horGradient_S161C, i, 0);
+		short* rowDy = &pixelImgS161C_M(m_verGradient_S161C, i, 0);
+		for(j=noPix;j<condition2;j++)
+		{
+			if(rowDx[j]*rowDx[j] + rowDy[j]*rowDy[j] >= threshSq)
+			{
+				if(*noCandidates == maxNoCandidates)
+				{
+					return;
+				}
+				m_ptosGrad[m_noPtosGrad].x = (unsigned short)j;
+				m_ptosGrad[m_noPtosGrad].y = (unsigned short)i;
+				m_noPtosGrad++;
+				(*noCandidates)++;
+			}
+		}
+	}
+}
+
+
+/* Selection of points of high cornerness storing the cornerness in a ring of rows. The computation is the one of
+   'cornerThresh()'. The selected points are appended to the list of points of high cornerness, which keeps the points
+   of the previous bands that are waiting for the non minimal supression.
+   Inputs:
+   -thresh: cornerness threshold based on Harris condition (ratio of eigenvalues).
+   -sizeWin: size of the window used to calculate the cornerness.
+   -cornerness: ring of cornerness rows (the row 'r' of the image is the row 'r'%'noRowsRing' of the ring).
+   -noRowsRing: number of rows of the ring.
+   Output: --
+*/
+void FFME::cornerThreshRows(float thresh, int sizeWin, float* cornerness, int noRowsRing)
+{
+	int i, u, v;
+	int rWin = cvRound((sizeWin-1)/2.0);
+	int width = m_horGradient_S161C->width;
+	float avgdx, avgdy, avgdxdy, trace, det, cornernessPto;
+	float harrisCond = (thresh+1)*(thresh+1)/thresh; //Harris condition for cornerness.
+	float threshPre = thresh * m_preFilterFactor;
+	float harrisCondPre = (threshPre+1)*(threshPre+1)/threshPre; //Relaxed Harris condition of the quick rejection.
+	bool rejected;
+
+	for(i=0;i<m_noPtosGrad;i++)
+	{
+		CvPoint pto = cvPoint(m_ptosGrad[i].x, m_ptosGrad[i].y);
+
+		//The point is discarded if its neighborhood is not inside the image bounds. 
+		if(checkSquareReg(m_horGradient_S161C, pto.y, pto.x, rWin))
+		{
+			//Quick rejection. In verification mode, the rejected points are evaluated to count the wrong rejections.
+			rejected = false;
+			if(m_preFilterCorner)
+			{
+				m_noPreFilterTested++;
+				if(preFilterCorner(pto, rWin, harrisCondPre))
+				{
+					m_noPreFilterRejected++;
+					if(!m_verifyPreFilter)
+					{
+						continue;
+					}
+					rejected = true;
+				}
+			}
+
+			avgdx = 0;
+			avgdy = 0;
+			avgdxdy = 0;
+			int condition1 = pto.y + rWin;
+			int condition2 = pto.x + rWin;
+			for(v=pto.y-rWin; v<=condition1; v++)
+			{
+				for(u=pto.x-rWin; u<=condition2; u++)
+				{
+					//Matrix A of Harris: average gradient matrix. The average is not isotropic.
+					int dxTmp = pixelImgS161C_M(m_horGradient_S161C, v, u);
+					int dyTmp = pixelImgS161C_M(m_verGradient_S161C, v, u);
+					avgdx += dxTmp * dxTmp;
+					avgdy += dyTmp * dyTmp;
+					avgdxdy += dxTmp * dyTmp;
+				}
+			}
+
+			trace = avgdx + avgdy;
+			det = avgdx * avgdy - avgdxdy * avgdxdy;
+			//The point is discarded if its determinant is negative or zero.
+			if(det > 0)
+			{
+				cornernessPto = trace * trace / det;
+				//Check the corner restriction.
+				if(cornernessPto < harrisCond && rejected)
+				{
+					m_noPreFilterFalseRej++;
+				}
+				else if(cornernessPto < harrisCond)
+				{
+					m_ptosCornerness[m_noPtosCornerness++] = m_ptosGrad[i];
+					cornerness[(pto.y % noRowsRing) * width + pto.x] = cornernessPto;
+				}
+			}
+		}
+	}
+}
+
+
+/* Non minimal supression of the points of high cornerness above a row, with a ring of cornerness rows. The processed
+   points are removed from the list, and the rest are kept for the next band.
+   Inputs:
+   -sizeWin: Size of the window size used to compute the non minimal supression restriction.
+   -row1: row after the last one processed.
+   -cornerness: ring of cornerness rows (the row 'r' of the image is the row 'r'%'noRowsRing' of the ring).
+   -noRowsRing: number of rows of the ring.
+   -ptos: (input/output) array of points that fulfill the non minimal supression restriction, in the space of the input
+          image (see 'setDecimation()'). The function doesn't reserve memory.
+   -noPtos: (input/output) number of points that fulfill the non minimal supression restriction. The new points are
+            appended.
+   Output: false if the maximum number of singular points is reached.
+*/
+bool FFME::nonMinSupCornerRows(int sizeWin, int row1, float* cornerness, int noRowsRing, CvPoint2D32f* ptos, int* noPtos)
+{
+	int i, v, u;
+	int rWin = cvFloor((sizeWin-1)/2.0);
+	int width = m_horGradient_S161C->width;
+	float scale = (float)m_decimation; //Mapping to the space of the input image.
+	float offset = (m_decimation - 1) * 0.5f;
+
+	for(i=0;i<m_noPtosCornerness && m_ptosCornerness[i].y < row1;i++)
+	{
+		CvPoint pto = cvPoint(m_ptosCornerness[i].x, m_ptosCornerness[i].y);
+		float val = cornerness[(pto.y % noRowsRing) * width + pto.x];
+		int condition1 = pto.y+rWin;
+		int condition2 = pto.x+rWin;
+		for( v = pto.y-rWin; v <= condition1; v++ )
+		{
+			float* row = cornerness + (v % noRowsRing) * width;
+			for( u = pto.x-rWin; u <= condition2; u++ )
+			{
+				if( val > row[u])
+				{
+					goto noMin;
+				}
+			}
+		}
+
+		//Check the maximum number of singular points allowed.
+		if((*noPtos) <= (m_maxNoKeyPoints - 1))
+		{
+			ptos[(*noPtos)++] = cvPoint2D32f(pto.x * scale + offset, pto.y * scale + offset);
+		}
+		else
+		{
+			return false;
+		}
+
+		noMin:
+		;
+	}
+
+	//Points of the following rows.
+	m_noPtosCornerness -= i;
+	memmove(m_ptosCornerness, m_ptosCornerness + i, m_noPtosCornerness * sizeof(FFMEPackedPto));
+	return true;
+}
+
+
+/*--Flat region pre-rejection--*/
+
+/* Classification of the tiles of the image by their intensity range. Each Sobel mask is bounded by 4 times the
+   intensity range of the 3x3 neighborhood, so the gradient magnitude in a tile is bounded by 4*sqrt(2) times the range
+   of the tile extended by one pixel. If the bound is below the gradient magnitude threshold, the tile is flat and it
+   can not contain candidate points. The flat tiles near a non-flat one (closer than the radius of the cornerness and
+   descriptor windows) are kept, since the points of the non-flat tile use their gradient; the rest are skipped. So the
+   singular points and their descriptors are the ones without the pre-rejection. The levels of the tiles (TILE_XXX) and
+   the runs of columns of each row of tiles are stored in the class members (see 'tileRuns()').
+   Inputs:
+   -img_U81C: unsigned 8 bit 1 channel image (already decimated).
+   Outputs: --
+*/
+void FFME::flatTiles(IplImage* img_U81C)
+{
+	int i, j, k, tx, ty, u, v, col1, range, minLevel, noTilesDil;
+	int width = img_U81C->width;
+	int height = img_U81C->height;
+	int widthTile = m_widthTileFlat;
+	int rWin = cvRound((m_widthWinHarris-1)/2.0);
+	int radius = MAX(rWin, m_widthArrayHist * m_widthSubWinHist / 2); //Radius of the windows around the points.
+	float threshSq = m_threshGradMag * m_threshGradMag;
+	unsigned char *row, *minCol, *maxCol, *level;
+	unsigned char minVal, maxVal;
+	int* runs;
+	int* noRuns;
+
+	m_widthTiles = widthTile;
+	m_noTilesX = (width + widthTile - 1) / widthTile;
+	m_noTilesY = (height + widthTile - 1) / widthTile;
+	noTilesDil = (radius + widthTile - 1) / widthTile;
+
+	//Memory (the size of the tiles can change between calls).
+	if((m_noTilesX + 1) * m_noTilesY > m_capTiles)
+	{
+		m_capTiles = (m_noTilesX + 1) * m_noTilesY;
+		cvFree(&m_levelTiles);
+		cvFree(&m_runsTiles);
+		cvFree(&m_noRunsTiles);
+		m_levelTiles = (unsigned char*)cvAlloc(m_capTiles);
+		m_runsTiles = (int*)cvAlloc(2 * m_capTiles * sizeof(int));
+		m_noRunsTiles = (int*)cvAlloc(m_capTiles * sizeof(int));
+	}
+	if(width > m_capMinMaxTiles)
+	{
+		m_capMinMaxTiles = width;
+		cvFree(&m_minMaxTiles);
+		m_minMaxTiles = (unsigned char*)cvAlloc(2 * m_capMinMaxTiles);
+	}
+	m_noTiles = m_noTilesX * m_noTilesY;
+	m_noTilesFlat = 0;
+	m_noTilesSkipped = 0;
+	minCol = m_minMaxTiles;
+	maxCol = m_minMaxTiles + width;
+
+	//Intensity range of the tiles extended by one pixel (neighborhood of the Sobel masks, with replicated borders). The
+	//rows of each row of tiles are reduced first column by column.
+	for(ty=0;ty<m_noTilesY;ty++)
+	{
+		memset(minCol, 255, width);
+		memset(maxCol, 0, width);
+		for(i=MAX(ty*widthTile-1, 0);i<MIN((ty+1)*widthTile+1, height);i++)
+		{
+			row = &pixelImgU81C_M(img_U81C, i, 0);
+			for(j=0;j<width;j++)
+			{
+				minCol[j] = MIN(minCol[j], row[j]);
+				maxCol[j] = MAX(maxCol[j], row[j]);
+			}
+		}
+		level = m_levelTiles + ty*m_noTilesX;
+		for(tx=0;tx<m_noTilesX;tx++)
+		{
+			col1 = MIN((tx+1)*widthTile+1, width);
+			minVal = 255;
+			maxVal = 0;
+			for(j=MAX(tx*widthTile-1, 0);j<col1;j++)
+			{
+				minVal = MIN(minVal, minCol[j]);
+				maxVal = MAX(maxVal, maxCol[j]);
+			}
+			range = maxVal - minVal;
+			if(32.f * range * range < threshSq) //(4*sqrt(2)*range)^2 < thresh^2
+			{
+				level[tx] = TILE_SKIPPED;
+				m_noTilesFlat++;
+			}
+			else
+			{
+				level[tx] = TILE_NON_FLAT;
+			}
+		}
+	}
+
+	//Flat tiles near the non-flat ones.
+	for(ty=0;ty<m_noTilesY;ty++)
+	{
+		for(tx=0;tx<m_noTilesX;tx++)
+		{
+			if(m_levelTiles[ty*m_noTilesX + tx] == TILE_NON_FLAT)
+			{
+				for(v=MAX(ty-noTilesDil, 0);v<=MIN(ty+noTilesDil, m_noTilesY-1);v++)
+				{
+					for(u=MAX(tx-noTilesDil, 0);u<=MIN(tx+noTilesDil, m_noTilesX-1);u++)
+					{
+						if(m_levelTiles[v*m_noTilesX + u] == TILE_SKIPPED)
+						{
+							m_levelTiles[v*m_noTilesX + u] = TILE_NEIGHBOR;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//Runs of consecutive tiles of each row of tiles with level TILE_NEIGHBOR or higher (k=0) and TILE_NON_FLAT (k=1).
+	for(k=0;k<2;k++)
+	{
+		minLevel = TILE_NEIGHBOR + k;
+		for(ty=0;ty<m_noTilesY;ty++)
+		{
+			level = m_levelTiles + ty*m_noTilesX;
+			runs = m_runsTiles + (k*m_noTilesY + ty)*(m_noTilesX + 1);
+			noRuns = m_noRunsTiles + k*m_noTilesY + ty;
+			*noRuns = 0;
+			for(tx=0;tx<m_noTilesX;tx++)
+			{
+				if(level[tx] < minLevel)
+				{
+					if(k == 0)
+					{
+						m_noTilesSkipped++;
+					}
+					continue;
+				}
+				if(tx == 0 || level[tx-1] < minLevel)
+				{
+					runs[2*(*noRuns)] = tx*widthTile;
+				}
+				if(tx == m_noTilesX-1 || level[tx+1] < minLevel)
+				{
+					runs[2*(*noRuns)+1] = MIN((tx+1)*widthTile, width);
+					(*noRuns)++;
+				}
+			}
+		}
+	}
+}
+
+
+/* Compute the horizontal and vertical image gradient based on Sobel in the tiles that are not skipped (see
+   'flatTiles()'), run by run with 'gradientSobelRow()', so the result is the one of 'gradientSobel()' in these tiles.
+   The results are stored in the class members m_horGradient_S161C and m_verGradient_S161C. The skipped tiles are not
+   updated.
+   Inputs:
+   -img_U81C: unsigned 8 bit 1 channel image (already decimated).
+   Outputs: --
+*/
+void FFME::gradientSobelTiles(IplImage* img_U81C)
+{
+	int i, k, noRuns;
+	int height = img_U81C->height;
+	int* runs;
+
+	for(i=0;i<height;i++)
+	{
+		tileRuns(i, TILE_NEIGHBOR, &runs, &noRuns);
+		for(k=0;k<noRuns;k++)
+		{
+			gradientSobelRow(img_U81C, i, runs[2*k], runs[2*k+1]);
+		}
+	}
+}
+
+
+/* Columns of a row of the gradient that belong to tiles of a minimum level, as runs of consecutive tiles. If the last
+   gradient was not computed by tiles, there is a single run with the whole row.
+   Inputs:
+   -row: row of the gradient image.
+   -level: minimum level of the tiles (TILE_NEIGHBOR or TILE_NON_FLAT).
+   -runs: (input/output) pairs of first column and column after the last one of the runs.
+   -noRuns: (input/output) number of runs.
+   Outputs: --
+*/
+void FFME::tileRuns(int row, int level, int** runs, int* noRuns)
+{
+	int idx;
+	if(!m_tilesGradient)
+	{
+		m_runFull[0] = 0;
+		m_runFull[1] = m_horGradient_S161C->width;
+		*runs = m_runFull;
+		*noRuns = 1;
+		return;
+	}
+	idx = (level - TILE_NEIGHBOR) * m_noTilesY + row / m_widthTiles;
+	*runs = m_runsTiles + idx * (m_noTilesX + 1);
+	*noRuns = m_noRunsTiles[idx];
+}
+
+
+//Compute the gradient phase based on functions. Range = (0,2pi).
+void FFME::gradPhaseFunc()
+{
+	int i,j,k,noRuns;
+	int* runs;
+	const float c2pi = (float)(2 * CV_PI);
+	for(i=0;i<m_horGradient_S161C->height;i++)
+	{
+		tileRuns(i, TILE_NEIGHBOR, &runs, &noRuns); //Columns that are not skipped.
+		for(k=0;k<noRuns;k++)
+		{
+			for(j=runs[2*k];j<runs[2*k+1];j++)
+			{
+				int dx = pixelImgS161C_M(m_horGradient_S161C, i, j);
+				int dy = pixelImgS161C_M(m_verGradient_S161C, i, j);
+				float tmp = atan2((float)dy, (float)dx); //[-pi,pi]
+				//Correct the phase to [0,2pi].
+				if(tmp >= 0)
+				{
+					pixelImg32F1C_M(m_phaseGradient_32F1C, i, j) = tmp;
+				}
+				else
+				{
+					pixelImg32F1C_M(m_phaseGradient_32F1C, i, j) = tmp + c2pi;
+				}
+			}
+		}
+	}
+}
+
+
+//Compute the gradient phase based on LUT. Range = (0,2pi).
+void FFME::gradPhaseLut()
+{
+	int i,j,k,noRuns;
+	int* runs;
+	int shift = 255*4; //Shift for accessing to LUT.
+	for(i=0;i<m_horGradient_S161C->height;i++)
+	{
+		tileRuns(i, TILE_NEIGHBOR, &runs, &noRuns); //Columns that are not skipped.
+		for(k=0;k<noRuns;k++)
+		{
+			for(j=runs[2*k];j<runs[2*k+1];j++)
+			{
+				pixelImg32F1C_M(m_phaseGradient_32F1C, i, j) = 
+				    m_LutPhaseGradient[pixelImgS161C_M(m_verGradient_S161C, i, j) + shift][pixelImgS161C_M(m_horGradient_S161C, i, j) + shift];
+			}
+		}
+	}
+}
+
+
+/* Compute the orientations histograms.
+   Input:
+   -img_U81C: unsigned 8 bit input image.
+   -singPto: singular point.
+   -descriptor: (input/output) descriptor vector corresponding to the singular points. The function doesn't reserve memory.
+   Output: --
+*/
+void FFME::orientHist(CvPoint2D32f* singPto, float* descriptor)
+{
+	int i,j,r,s,width,radius;
+	float phaseFactor, exponent, w, shift, rbin0, cbin0, rbin, cbin, obin, gradVal;
+
+	phaseFactor = (float)(m_noBinsOriHist / (2.0 * CV_PI));
+	exponent = (float)(m_widthArrayHist * m_widthArrayHist * 0.5); //Exponent of the Gaussian smoothing.
+	shift = (float)(m_widthArrayHist * 0.5); //Shift for the coordinates.
+	width = m_widthArrayHist * m_widthSubWinHist; //Width in pixels of the neighborhood.
+	if((width % 2) != 0) //Check if 'width' is odd.
+	{
+		radius = (width-1) / 2;
+		for(i=-radius; i<=radius; i++) 
+		{
+			for(j=-radius; j<=radius; j++) 
+			{
+				r = i + cvRound(singPto->y); //Discrete values.
+				s = j + cvRound(singPto->x);
+
+				//Check that pixel coordinates are inside image bounds.
+				if (checkMargins(m_magGradient_32F1C, r, s))
+				{
+		
+				//Array histogram coordinates to calculate the Gaussian smoothing contribution.
+				rbin0 = ((float)i / m_widthSubWinHist); //Continuos values.
+				cbin0 = ((float)j / m_widthSubWinHist);
+				//Shifted array histogram coordinates.
+				rbin = rbin0 + shift;
+				cbin = cbin0 + shift;
+				
+				w = exp(-(cbin0*cbin0 + rbin0*rbin0) / exponent);//Weigths related to the Gaussian smoothing.
+				gradVal = pixelImg32F1C_M(m_magGradient_32F1C, r, s);//Gradient magnitude value.
+				obin = pixelImg32F1C_M(m_phaseGradient_32F1C, r, s) * phaseFactor;//Orientation bin.	
+				//Orientation histogram contributions by trilinear interpolation.
+				trilinearInterp(rbin, cbin, obin, gradVal*w, descriptor);
+				}
+			}
+		}
+	}
+	else
+	{
+		radius = width / 2;
+		for(i=-radius; i<radius; i++) 
+		{
+			for(j=-radius; j<radius; j++) 
+			{
+				r = i + cvRound(singPto->y); //Discrete values.
+				s = j + cvRound(singPto->x);
+
+				//Check that pixel coordinates are inside image bounds.
+				if (checkMargins(m_magGradient_32F1C, r, s))
+				{
+					//Array histogram coordinates to calculate the Gaussian smoothing contribution.
+					rbin0 = ((float)(i + 0.5) / m_widthSubWinHist); //Continuos values.
+					cbin0 = ((float)(j + 0.5) / m_widthSubWinHist);
+					//Shifted array histogram coordinates.
+					rbin = rbin0 + shift;
+					cbin = cbin0 + shift;
+
+					w = exp(-(cbin0*cbin0 + rbin0*rbin0) / exponent);//Weigths related to the Gaussian smoothing.
+					gradVal = pixelImg32F1C_M(m_magGradient_32F1C, r, s);//Gradient magnitude value.
+					obin = pixelImg32F1C_M(m_phaseGradient_32F1C, r, s) * phaseFactor;//Orientation bin.	
+					//Orientation histogram contributions by trilinear interpolation.
+					trilinearInterp(rbin, cbin, obin, gradVal*w, descriptor);
+				}
+			}
+		}
+	}
+}
+
+
+/* Orientation histogram contributions by trilinear interpolation.
+   Input:
+   -rbin, cbin: raw and column bin. 
+   -obin: orientation bin.
+   -gradVal: gradient value.
+   -descriptor: address of the descriptor related to the singular point.
+   Output:--
+*/
+void FFME::trilinearInterp(float rbin, float cbin, float obin, float gradVal, float* descriptor)
+{
+	float d_r, d_c, d_o, val1, val2, val3;
+	int shiftRow, shiftCol;
+	int r0, c0, o0, rb, cb, ob, r, c, o;
+
+	//Rectify the contribution to the bin.
+	rbin = rbin-0.5f;
+	cbin = cbin-0.5f;
+	//Interpolation factors.
+	r0 = cvFloor(rbin);
+	c0 = cvFloor(cbin);
+	o0 = cvFloor(obin);
+	d_r = rbin - r0;
+	d_c = cbin - c0;
+	d_o = obin - o0;
+
+	//Trilinear interpolation. A pixel can contributed up to 8 orientation bins.
+	for(r = 0; r <= 1; r++)
+	{
+		rb = r0 + r;
+		if(rb >= 0  &&  rb <= m_widthArrayHist-1)
+		{
+			val1 = gradVal*(( r == 0 )? 1.0f - d_r : d_r);
+			shiftRow = rb*m_widthArrayHist*m_noBinsOriHist;
+			for(c = 0; c <= 1; c++)
+			{
+				cb = c0 + c;
+				if(cb >= 0  &&  cb <= m_widthArrayHist-1)
+				{
+					val2 = val1*(( c == 0 )? 1.0f - d_c : d_c);
+					shiftCol = cb*m_noBinsOriHist;
+					for(o = 0; o <= 1; o++)
+					{
+						val3 = val2*(( o == 0 )? 1.0f - d_o : d_o);
+						ob = (o0 + o) % m_noBinsOriHist; //Range checking.
+						*(descriptor+shiftRow+shiftCol+ob) += val3;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+/* Normalization of descriptor vector.
+   The purpose of the normalization is to be invariant to affine 
+   illumnination changes and to present some robustness to non-linear illuminations changes.
+   Input:
+   -descriptor: vector descriptor obtained by the function 'singPtoDescXXX()'.
+   -length: number of components of the descriptor vector.
+   -maxRespComp: maximum response allowed per vector component.
+   Output: --
+*/
+void FFME::normDescrip(float* descriptor, int length, float maxRespComp)
+{
+	int i;
+	bool reNorm = false;
+
+	//Normalization.
+	normVector(descriptor, length);
+	
+	//Restrict the contribution of each vector. It makes the descriptor more robust to non-linear illumination changes.
+	for(i = 0; i<length; i++)
+	{
+		if(descriptor[i] > maxRespComp)
+		{
+			descriptor[i] = maxRespComp;
+			reNorm = true;
+		}
+	}
+	
+	//Re-normalization.
+	if(reNorm)
+	{
+		normVector(descriptor, length);
+	}
+}
+
+
+/* Vector normalization for float type.
+   Inputs:
+   -vector: vector to be normalized. 
+   -length: vector length.
+   Outputs: --
+*/
+void FFME::normVector(float* vector, int length)
+{
+	int i;
+	float val, sumSq, invSumSq;
+
+	sumSq = 0;
+	for(i=0; i<length; i++)
+	{
+		val = vector[i];
+		sumSq += val*val;
+	}
+	invSumSq = (float)(1.0 / sqrt(sumSq)); 
+	for(i = 0; i<length; i++)
+	{
+		vector[i] *= invSumSq;
+	}
+}
+
+
+/* Location of a point predicted by the motion prior.
+   Inputs:
+   -pto: location of the point in the first image.
+   -xPred: (input/output) predicted horizontal coordinate in the second image.
+   -yPred: (input/output) predicted vertical coordinate in the second image.
+   Outputs: --
+*/
+void FFME::predictPto(CvPoint2D32f* pto, float* xPred, float* yPred)
+{
+	int c, r;
+
+	switch(m_motionPrior)
+	{
+	case MOTION_PRIOR_AFFINE:
+		*xPred = m_affinePrior[0]*pto->x + m_affinePrior[1]*pto->y + m_affinePrior[2];
+		*yPred = m_affinePrior[3]*pto->x + m_affinePrior[4]*pto->y + m_affinePrior[5];
+		break;
+	case MOTION_PRIOR_GRID:
+		c = MIN(MAX(cvFloor(pto->x / m_widthCellGrid), 0), m_noColsGrid-1);
+		r = MIN(MAX(cvFloor(pto->y / m_widthCellGrid), 0), m_noRowsGrid-1);
+		*xPred = pto->x + m_gridPrior[r*m_noColsGrid+c].x;
+		*yPred = pto->y + m_gridPrior[r*m_noColsGrid+c].y;
+		break;
+	default:
+		*xPred = pto->x;
+		*yPred = pto->y;
+	}
+}
+
+
+/* Search of the best and second best correspondences of a singular point of the first image inside the search window.
+   The function only reads class members, so it can be called concurrently.
+   Inputs:
+   -singPto1: location of the singular point in the first image.
+   -desc1: descriptor of the singular point in the first image.
+   -singPtos2: array of locations related to the singular points in the second image.
+   -noSingPtos2: number of singular points in the second image.
+   -descriptors2: array of descriptors related to the singular points in the second image.
+   -j1: (input/output) index of the best correspondence in the second image, or -1 if there is none.
+   -minDist1: (input/output) descriptor distance to the best correspondence (FLT_MAX if there is none).
+   -j2: (input/output) index of the second best correspondence in the second image, or -1 if there is none.
+   -minDist2: (input/output) descriptor distance to the second best correspondence (FLT_MAX if there is none).
+   Outputs: --
+*/
+void FFME::searchBest2(CvPoint2D32f* singPto1, float* desc1, CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2,
+					   int* j1, float* minDist1, int* j2, float* minDist2)
+{
+	int j;
+	int lengthDesc = m_widthArrayHist*m_widthArrayHist*m_noBinsOriHist;
+	float dist;
+	float x1, y1;
+	*minDist1 = FLT_MAX;
+	*minDist2 = FLT_MAX;
+	*j1 = -1;
+	*j2 = -1;
+
+	//The search window is centered on the location predicted by the motion prior.
+	predictPto(singPto1, &x1, &y1);
+
+	for(j = 0; j < noSingPtos2; j++)
+	{
+		float x2 = singPtos2[j].x;
+		float y2 = singPtos2[j].y;
+		float* desc2 = descriptors2[j];
+		
+		//Maximum radius search restriction. Manhattan distance.
+		if(m_radMaxSearch >= abs(x2-x1) && m_radMaxSearch >= abs(y2-y1))
+		{
+			//Similarity measure between descriptor based on Euclidean distance.
+			euclDist(desc1, desc2, lengthDesc, &dist);
+
+			//Check if it is the most similar.
+			if(dist < *minDist1 )
+			{
+				*minDist1 = dist;
+				*j1 = j;
+			}
+			//Check if it is the second most similar.
+			else if(dist < *minDist2)
+			{
+				*minDist2 = dist;
+				*j2 = j;
+			}
+		}
+	}
+}
+
+
+/* Search of the correspondence of a singular point of the first image. The second nearest neighbor restriction is applied.
+   The function only reads class members, except the counter of the instrumentation (m_noMatchedStats), which is only
+   updated atomically with OpenMP. Hence it can be called concurrently from OpenMP threads, or from any threads if
+   FFME_NO_STATS is defined.
+   Inputs:
+   -singPto1: location of the singular point in the first image.
+   -desc1: descriptor of the singular point in the first image.
+   -singPtos2: array of locations related to the singular points in the second image.
+   -noSingPtos2: number of singular points in the second image.
+   -descriptors2: array of descriptors related to the singular points in the second image.
+   -minDist1: (input/output) descriptor distance to the best correspondence. It can be NULL.
+   -minDist2: (input/output) descriptor distance to the second best correspondence (FLT_MAX if there is none). It can be NULL.
+   Outputs: index of the corresponding point in the second image, or -1 if there is no reliable correspondence.
+*/
+int FFME::searchCorr(CvPoint2D32f* singPto1, float* desc1, CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2,
+					 float* minDist1, float* minDist2)
+{
+	int j1, j2;
+	float dist1, dist2;
+
+	searchBest2(singPto1, desc1, singPtos2, noSingPtos2, descriptors2, &j1, &dist1, &j2, &dist2);
+#ifdef FFME_STATS
+	//Points with at least one candidate (the search can be distributed among several threads).
+	if(j1 != -1)
+	{
+#ifdef _OPENMP
+		#pragma omp atomic
+#endif
+		m_noMatchedStats++;
+	}
+#endif
+	if(minDist1)
+	{
+		*minDist1 = dist1;
+	}
+	if(minDist2)
+	{
+		*minDist2 = dist2;
+	}
+
+	if (j1 != -1 && j2 != -1)
+	{
+		//Second nearest neighbor restriction.
+		if(dist1 <= dist2 * m_threshRatSecBest)
+		{
+			return j1;
+		}
+	}
+	//Only one correspondence exists, so it is supposed correct.
+	else if(j1 != -1 && j2 == -1)
+	{		
+		return j1;
+	}
+
+	return -1;
+}
+
+
+/* Euclidean distance of two vectors of type float.
+   Inputs:
+   -vector1: float vector.
+   -vector2: float vector.
+   -length: length of vector 1 and 2.
+   -dist: (input/output) euclidean distance.
+   Outputs: --
+*/
+void FFME::euclDist(float* vector1, float* vector2, int length, float* dist)
+{
+	int i;
+	float tmp, dif;
+		
+	tmp = 0;
+	for( i = 0; i < length; i++ )
 	{
-		for(j=0;j<m_horGradient_S161C->width;j++)
-		{
-			pixelImg32F1C_M(m_magGradient_32F1C, i, j) = 
-				m_LutMagGradient[pixelImgS161C_M(m_verGradient_S161C, i, j) + shift][pixelImgS161C_M(m_horGradient_S161C, i, j) + shift];
-		}
+		dif = vector1[i] - vector2[i];
+		tmp += dif * dif;
 	}
+	*dist = sqrt(tmp);
 }
 
 
-/* Selection of points by gradient magnitude thresholding. The 'noPix' nearer from image borders are discarded.
+/*--Integer pipeline--*/
+
+/* Selection of points by thresholding of the squared gradient magnitude (integer pipeline). The magnitude is not
+   computed, so the points are the ones of 'gradMagThresh()' with the threshold sqrt('threshSq'). The 'noPix' nearer
+   from image borders are discarded.
    Inputs:
-   -thresh: gradient magnitude threshold. You must take into account that the gradient magnitud range is [0,].
+   -threshSq: squared gradient magnitude threshold.
    -noPix: number of pixels discarded from the image borders.
    Output: --
 */
-void FFME::gradMagThresh(float thresh, int noPix)
+void FFME::gradMagThreshInt(int threshSq, int noPix)
 {
-	int i,j;
-	int width = m_magGradient_32F1C->width;
-	int height = m_magGradient_32F1C->height;
+	int i,j,k,noRuns;
+	int* runs;
+	int width = m_horGradient_S161C->width;
+	int height = m_horGradient_S161C->height;
+	int maxNoCandidates = width * height;
+	int limit;
 	m_noPtosGrad = 0;
 	int condition1 = height-noPix;
 	int condition2 = width-noPix;
+	if(m_maxNoCandidates > 0 && m_maxNoCandidates < maxNoCandidates)
+	{
+		maxNoCandidates = m_maxNoCandidates;
+	}
 	for(i=noPix;i<condition1;i++)
 	{
-		for(j=noPix;j<condition2;j++)
+		//Capacity for a whole row.
+		if(m_noPtosGrad + condition2 - noPix > m_capCandidates && m_capCandidates < maxNoCandidates)
 		{
-			if(pixelImg32F1C_M(m_magGradient_32F1C, i, j) >= thresh)
+			growCandidates(m_noPtosGrad + condition2 - noPix, maxNoCandidates);
+		}
+		limit = MIN(m_capCandidates, maxNoCandidates);
+		short* rowDx = &pixelImgS161C_M(m_horGradient_S161C, i, 0);
+		short* rowDy = &pixelImgS161C_M(m_verGradient_S161C, i, 0);
+		tileRuns(i, TILE_NON_FLAT, &runs, &noRuns); //The flat tiles have no candidate points.
+		for(k=0;k<noRuns;k++)
+		{
+			for(j=MAX(runs[2*k], noPix);j<MIN(runs[2*k+1], condition2);j++)
 			{
-				m_ptosGrad[m_noPtosGrad++] = cvPoint2D32f((float)j,(float)i);
+				if(rowDx[j]*rowDx[j] + rowDy[j]*rowDy[j] >= threshSq)
+				{
+					if(m_noPtosGrad == limit)
+					{
+						return;
+					}
+					m_ptosGrad[m_noPtosGrad].x = (unsigned short)j;
+					m_ptosGrad[m_noPtosGrad].y = (unsigned short)i;
+					m_noPtosGrad++;
+				}
 			}
 		}
 	}
 }
 
 
-/* Selection of points of high cornerness. 
+/* Selection of points of high cornerness with integer arithmetic (integer pipeline). The structure tensor is summed in
+   64 bit integers and scaled down to 21 bits, so the trace and the determinant are exact 64 bit products (the Harris
+   condition does not depend on the scale). The threshold is rounded to 1/16 and the condition is checked without
+   divisions: t*trace^2 < (t+1)^2*det. It supports thresholds up to 64. The cornerness of the selected points is stored
+   in Q16 in the integer cornerness image, which shares the memory of the floating point one.
    Inputs:
    -thresh: cornerness threshold based on Harris condition (ratio of eigenvalues).
    -sizeWin: size of the window used to calculate the cornerness.
    Output: --
 */
-void FFME::cornerThresh(float thresh, int sizeWin)
+void FFME::cornerThreshInt(float thresh, int sizeWin)
 {
-	int i, u, v;
+	int i, u, v, shift;
 	int rWin = cvRound((sizeWin-1)/2.0);
-	float avgdx, avgdy, avgdxdy, trace, det, cornerness;
-	float harrisCond = (thresh+1)*(thresh+1)/thresh; //Harris condition for cornerness.
+	int threshQ = cvRound(thresh * 16); //Threshold in Q4.
+	int64 sumdx, sumdy, sumdxdy, trace, det;
+	int64 harrisNum = (int64)threshQ * 16; //Harris condition for cornerness: 16*tQ*trace^2 < (tQ+16)^2*det.
+	int64 harrisDen = (int64)(threshQ + 16) * (threshQ + 16);
 	m_noPtosCornerness = 0;
-	cvSet(m_cornerness_32F1C, cvScalar(FLT_MAX)); //Sparse cornerness map that is used by 'nonMinSupCorner()' function.
+
+	//Sparse cornerness map that is used by 'nonMinSupCornerInt()' function.
+	cvInitImageHeader(&m_cornernessIntHeader, cvGetSize(m_cornerness_32F1C), IPL_DEPTH_32S, 1, m_cornerness_32F1C->origin);
+	cvSetData(&m_cornernessIntHeader, m_cornerness_32F1C->imageData, m_cornerness_32F1C->widthStep);
+	cvSet(&m_cornernessIntHeader, cvScalar(INT_MAX));
 
 	for(i=0;i<m_noPtosGrad;i++)
 	{
-		CvPoint pto = cvPointFrom32f(m_ptosGrad[i]);
-		
+		CvPoint pto = cvPoint(m_ptosGrad[i].x, m_ptosGrad[i].y);
+
 		//The point is discarded if its neighborhood is not inside the image bounds. 
 		if(checkSquareReg(m_horGradient_S161C, pto.y, pto.x, rWin))
-		{		
-			avgdx = 0;
-			avgdy = 0;
-			avgdxdy = 0;
+		{
+			sumdx = 0;
+			sumdy = 0;
+			sumdxdy = 0;
 			int condition1 = pto.y + rWin;
 			int condition2 = pto.x + rWin;
 			for(v=pto.y-rWin; v<=condition1; v++)
 			{
 				for(u=pto.x-rWin; u<=condition2; u++)
 				{
-					//Matrix A of Harris: average gradient matrix. The average is not isotropic.
+					//Matrix A of Harris: sum of the gradient products.
 					int dxTmp = pixelImgS161C_M(m_horGradient_S161C, v, u);
 					int dyTmp = pixelImgS161C_M(m_verGradient_S161C, v, u);
-					avgdx += dxTmp * dxTmp;
-					avgdy += dyTmp * dyTmp;
-					avgdxdy += dxTmp * dyTmp;;
+					sumdx += dxTmp * dxTmp;
+					sumdy += dyTmp * dyTmp;
+					sumdxdy += dxTmp * dyTmp;
 				}
 			}
 
-			trace = avgdx + avgdy;
-			det = avgdx * avgdy - avgdxdy * avgdxdy;
+			//Scaling to 21 bits, so the products below do not overflow.
+			shift = 0;
+			while((MAX(sumdx, sumdy) >> shift) >= (1 << 21))
+			{
+				shift++;
+			}
+			sumdx >>= shift;
+			sumdy >>= shift;
+			sumdxdy >>= shift;
+
+			trace = sumdx + sumdy;
+			det = sumdx * sumdy - sumdxdy * sumdxdy;
 			//The point is discarded if its determinant is negative or zero.
 			if(det > 0)
 			{
-				cornerness = trace * trace / det;
 				//Check the corner restriction.
-				if(cornerness < harrisCond)
+				if(harrisNum * trace * trace < harrisDen * det)
 				{
 					m_ptosCornerness[m_noPtosCornerness++] = m_ptosGrad[i];
-					pixelImg32F1C_M(m_cornerness_32F1C, pto.y, pto.x) = cornerness;
+					pixelImgS321C_M(&m_cornernessIntHeader, pto.y, pto.x) = (int)(((trace * trace) << 16) / det);
 				}
 			}
 		}
@@ -438,48 +2896,47 @@ void FFME::cornerThresh(float thresh, int sizeWin)
 }
 
 
-/* Non minimal supression in the cornerness space.
+/* Non minimal supression in the integer cornerness space (integer pipeline).
    Inputs:
    -sizeWin: Size of the window size used to compute the non minimal supression restriction.
-   -ptos: (input/output) array of points that fulfill the non minimal supression restriction. 
-          The function doesn't reserve memory.
+   -ptos: (input/output) array of points that fulfill the non minimal supression restriction, in the space of the input
+          image (see 'setDecimation()'). The function doesn't reserve memory.
    -noPtos: (input/output) number of points that fulfill the non minimal supression restriction.
    Output: --
 */
-void FFME::nonMinSupCorner(int sizeWin, CvPoint2D32f* ptos, int* noPtos)
+void FFME::nonMinSupCornerInt(int sizeWin, CvPoint2D32f* ptos, int* noPtos)
 {
-    int i, v, u;
+	int i, v, u;
 	int rWin = cvFloor((sizeWin-1)/2.0);
+	float scale = (float)m_decimation; //Mapping to the space of the input image.
+	float offset = (m_decimation - 1) * 0.5f;
 	*noPtos = 0;
 
 	for(i=0;i<m_noPtosCornerness;i++)
 	{
-		CvPoint pto = cvPointFrom32f(m_ptosCornerness[i]);
-		float val = pixelImg32F1C_M(m_cornerness_32F1C, pto.y, pto.x);
+		CvPoint pto = cvPoint(m_ptosCornerness[i].x, m_ptosCornerness[i].y);
+		int val = pixelImgS321C_M(&m_cornernessIntHeader, pto.y, pto.x);
 		int condition1 = pto.y+rWin;
 		int condition2 = pto.x+rWin;
-		if( val > 0 )//Check for minimum.
+		for( v = pto.y-rWin; v <= condition1; v++ )
 		{
-			for( v = pto.y-rWin; v <= condition1; v++ )
+			for( u = pto.x-rWin; u <= condition2; u++ )
 			{
-				for( u = pto.x-rWin; u <= condition2; u++ )
+				if( val > pixelImgS321C_M(&m_cornernessIntHeader, v, u))
 				{
-					if( val > pixelImg32F1C_M(m_cornerness_32F1C, v, u))
-					{
-						goto noMin;
-					}
+					goto noMin;
 				}
 			}
-			
-			//Check the maximum number of singular points allowed.
-			if((*noPtos) <= (m_maxNoKeyPoints - 1))
-			{
-				ptos[(*noPtos)++] = m_ptosCornerness[i];
-			}
-			else
-			{
-				return;
-			} 
+		}
+
+		//Check the maximum number of singular points allowed.
+		if((*noPtos) <= (m_maxNoKeyPoints - 1))
+		{
+			ptos[(*noPtos)++] = cvPoint2D32f(pto.x * scale + offset, pto.y * scale + offset);
+		}
+		else
+		{
+			return;
 		}
 
 		noMin:
@@ -488,150 +2945,151 @@ void FFME::nonMinSupCorner(int sizeWin, CvPoint2D32f* ptos, int* noPtos)
 }
 
 
-//Compute the gradient phase based on functions. Range = (0,2pi).
-void FFME::gradPhaseFunc()
+/* Integer square root (floor) of a 32 bit value, computed bit by bit.
+   Inputs:
+   -val: value.
+   Outputs: square root.
+*/
+static inline unsigned int isqrtInt(unsigned int val)
 {
-	int i,j;
-	const float c2pi = (float)(2 * CV_PI);
-	for(i=0;i<m_horGradient_S161C->height;i++)
+	unsigned int res = 0;
+	unsigned int bit = 1u << 30;
+	while(bit > val)
+	{
+		bit >>= 2;
+	}
+	while(bit != 0)
 	{
-		for(j=0;j<m_horGradient_S161C->width;j++)
+		if(val >= res + bit)
 		{
-			int dx = pixelImgS161C_M(m_horGradient_S161C, i, j);
-			int dy = pixelImgS161C_M(m_verGradient_S161C, i, j);
-			float tmp = atan2((float)dy, (float)dx); //[-pi,pi]
-			//Correct the phase to [0,2pi].
-			if(tmp >= 0)
-			{
-				pixelImg32F1C_M(m_phaseGradient_32F1C, i, j) = tmp;
-			}
-			else
-			{
-				pixelImg32F1C_M(m_phaseGradient_32F1C, i, j) = tmp + c2pi;
-			}
+			val -= res + bit;
+			res = (res >> 1) + bit;
+		}
+		else
+		{
+			res >>= 1;
 		}
+		bit >>= 2;
 	}
+	return res;
 }
 
 
-//Compute the gradient phase based on LUT. Range = (0,2pi).
-void FFME::gradPhaseLut()
+/* Integer square root (floor) of a 64 bit value, computed bit by bit.
+   Inputs:
+   -val: value.
+   Outputs: square root.
+*/
+static unsigned int isqrtInt64(uint64 val)
 {
-	int i,j;
-	int shift = 255*4; //Shift for accessing to LUT.
-	for(i=0;i<m_horGradient_S161C->height;i++)
+	uint64 res = 0;
+	uint64 bit = (uint64)1 << 62;
+	while(bit > val)
+	{
+		bit >>= 2;
+	}
+	while(bit != 0)
 	{
-		for(j=0;j<m_horGradient_S161C->width;j++)
+		if(val >= res + bit)
+		{
+			val -= res + bit;
+			res = (res >> 1) + bit;
+		}
+		else
 		{
-			pixelImg32F1C_M(m_phaseGradient_32F1C, i, j) = 
-			    m_LutPhaseGradient[pixelImgS161C_M(m_verGradient_S161C, i, j) + shift][pixelImgS161C_M(m_horGradient_S161C, i, j) + shift];
+			res >>= 1;
 		}
+		bit >>= 2;
 	}
+	return (unsigned int)res;
 }
 
 
-/* Compute the orientations histograms.
+/* Compute the orientations histograms in fixed-point arithmetic (integer pipeline). The gradient magnitude is computed
+   in Q4 with an integer square root, and the orientation as a binary angle (a full turn is 65536) with the arctangent
+   LUT of the engine and the symmetries of the octants. The Gaussian weights are the ones computed by 'singPtoDescInt()'.
    Input:
-   -img_U81C: unsigned 8 bit input image.
-   -singPto: singular point.
-   -descriptor: (input/output) descriptor vector corresponding to the singular points. The function doesn't reserve memory.
+   -row, col: location of the singular point (in the decimated image).
+   -hist: (input/output) orientation histograms (Q8). The function doesn't reserve memory.
    Output: --
 */
-void FFME::orientHist(CvPoint2D32f* singPto, float* descriptor)
+void FFME::orientHistInt(int row, int col, int* hist)
 {
-	int i,j,r,s,width,radius;
-	float phaseFactor, exponent, w, shift, rbin0, cbin0, rbin, cbin, obin, gradVal;
+	int i, j, r, s, dx, dy, ax, ay, angle, mag, rbin, cbin, obin;
+	int width = m_widthArrayHist * m_widthSubWinHist; //Width in pixels of the neighborhood.
+	int radius = width / 2;
+	int even = 1 - (width % 2); //Even neighborhoods are centered between pixels.
+	int shiftBin = (m_widthArrayHist * 128 + 128) * m_widthSubWinHist; //Shift of the bins (Q8), plus one bin.
 
-	phaseFactor = (float)(m_noBinsOriHist / (2.0 * CV_PI));
-	exponent = (float)(m_widthArrayHist * m_widthArrayHist * 0.5); //Exponent of the Gaussian smoothing.
-	shift = (float)(m_widthArrayHist * 0.5); //Shift for the coordinates.
-	width = m_widthArrayHist * m_widthSubWinHist; //Width in pixels of the neighborhood.
-	if((width % 2) != 0) //Check if 'width' is odd.
+	for(i=0; i<width; i++)
 	{
-		radius = (width-1) / 2;
-		for(i=-radius; i<=radius; i++) 
+		r = row + i - radius;
+		//Row bin (Q8) shifted by one bin, so it is positive.
+		rbin = ((2*(i - radius) + even) * 128 + shiftBin + m_widthSubWinHist/2) / m_widthSubWinHist;
+		for(j=0; j<width; j++)
 		{
-			for(j=-radius; j<=radius; j++) 
+			s = col + j - radius;
+
+			//Check that pixel coordinates are inside image bounds.
+			if (checkMargins(m_horGradient_S161C, r, s))
 			{
-				r = i + cvRound(singPto->y); //Discrete values.
-				s = j + cvRound(singPto->x);
+				cbin = ((2*(j - radius) + even) * 128 + shiftBin + m_widthSubWinHist/2) / m_widthSubWinHist;
+				dx = pixelImgS161C_M(m_horGradient_S161C, r, s);
+				dy = pixelImgS161C_M(m_verGradient_S161C, r, s);
 
-				//Check that pixel coordinates are inside image bounds.
-				if (checkMargins(m_magGradient_32F1C, r, s))
+				//Gradient magnitude (Q4).
+				mag = (int)isqrtInt((unsigned int)(dx*dx + dy*dy) << 8);
+
+				//Gradient orientation: angle of the first octant and symmetries.
+				ax = abs(dx);
+				ay = abs(dy);
+				if(ay <= ax)
 				{
-		
-				//Array histogram coordinates to calculate the Gaussian smoothing contribution.
-				rbin0 = ((float)i / m_widthSubWinHist); //Continuos values.
-				cbin0 = ((float)j / m_widthSubWinHist);
-				//Shifted array histogram coordinates.
-				rbin = rbin0 + shift;
-				cbin = cbin0 + shift;
-				
-				w = exp(-(cbin0*cbin0 + rbin0*rbin0) / exponent);//Weigths related to the Gaussian smoothing.
-				gradVal = pixelImg32F1C_M(m_magGradient_32F1C, r, s);//Gradient magnitude value.
-				obin = pixelImg32F1C_M(m_phaseGradient_32F1C, r, s) * phaseFactor;//Orientation bin.	
-				//Orientation histogram contributions by trilinear interpolation.
-				trilinearInterp(rbin, cbin, obin, gradVal*w, descriptor);
+					angle = (ax == 0)? 0 : m_LutAtanInt[((ay << NO_BITS_ATAN_INT) + (ax >> 1)) / ax];
 				}
-			}
-		}
-	}
-	else
-	{
-		radius = width / 2;
-		for(i=-radius; i<radius; i++) 
-		{
-			for(j=-radius; j<radius; j++) 
-			{
-				r = i + cvRound(singPto->y); //Discrete values.
-				s = j + cvRound(singPto->x);
-
-				//Check that pixel coordinates are inside image bounds.
-				if (checkMargins(m_magGradient_32F1C, r, s))
+				else
 				{
-					//Array histogram coordinates to calculate the Gaussian smoothing contribution.
-					rbin0 = ((float)(i + 0.5) / m_widthSubWinHist); //Continuos values.
-					cbin0 = ((float)(j + 0.5) / m_widthSubWinHist);
-					//Shifted array histogram coordinates.
-					rbin = rbin0 + shift;
-					cbin = cbin0 + shift;
-
-					w = exp(-(cbin0*cbin0 + rbin0*rbin0) / exponent);//Weigths related to the Gaussian smoothing.
-					gradVal = pixelImg32F1C_M(m_magGradient_32F1C, r, s);//Gradient magnitude value.
-					obin = pixelImg32F1C_M(m_phaseGradient_32F1C, r, s) * phaseFactor;//Orientation bin.	
-					//Orientation histogram contributions by trilinear interpolation.
-					trilinearInterp(rbin, cbin, obin, gradVal*w, descriptor);
+					angle = 16384 - m_LutAtanInt[((ax << NO_BITS_ATAN_INT) + (ay >> 1)) / ay];
 				}
+				if(dx < 0)
+				{
+					angle = 32768 - angle;
+				}
+				if(dy < 0)
+				{
+					angle = (65536 - angle) & 65535;
+				}
+				obin = (angle * m_noBinsOriHist) >> 8; //Orientation bin (Q8).
+
+				//Orientation histogram contributions by trilinear interpolation. The weighted magnitude is in Q8.
+				trilinearInterpInt(rbin, cbin, obin, (mag * m_weightsDescInt[i*width+j]) >> 8, hist);
 			}
 		}
 	}
 }
 
 
-/* Orientation histogram contributions by trilinear interpolation.
+/* Orientation histogram contributions by trilinear interpolation in fixed-point arithmetic (integer pipeline).
    Input:
-   -rbin, cbin: raw and column bin. 
-   -obin: orientation bin.
-   -gradVal: gradient value.
-   -descriptor: address of the descriptor related to the singular point.
+   -rbin, cbin: raw and column bin (Q8), shifted by one bin.
+   -obin: orientation bin (Q8).
+   -gradVal: weighted gradient value (Q8).
+   -hist: address of the orientation histograms related to the singular point.
    Output:--
 */
-void FFME::trilinearInterp(float rbin, float cbin, float obin, float gradVal, float* descriptor)
+void FFME::trilinearInterpInt(int rbin, int cbin, int obin, int gradVal, int* hist)
 {
-	float d_r, d_c, d_o, val1, val2, val3;
+	int d_r, d_c, d_o, val1, val2, val3;
 	int shiftRow, shiftCol;
 	int r0, c0, o0, rb, cb, ob, r, c, o;
 
-	//Rectify the contribution to the bin.
-	rbin = rbin-0.5f;
-	cbin = cbin-0.5f;
-	//Interpolation factors.
-	r0 = cvFloor(rbin);
-	c0 = cvFloor(cbin);
-	o0 = cvFloor(obin);
-	d_r = rbin - r0;
-	d_c = cbin - c0;
-	d_o = obin - o0;
+	//Interpolation factors (Q8).
+	r0 = (rbin >> 8) - 1;
+	c0 = (cbin >> 8) - 1;
+	o0 = obin >> 8;
+	d_r = rbin & 255;
+	d_c = cbin & 255;
+	d_o = obin & 255;
 
 	//Trilinear interpolation. A pixel can contributed up to 8 orientation bins.
 	for(r = 0; r <= 1; r++)
@@ -639,20 +3097,20 @@ void FFME::trilinearInterp(float rbin, float cbin, float obin, float gradVal, fl
 		rb = r0 + r;
 		if(rb >= 0  &&  rb <= m_widthArrayHist-1)
 		{
-			val1 = gradVal*(( r == 0 )? 1.0f - d_r : d_r);
+			val1 = (gradVal * (( r == 0 )? 256 - d_r : d_r)) >> 8;
 			shiftRow = rb*m_widthArrayHist*m_noBinsOriHist;
 			for(c = 0; c <= 1; c++)
 			{
 				cb = c0 + c;
 				if(cb >= 0  &&  cb <= m_widthArrayHist-1)
 				{
-					val2 = val1*(( c == 0 )? 1.0f - d_c : d_c);
+					val2 = (val1 * (( c == 0 )? 256 - d_c : d_c)) >> 8;
 					shiftCol = cb*m_noBinsOriHist;
 					for(o = 0; o <= 1; o++)
 					{
-						val3 = val2*(( o == 0 )? 1.0f - d_o : d_o);
+						val3 = (val2 * (( o == 0 )? 256 - d_o : d_o)) >> 8;
 						ob = (o0 + o) % m_noBinsOriHist; //Range checking.
-						*(descriptor+shiftRow+shiftCol+ob) += val3;
+						*(hist+shiftRow+shiftCol+ob) += val3;
 					}
 				}
 			}
@@ -661,86 +3119,165 @@ void FFME::trilinearInterp(float rbin, float cbin, float obin, float gradVal, fl
 }
 
 
-/* Normalization of descriptor vector.
-   The purpose of the normalization is to be invariant to affine 
-   illumnination changes and to present some robustness to non-linear illuminations changes.
+/* Normalization and quantization of an integer descriptor vector (integer pipeline). The histograms are normalized,
+   clipped and normalized again like in 'normDescrip()', and the components are stored in unsigned 8 bit with the scale
+   SCALE_DESC_INT (saturated to 255). A vector without gradient gives a null descriptor.
    Input:
-   -descriptor: vector descriptor obtained by the function 'singPtoDescXXX()'.
+   -hist: orientation histograms obtained by 'orientHistInt()'. They are modified.
    -length: number of components of the descriptor vector.
    -maxRespComp: maximum response allowed per vector component.
+   -descriptor: (input/output) integer descriptor. The function doesn't reserve memory.
    Output: --
 */
-void FFME::normDescrip(float* descriptor, int length, float maxRespComp)
+void FFME::normDescripInt(int* hist, int length, float maxRespComp, unsigned char* descriptor)
 {
 	int i;
+	int64 sumSq, maxComp, val;
+	unsigned int norm;
 	bool reNorm = false;
 
-	//Normalization.
-	normVector(descriptor, length);
-	
+	//Norm.
+	sumSq = 0;
+	for(i=0; i<length; i++)
+	{
+		sumSq += (int64)hist[i] * hist[i];
+	}
+	norm = isqrtInt64(sumSq);
+	if(norm == 0)
+	{
+		memset(descriptor, 0, length);
+		return;
+	}
+
 	//Restrict the contribution of each vector. It makes the descriptor more robust to non-linear illumination changes.
+	maxComp = ((int64)cvRound(maxRespComp * 256) * norm) >> 8;
 	for(i = 0; i<length; i++)
 	{
-		if(descriptor[i] > maxRespComp)
+		if(hist[i] > maxComp)
 		{
-			descriptor[i] = maxRespComp;
+			hist[i] = (int)maxComp;
 			reNorm = true;
 		}
 	}
-	
+
 	//Re-normalization.
 	if(reNorm)
 	{
-		normVector(descriptor, length);
+		sumSq = 0;
+		for(i=0; i<length; i++)
+		{
+			sumSq += (int64)hist[i] * hist[i];
+		}
+		norm = isqrtInt64(sumSq);
+	}
+
+	//Quantization.
+	for(i=0; i<length; i++)
+	{
+		val = ((int64)hist[i] * SCALE_DESC_INT + norm/2) / norm;
+		descriptor[i] = (unsigned char)MIN(val, 255);
 	}
 }
 
 
-/* Vector normalization for float type.
+/* Search of the correspondence of a singular point of the first image with integer descriptors (integer pipeline).
+   The logic is the one of 'searchCorr()' with squared distances: the second nearest neighbor restriction compares the
+   squared distances with the squared ratio threshold (Q16). Concurrent calls have the restrictions of 'searchCorr()'
+   (counter of the instrumentation).
    Inputs:
-   -vector: vector to be normalized. 
-   -length: vector length.
-   Outputs: --
+   -singPto1: location of the singular point in the first image.
+   -desc1: integer descriptor of the singular point in the first image.
+   -singPtos2: array of locations related to the singular points in the second image.
+   -noSingPtos2: number of singular points in the second image.
+   -descriptors2: array of integer descriptors related to the singular points in the second image.
+   Outputs: index of the corresponding point in the second image, or -1 if there is no reliable correspondence.
 */
-void FFME::normVector(float* vector, int length)
+int FFME::searchCorrInt(CvPoint2D32f* singPto1, unsigned char* desc1, CvPoint2D32f* singPtos2, int noSingPtos2, 
+						unsigned char** descriptors2)
 {
-	int i;
-	float val, sumSq, invSumSq;
+	int j, distSq;
+	int j1 = -1;
+	int j2 = -1;
+	int minDist1 = INT_MAX;
+	int minDist2 = INT_MAX;
+	int lengthDesc = m_widthArrayHist*m_widthArrayHist*m_noBinsOriHist;
+	int64 threshRatSq = cvRound(m_threshRatSecBest * m_threshRatSecBest * 65536); //Squared ratio threshold (Q16).
+	float x1, y1;
 
-	sumSq = 0;
-	for(i=0; i<length; i++)
+	//The search window is centered on the location predicted by the motion prior.
+	predictPto(singPto1, &x1, &y1);
+
+	for(j = 0; j < noSingPtos2; j++)
 	{
-		val = vector[i];
-		sumSq += val*val;
+		float x2 = singPtos2[j].x;
+		float y2 = singPtos2[j].y;
+
+		//Maximum radius search restriction. Manhattan distance.
+		if(m_radMaxSearch >= abs(x2-x1) && m_radMaxSearch >= abs(y2-y1))
+		{
+			//Similarity measure between descriptor based on squared Euclidean distance.
+			euclDistSqInt(desc1, descriptors2[j], lengthDesc, &distSq);
+
+			//Check if it is the most similar.
+			if(distSq < minDist1)
+			{
+				minDist1 = distSq;
+				j1 = j;
+			}
+			//Check if it is the second most similar.
+			else if(distSq < minDist2)
+			{
+				minDist2 = distSq;
+				j2 = j;
+			}
+		}
 	}
-	invSumSq = (float)(1.0 / sqrt(sumSq)); 
-	for(i = 0; i<length; i++)
+#ifdef FFME_STATS
+	//Points with at least one candidate (the search can be distributed among several threads).
+	if(j1 != -1)
 	{
-		vector[i] *= invSumSq;
+#ifdef _OPENMP
+		#pragma omp atomic
+#endif
+		m_noMatchedStats++;
+	}
+#endif
+
+	if (j1 != -1 && j2 != -1)
+	{
+		//Second nearest neighbor restriction.
+		if(((int64)minDist1 << 16) <= threshRatSq * minDist2)
+		{
+			return j1;
+		}
+	}
+	//Only one correspondence exists, so it is supposed correct.
+	else if(j1 != -1 && j2 == -1)
+	{
+		return j1;
 	}
+
+	return -1;
 }
 
 
-/* Euclidean distance of two vectors of type float.
+/* Squared Euclidean distance of two vectors of type unsigned char (integer pipeline).
    Inputs:
-   -vector1: float vector.
-   -vector2: float vector.
+   -vector1: unsigned char vector.
+   -vector2: unsigned char vector.
    -length: length of vector 1 and 2.
-   -dist: (input/output) euclidean distance.
+   -distSq: (input/output) squared euclidean distance.
    Outputs: --
 */
-void FFME::euclDist(float* vector1, float* vector2, int length, float* dist)
+void FFME::euclDistSqInt(unsigned char* vector1, unsigned char* vector2, int length, int* distSq)
 {
-	int i;
-	float tmp, dif;
-		
+	int i, dif, tmp;
+
 	tmp = 0;
 	for( i = 0; i < length; i++ )
 	{
 		dif = vector1[i] - vector2[i];
 		tmp += dif * dif;
 	}
-	*dist = sqrt(tmp);
+	*distSq = tmp;
 }
-
-
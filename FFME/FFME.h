@@ -17,9 +17,21 @@
 #include "cv.h"
 #include "highgui.h"
 #include "cvaux.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 //Others
 #include "miscellaneous.h"
+#include "kdForest.h"
+#include "FFMEEngine.h"
+#include "FFMEStats.h"
+
+//SSE2 intrinsics for the decimation of the images.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSE_DECIMATION
+#include <emmintrin.h>
+#endif
 
 
 //********************************************Parameters******************************************
@@ -28,6 +40,14 @@
 #define THRESH_HARRIS 10 //Cornerness threshold based on Harris condition (ratio of eigenvalues).
 #define WIDTH_WIN_HARRIS 7 //Size of the window used to calculate the cornerness.
 #define WIDTH_WIN_NONMAXSUP 7 //Size of the window used to calculate the non-maximal supression. 
+#define INI_NO_CANDIDATES 16384 //Initial capacity of the lists of candidate points. They grow on demand.
+#define MAX_NO_CANDIDATES 0 //Maximum number of candidate points (gradient restriction) per image. Zero means no limit.
+#define DECIMATION 1 //Decimation factor of the images before the detection and description (1, 2 or 4).
+#define HEIGHT_BAND 32 //Number of rows of the bands of the banded detection ('singPtoDetBand()').
+#define PRE_FILTER_CORNER false //Quick rejection of the candidate points before the evaluation of the full structure tensor.
+#define PRE_FILTER_FACTOR 4 //Factor by which the Harris threshold is relaxed in the quick rejection.
+#define SKIP_FLAT_TILES false //Pre-rejection of the flat regions of the image by tiles (see 'flatTiles()').
+#define WIDTH_TILE_FLAT 16 //Width in pixels of the square tiles of the flat region pre-rejection.
 
 
 //Descriptor parameters.
@@ -41,21 +61,130 @@
 										   //if the ratio of descriptor distances between the first and the second best correspondence 
 										   //of a feature point is higher than a threshold. Determine the reliability of the correspondence.
 #define RAD_MAX_SEARCH 16 //Maximum radius of search in the correspondence process.
+#define WIDTH_CELL_MOTION_GRID 32 //Width in pixels of the cells of the motion grid used as motion prior.
+#define NO_TREES_KDFOREST 4 //Number of randomized kd-trees used in the global matching.
+#define NO_CHECKS_KDFOREST 64 //Maximum number of descriptors compared per point in the global matching. Higher values
+                              //increase the probability of finding the true nearest neighbor at the cost of speed.
+
+//Integer pipeline parameters.
+#define SCALE_DESC_INT 512 //Scale of the components of the integer descriptors (unsigned 8 bit, saturated to 255).
+
+//Parallelization parameters.
+#define NO_THREADS 0 //Number of threads used in the correspondence search. Zero means all the available cores.
 //************************************************************************************************
 
 
+//Number of gradients used by the quick rejection of the candidate points (see 'preFilterCorner()').
+#define NO_SAMPLES_PRE_FILTER 13
+
+//Levels of the tiles of the flat region pre-rejection (see 'flatTiles()').
+#define TILE_SKIPPED 0 //Flat tile far from the rest: it is not processed at all.
+#define TILE_NEIGHBOR 1 //Flat tile near a non-flat one: its gradient is used by the cornerness and the descriptors.
+#define TILE_NON_FLAT 2 //Tile that can contain points above the gradient magnitude threshold.
+
+//Types of motion prior used to center the search window of the correspondence process.
+#define MOTION_PRIOR_NONE 0 //The search window is centered on the location of the point.
+#define MOTION_PRIOR_AFFINE 1 //The search window is centered on the location predicted by a global affine model.
+#define MOTION_PRIOR_GRID 2 //The search window is centered on the location predicted by a coarse motion grid.
+
+
+//View of an unsigned 8 bit luma plane in memory owned by the caller (e.g. a capture buffer). Rows are 'stride' bytes
+//apart, so the Y plane of NV12 or I420 buffers can be used in place.
+typedef struct FFMELumaView
+{
+	unsigned char* data; //First pixel of the plane.
+	int width; //Width in pixels.
+	int height; //Height in pixels.
+	int stride; //Bytes between the beginning of consecutive rows.
+}
+FFMELumaView;
+
+//Candidate point with packed 16 bit integer coordinates (images up to 65535x65535).
+typedef struct FFMEPackedPto
+{
+	unsigned short x;
+	unsigned short y;
+}
+FFMEPackedPto;
+
+//Creation of a luma view.
+FFMELumaView lumaView(unsigned char* data, int width, int height, int stride);
+//Luma view of the Y plane of a NV12 or I420 buffer (the Y plane is the first one in both formats).
+FFMELumaView lumaViewYUV420(unsigned char* buffer, int width, int height, int strideY);
+
+
+//Compact list of correspondences in struct-of-arrays form. The correspondences are referred by the indices of the
+//singular points, and all the arrays are stored in a single contiguous block.
+typedef struct FFMECorrList
+{
+	int* idx1; //Index of the singular point in the first image.
+	int* idx2; //Index of the singular point in the second image.
+	float* dist1; //Descriptor distance to the best correspondence.
+	float* dist2; //Descriptor distance to the second best correspondence (FLT_MAX if there is none).
+	int noCorr; //Number of correspondences.
+	int maxNoCorr; //Maximum number of correspondences that can be stored.
+}
+FFMECorrList;
+
+//Creation of a list of correspondences.
+FFMECorrList* createCorrList(int maxNoCorr);
+//Release of a list of correspondences.
+void releaseCorrList(FFMECorrList** corrList);
+//Coordinates of the points of a list of correspondences.
+void getCorrPtos(FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, CvPoint2D32f* ptos1, CvPoint2D32f* ptos2);
+
+
+//Result of the correspondence search before applying any restriction. For each singular point of the first image, the
+//best and second best candidates of the second image and their descriptor distances are kept, so the matching
+//restrictions can be applied several times without new descriptor comparisons.
+typedef struct FFMEMatchResult
+{
+	int* idx1; //Index of the best candidate in the second image (-1 if there is none).
+	int* idx2; //Index of the second best candidate in the second image (-1 if there is none).
+	float* dist1; //Descriptor distance to the best candidate (FLT_MAX if there is none).
+	float* dist2; //Descriptor distance to the second best candidate (FLT_MAX if there is none).
+	CvPoint2D32f* predPtos; //Location predicted by the motion prior of the search.
+	int noQueries; //Number of singular points of the first image.
+	int maxNoQueries; //Maximum number of singular points of the first image that can be stored.
+}
+FFMEMatchResult;
+
+//Creation of a match result.
+FFMEMatchResult* createMatchResult(int maxNoQueries);
+//Release of a match result.
+void releaseMatchResult(FFMEMatchResult** matchResult);
+
+
 class FFME
 {
+	//The microbenchmark of the stages calls the private functions (see 'FFMEBenchmark.h').
+	friend class FFMEBenchmark;
 //Methods:
 public:
 	FFME(void);
 	~FFME(void);
-	//Initialization of memory and look-up tables.
+	//Initialization of memory and look-up tables (private engine).
 	void iniFFME(int width, int height, int origin, int maxNoKeyPoints);
+	//Initialization of memory bound to a shared engine (configuration and look-up tables). With 'matchOnly', only the
+	//memory of the matching and the motion prior is reserved.
+	void iniFFME(FFMEEngine* engine, int width, int height, int origin, int maxNoKeyPoints, bool matchOnly = false);
+	//Change of the frame size and of the maximum number of keypoints. The configuration and the look-up tables are kept,
+	//and the memory is reused if it is big enough.
+	void reconfigureFFME(int width, int height, int origin, int maxNoKeyPoints);
+	//Set the decimation factor (1, 2 or 4). The coordinates of the points are always in the space of the input images.
+	void setDecimation(int decimation);
 	//Singular point detection based on functions.
 	void singPtoDetFunc(IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos);
 	//Singular point detection based on LUT.
 	void singPtoDetLut(IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos);
+	//Singular point detection based on functions over a luma view (without copies).
+	void singPtoDetFunc(FFMELumaView* luma, CvPoint2D32f* singPtos, int* noSingPtos);
+	//Singular point detection based on LUT over a luma view (without copies).
+	void singPtoDetLut(FFMELumaView* luma, CvPoint2D32f* singPtos, int* noSingPtos);
+	//Singular point detection by bands of rows (cache-blocked), without the cornerness image.
+	void singPtoDetBand(IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos);
+	//Singular point detection by bands of rows over a luma view (without copies).
+	void singPtoDetBand(FFMELumaView* luma, CvPoint2D32f* singPtos, int* noSingPtos);
 	//Singular point description based on functions.
 	void singPtoDescFunc(CvPoint2D32f* singPtos, int noSingPtos, float** descriptors, bool normDesc = true);
 	//Singular point description based on LUT.
@@ -64,6 +193,40 @@ public:
 	void matchSingPtos(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
 		               CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, 
 					   CvPoint2D32f** correspondences, int* noCorr);
+	//Matching of singular points returning a compact list of correspondences with indices and descriptor distances.
+	void matchSingPtos(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		               CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, FFMECorrList* corrList);
+	//Search of the best and second best candidates of the singular points without applying any restriction.
+	void matchSingPtos(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		               CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, FFMEMatchResult* matchResult);
+	//Restrictions (second nearest neighbor ratio, search radius and uniqueness) over a match result.
+	void filterMatches(FFMEMatchResult* matchResult, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, int noSingPtos2,
+		               float threshRatSecBest, float radMaxSearch, bool unique, FFMECorrList* corrList);
+	//Matching of singular points with the mutual nearest neighbor restriction (cross-check) in a single pass.
+	void matchSingPtosCross(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                    CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, 
+					        CvPoint2D32f** correspondences, int* noCorr);
+	//Matching of singular points distributing the search among several threads.
+	void matchSingPtosPar(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                  CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, 
+					      CvPoint2D32f** correspondences, int* noCorr);
+	//Matching of singular points returning the index of the correspondence of each point of the first image.
+	void matchSingPtosIdx(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                  CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, int* idxCorr);
+	//Global matching of singular points (without search radius) based on an approximate nearest neighbor search.
+	void matchSingPtosGlobal(CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1, 
+		                     CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2, 
+					         CvPoint2D32f** correspondences, int* noCorr);
+	//Singular point detection in fixed-point arithmetic (integer pipeline).
+	void singPtoDetInt(IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos);
+	//Singular point detection in fixed-point arithmetic over a luma view (without copies).
+	void singPtoDetInt(FFMELumaView* luma, CvPoint2D32f* singPtos, int* noSingPtos);
+	//Singular point description in fixed-point arithmetic. The descriptors are unsigned 8 bit vectors.
+	void singPtoDescInt(CvPoint2D32f* singPtos, int noSingPtos, unsigned char** descriptors);
+	//Matching of singular points with integer descriptors and distances.
+	void matchSingPtosInt(CvPoint2D32f* singPtos1, int noSingPtos1, unsigned char** descriptors1, 
+		                  CvPoint2D32f* singPtos2, int noSingPtos2, unsigned char** descriptors2, 
+					      CvPoint2D32f** correspondences, int* noCorr);
 
 	//--get and set functions--//
 	//Set feature selection parameters.
@@ -91,6 +254,92 @@ public:
 		m_radMaxSearch = radMaxSearch;
 	}
 
+	//Set a global affine motion prior (2x3 matrix stored by rows). It also represents a pure translation.
+	void setMotionPriorAffine(float* affine)
+	{
+		int i;
+		for(i=0;i<6;i++)
+		{
+			m_affinePrior[i] = affine[i];
+		}
+		m_motionPrior = MOTION_PRIOR_AFFINE;
+	}
+
+	//Set a global translation as motion prior.
+	void setMotionPriorTrans(float transHor, float transVer)
+	{
+		float affine[6] = {1, 0, transHor, 0, 1, transVer};
+		setMotionPriorAffine(affine);
+	}
+
+	//Remove the motion prior.
+	void resetMotionPrior()
+	{
+		m_motionPrior = MOTION_PRIOR_NONE;
+	}
+
+	//Set a coarse motion grid computed from the correspondences of the previous frames as motion prior.
+	void setMotionPriorGrid(CvPoint2D32f** correspondences, int noCorr);
+
+	//Set global matching parameters.
+	void setGlobalMatchParam(int noTreesKdForest, int noChecksKdForest)
+	{
+		m_noTreesKdForest = noTreesKdForest;
+		m_noChecksKdForest = noChecksKdForest;
+	}
+
+	//Set the quick rejection parameters. In verification mode, the rejected points are also evaluated with the full
+	//structure tensor to count the wrong rejections (there is no speed-up).
+	void setPreFilterParam(bool preFilterCorner, float preFilterFactor, bool verifyPreFilter = false)
+	{
+		m_preFilterCorner = preFilterCorner;
+		m_preFilterFactor = preFilterFactor;
+		m_verifyPreFilter = verifyPreFilter;
+	}
+
+	//Get the counters of the quick rejection of the last detection: number of tested and rejected points, and number of
+	//rejected points that fulfill the cornerness restriction (only in verification mode).
+	void getPreFilterCounters(int* noTested, int* noRejected, int* noFalseRejected)
+	{
+		*noTested = m_noPreFilterTested;
+		*noRejected = m_noPreFilterRejected;
+		*noFalseRejected = m_noPreFilterFalseRej;
+	}
+
+	//Set the flat region pre-rejection parameters. The gradient images are not updated in the skipped tiles.
+	void setFlatTileParam(bool skipFlatTiles, int widthTileFlat)
+	{
+		m_skipFlatTiles = skipFlatTiles;
+		m_widthTileFlat = MAX(widthTileFlat, 1);
+	}
+
+	//Get the number of tiles of the last flat region pre-rejection: total, flat and skipped (flat and not near a
+	//non-flat one).
+	void getFlatTiles(int* noTiles, int* noFlatTiles, int* noSkippedTiles)
+	{
+		*noTiles = m_noTiles;
+		*noFlatTiles = m_noTilesFlat;
+		*noSkippedTiles = m_noTilesSkipped;
+	}
+
+	//Set the number of rows of the bands of the banded detection.
+	void setBandParam(int heightBand)
+	{
+		m_heightBand = heightBand;
+	}
+
+	//Set parallelization parameters.
+	void setParallelParam(int noThreads)
+	{
+		m_noThreads = noThreads;
+	}
+
+	//Get the engine (configuration and look-up tables).
+	FFMEEngine* getEngine()
+	{
+		return m_engine;
+	}
+
 	//Get horizontal gradient.
 	void getHorGradient(IplImage** img_S161C)
 	{
@@ -115,10 +364,10 @@ public:
 		*noPtosGrad = m_noPtosGrad;
 	}
 
-	//Get the points that have fullfiled the gradient magnitud restriction.
-	void getGradPtos(CvPoint2D32f** ptosGrad)
+	//Get the points that have fullfiled the gradient magnitud restriction (copy).
+	void getGradPtos(CvPoint2D32f* ptosGrad)
 	{
-		*ptosGrad = m_ptosGrad;
+		unpackPtos(m_ptosGrad, m_noPtosGrad, ptosGrad);
 	}
 
 	//Get the number of points that have fullfiled the cornerness restriction.
@@ -127,27 +376,85 @@ public:
 		*noPtosCorner = m_noPtosCornerness;
 	}
 
-	//Get the points that have fullfiled the cornerness restriction.
-	void getCornerPtos(CvPoint2D32f** ptosCorner)
+	//Get the points that have fullfiled the cornerness restriction (copy).
+	void getCornerPtos(CvPoint2D32f* ptosCorner)
+	{
+		unpackPtos(m_ptosCornerness, m_noPtosCornerness, ptosCorner);
+	}
+
+	//Get the current capacity of the lists of candidate points.
+	int getCapCandidates()
+	{
+		return m_capCandidates;
+	}
+
+	//Get the maximum frame size that can be processed without reserving memory (decimated size).
+	CvSize getCapSize()
+	{
+		return cvSize(m_capWidth, m_capHeight);
+	}
+
+	//Get the decimation factor.
+	int getDecimation()
 	{
-		*ptosCorner = m_ptosCornerness;
+		return m_decimation;
 	}
 
+#ifdef FFME_STATS
+	//Get the instrumentation of the stages: timings and funnel of points of every call (see 'FFMEStats.h').
+	FFMEStats* getStats()
+	{
+		return &m_stats;
+	}
+#endif
+
 private:
 	/*--Funtions related to singular point detection--*/
 	//Compute the horizontal and vertical image gradient based on Sobel.
 	void gradientSobel(IplImage* img_U81C);
+	//Decimation of the input image with a box filter.
+	void decimate(IplImage* img_U81C);
+	//Image header over a luma view.
+	IplImage* wrapLuma(FFMELumaView* luma);
+	//Change of the size of an image without reserving memory.
+	void resizeImage(IplImage* img, int width, int height, int origin);
 	//Compute the gradient magnitude based on functions.
 	void gradMagFunc();
 	//Compute the gradient magnitude based on LUT.
 	void gradMagLut();
 	//Selection of points by gradient magnitude thresholding. The 'noPix' nearer from image borders are discarded.
 	void gradMagThresh(float thresh, int noPix);
+	//Growth of the lists of candidate points.
+	void growCandidates(int noCandidates, int maxNoCandidates);
+	//Conversion of packed points to floating point coordinates.
+	void unpackPtos(FFMEPackedPto* packed, int noPtos, CvPoint2D32f* ptos);
 	//Selection of points of high cornerness.
 	void cornerThresh(float thresh, int sizeWin);
+	//Quick rejection of a candidate point by the diversity of the gradient directions in its window.
+	bool preFilterCorner(CvPoint pto, int rWin, float harrisCond);
 	//Non minimal supression in the cornerness space.
 	void nonMinSupCorner(int sizeWin, CvPoint2D32f* ptos, int* noPtos);
 
+	/*--Funtions of the flat region pre-rejection--*/
+	//Classification of the tiles of the image by their intensity range.
+	void flatTiles(IplImage* img_U81C);
+	//Compute the horizontal and vertical image gradient based on Sobel in the tiles that are not skipped.
+	void gradientSobelTiles(IplImage* img_U81C);
+	//Columns of a row that belong to tiles of a minimum level (runs of consecutive tiles).
+	void tileRuns(int row, int level, int** runs, int* noRuns);
+
+	/*--Funtions of the banded detection--*/
+	//Compute the horizontal and vertical image gradient based on Sobel of a range of columns of a row.
+	void gradientSobelRow(IplImage* img_U81C, int row, int col0, int col1);
+	//Compute the horizontal and vertical image gradient of a range of rows based on Sobel.
+	void gradientSobelRows(IplImage* img_U81C, int row0, int row1);
+	//Selection of the points of a range of rows by thresholding of the squared gradient magnitude.
+	void gradMagThreshRows(int threshSq, int noPix, int row0, int row1, int* noCandidates);
+	//Selection of points of high cornerness storing the cornerness in a ring of rows.
+	void cornerThreshRows(float thresh, int sizeWin, float* cornerness, int noRowsRing);
+	//Non minimal supression of the points above a row. Returns false if the maximum number of points is reached.
+	bool nonMinSupCornerRows(int sizeWin, int row1, float* cornerness, int noRowsRing, CvPoint2D32f* ptos, int* noPtos);
+
 	/*--Funtions related to singular point description--*/
 	//Compute the gradient phase based on functions. Range = (0,2pi).
 	void gradPhaseFunc();
@@ -163,9 +470,36 @@ private:
 	void normVector(float* vector, int length);
 
 	/*--Funtions related to singular point correspondence--*/
+	//Location of a point predicted by the motion prior.
+	void predictPto(CvPoint2D32f* pto, float* xPred, float* yPred);
+	//Search of the best and second best correspondences of a singular point of the first image.
+	void searchBest2(CvPoint2D32f* singPto1, float* desc1, CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2,
+		             int* j1, float* minDist1, int* j2, float* minDist2);
+	//Search of the correspondence of a singular point of the first image. The second nearest neighbor restriction is applied.
+	int searchCorr(CvPoint2D32f* singPto1, float* desc1, CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2,
+		           float* minDist1 = NULL, float* minDist2 = NULL);
 	//Euclidean distance of two vectors of type float.
    void euclDist(float* vector1, float* vector2, int length, float* dist);
 
+	/*--Funtions of the integer pipeline--*/
+	//Selection of points by thresholding of the squared gradient magnitude.
+	void gradMagThreshInt(int threshSq, int noPix);
+	//Selection of points of high cornerness with integer structure tensor and Harris test.
+	void cornerThreshInt(float thresh, int sizeWin);
+	//Non minimal supression in the integer cornerness space.
+	void nonMinSupCornerInt(int sizeWin, CvPoint2D32f* ptos, int* noPtos);
+	//Compute the orientations histograms in fixed-point arithmetic.
+	void orientHistInt(int row, int col, int* hist);
+	//Orientation histogram contributions by trilinear interpolation in fixed-point arithmetic.
+	void trilinearInterpInt(int rbin, int cbin, int obin, int gradVal, int* hist);
+	//Normalization and quantization of an integer descriptor vector.
+	void normDescripInt(int* hist, int length, float maxRespComp, unsigned char* descriptor);
+	//Search of the correspondence of a singular point of the first image with integer descriptors.
+	int searchCorrInt(CvPoint2D32f* singPto1, unsigned char* desc1, CvPoint2D32f* singPtos2, int noSingPtos2, 
+		              unsigned char** descriptors2);
+	//Squared Euclidean distance of two vectors of type unsigned char.
+	void euclDistSqInt(unsigned char* vector1, unsigned char* vector2, int length, int* distSq);
+
 //Members:
 public:
 	//--Feature selection parameters--//
@@ -179,6 +513,21 @@ public:
 	int m_widthWinHarris; 
 	//Size of the window used to calculate the non-maximal supression.
 	int m_widthWinNonMaxSup;
+	//Maximum number of candidate points (gradient restriction) per image. Zero means no limit. If it is reached, the 
+	//rest of the image (following rows) is not searched.
+	int m_maxNoCandidates;
+	//Number of rows of the bands of the banded detection ('singPtoDetBand()').
+	int m_heightBand;
+	//Flag of the quick rejection of the candidate points before the evaluation of the full structure tensor.
+	bool m_preFilterCorner;
+	//Factor by which the Harris threshold is relaxed in the quick rejection.
+	float m_preFilterFactor;
+	//Flag of the verification mode of the quick rejection.
+	bool m_verifyPreFilter;
+	//Flag of the pre-rejection of the flat regions of the image by tiles.
+	bool m_skipFlatTiles;
+	//Width in pixels of the square tiles of the flat region pre-rejection.
+	int m_widthTileFlat;
 
 	//--Descriptor parameters--//
 	int m_widthArrayHist; //Width of the square array of orientations histograms.
@@ -195,7 +544,21 @@ public:
 	float m_threshRatSecBest;
 	//Maximum radius of search in the correspondence process.
 	float m_radMaxSearch; 
+	//Type of motion prior used to center the search window (MOTION_PRIOR_XXX).
+	int m_motionPrior;
+	//Width in pixels of the cells of the motion grid. It is fixed in the initialization ('iniFFME()').
+	int m_widthCellGrid;
+	//Number of randomized kd-trees used in the global matching.
+	int m_noTreesKdForest;
+	//Maximum number of descriptors compared per point in the global matching (speed/accuracy trade-off).
+	int m_noChecksKdForest;
+
+	//--Parallelization parameters--//
+	//Number of threads used in the correspondence search. Zero means all the available cores.
+	int m_noThreads;
 private:
+	//Image header used to process luma views without copies (it does not own the data).
+	IplImage m_lumaHeader;
 	//Horizontal gradient image.
 	IplImage* m_horGradient_S161C;
 	//Vertical gradient image.
@@ -206,17 +569,117 @@ private:
 	IplImage* m_phaseGradient_32F1C;
 	//Sparse image cornerness.
 	IplImage* m_cornerness_32F1C;
+	//Header of the integer cornerness image (integer pipeline). It shares the data of the floating point one.
+	IplImage m_cornernessIntHeader;
+	//Size of the reserved images. The images can be smaller (frames of smaller size).
+	int m_capWidth;
+	int m_capHeight;
+	//Size and origin of the input images.
+	int m_width;
+	int m_height;
+	int m_origin;
+	//Decimation factor and decimated input image.
+	int m_decimation;
+	IplImage* m_decimated_U81C;
 	
-	/*Look-up tables*/
+	/*Look-up tables (owned by the engine)*/
 	float** m_LutMagGradient;
 	float** m_LutPhaseGradient;
+	unsigned short* m_LutAtanInt;
+	//Engine with the configuration and the look-up tables, and flag to indicate if it is private (owned).
+	FFMEEngine* m_engine;
+	bool m_ownEngine;
+	//Flag to indicate if the object is only used for the matching (no memory of the detection and description).
+	bool m_matchOnly;
 	
 	//Array of points that fullfill the gradient magnitude restriction.
-	CvPoint2D32f* m_ptosGrad;
+	FFMEPackedPto* m_ptosGrad;
 	//Number of points that fullfill the gradient magnitude restriction.
 	int m_noPtosGrad;
 	//Array of points that fullfill the cornerness restriction.
-	CvPoint2D32f* m_ptosCornerness;
+	FFMEPackedPto* m_ptosCornerness;
 	//Number of points that fullfill the cornerness restriction.
 	int m_noPtosCornerness;
+	//Capacity of both arrays of candidate points.
+	int m_capCandidates;
+
+	/*Cross-check matching buffers (one element per singular point)*/
+	//Index of the best correspondence of each point of the first and the second image.
+	int* m_idxBest1;
+	int* m_idxBest2;
+	//Distances to the best and second best correspondence of each point of the first image.
+	float* m_minDist1Best1;
+	float* m_minDist2Best1;
+	//Distances to the best and second best correspondence of each point of the second image.
+	float* m_minDist1Best2;
+	float* m_minDist2Best2;
+	//Number of reserved elements.
+	int m_capNoKeyPoints;
+
+	/*Counters of the quick rejection (last detection)*/
+	int m_noPreFilterTested;
+	int m_noPreFilterRejected;
+	int m_noPreFilterFalseRej;
+
+	/*Flat region pre-rejection (last gradient)*/
+	//Flag to indicate if the last gradient was computed by tiles. Otherwise the rest of the buffers are not valid.
+	bool m_tilesGradient;
+	//Width of the tiles, number of tiles per row and per column, and their level (TILE_XXX).
+	int m_widthTiles;
+	int m_noTilesX;
+	int m_noTilesY;
+	unsigned char* m_levelTiles;
+	//Runs of columns of each row of tiles (pairs first column, column after the last one) whose level is at least
+	//TILE_NEIGHBOR (first half) and TILE_NON_FLAT (second half), and number of runs of each row of tiles.
+	int* m_runsTiles;
+	int* m_noRunsTiles;
+	//Number of reserved elements ('m_noTilesX'+1)*'m_noTilesY'.
+	int m_capTiles;
+	//Minimum and maximum intensity of the columns of a row of tiles, and number of reserved columns.
+	unsigned char* m_minMaxTiles;
+	int m_capMinMaxTiles;
+	//Single run of a whole row (gradient not computed by tiles).
+	int m_runFull[2];
+	//Counters.
+	int m_noTiles;
+	int m_noTilesFlat;
+	int m_noTilesSkipped;
+
+#ifdef FFME_STATS
+	/*Instrumentation of the stages*/
+	//These members change the layout of the class, so the library and all its clients must be built with the same
+	//FFME_NO_STATS setting. Otherwise the objects are corrupted.
+	FFMEStats m_stats;
+	//Number of points of the first image with at least one candidate in the current matching.
+	int m_noMatchedStats;
+#endif
+
+	/*Banded detection buffers*/
+	//Ring of cornerness rows, and number of reserved elements.
+	float* m_cornernessBand;
+	int m_capCornernessBand;
+
+	/*Integer pipeline buffers*/
+	//Gaussian weights (Q12) of the pixels of the descriptor neighborhood, and number of reserved weights.
+	int* m_weightsDescInt;
+	int m_capWeightsDescInt;
+	//Orientation histograms (Q8) of a descriptor, and number of reserved components.
+	int* m_histDescInt;
+	int m_capHistDescInt;
+
+	/*Motion prior*/
+	//Global affine model (2x3 matrix stored by rows).
+	float m_affinePrior[6];
+	//Motion vector of each cell of the motion grid.
+	CvPoint2D32f* m_gridPrior;
+	//Number of accumulated motion vectors in each cell of the motion grid.
+	int* m_noVectGridPrior;
+	//Number of columns and rows of the motion grid.
+	int m_noColsGrid;
+	int m_noRowsGrid;
+	//Number of reserved cells.
+	int m_capNoCellsGrid;
+
+	//Approximate nearest neighbor index of the descriptors of the second image (global matching).
+	KdForest m_kdForest;
 };
@@ -0,0 +1,216 @@
+//-------------------------------------------------------------------------
+// FFMEBenchmark.cpp
+//-------------------------------------------------------------------------
+// Description: microbenchmark of the stages of the FFME class.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "FFMEBenchmark.h"
+
+
+//Calls a stage 'noRuns' times and accumulates the time of each call (it uses the local variables 'k' and 't').
+#define TIME_STAGE_M(stage, call) \
+	for(k=0;k<noRuns;k++) \
+	{ \
+		t = (double)cvGetTickCount(); \
+		call; \
+		addTime(stage, (double)cvGetTickCount() - t); \
+	}
+
+
+FFMEBenchmark::FFMEBenchmark(void)
+{
+	m_singPtos1 = 0;
+	m_singPtos2 = 0;
+	m_descriptors1 = 0;
+	m_descriptors2 = 0;
+	m_correspondences = 0;
+	m_capNoKeyPoints = 0;
+	m_capLengthDesc = 0;
+	m_noCalls = 0;
+}
+
+FFMEBenchmark::~FFMEBenchmark(void)
+{
+	reserve(0, 0);
+}
+
+
+/* Timing of each stage of the detection, the description and the matching of a pair of images. The stages are the
+   ones of 'singPtoDetLut()', 'singPtoDescLut()' and 'matchSingPtos()', plus the function versions of the magnitude and
+   the phase. Each stage is called 'noRuns' times over the result of the previous one, so the data are the ones of the
+   real pipeline and they are in the cache after the first call. The second image is only used as the second image of
+   the matching. The configuration of the FFME object (parameters, decimation, flat region pre-rejection...) is kept.
+   Inputs:
+   -ffme: initialized FFME object. The size of the images must be the one of the initialization.
+   -img1_U81C: unsigned 8 bit first image.
+   -img2_U81C: unsigned 8 bit second image.
+   -noRuns: number of calls of each stage.
+   -stages: (input/output) array of NO_BENCH_STAGES timings, indexed by BENCH_XXX. The function doesn't reserve memory.
+   Outputs: --
+*/
+void FFMEBenchmark::benchStages(FFME* ffme, IplImage* img1_U81C, IplImage* img2_U81C, int noRuns, FFMEStageTime* stages)
+{
+	int i, k, noSingPtos1, noSingPtos2, noCorr;
+	int lengthDesc = ffme->m_widthArrayHist*ffme->m_widthArrayHist*ffme->m_noBinsOriHist;
+	int noBytesDescriptor = lengthDesc * sizeof(float);
+	int noPixels = ffme->m_horGradient_S161C->width * ffme->m_horGradient_S161C->height; //Decimated size.
+	float offset = (ffme->m_decimation - 1) * 0.5f;
+	CvPoint2D32f pto;
+	double t;
+
+	reserve(ffme->m_maxNoKeyPoints, lengthDesc);
+
+	//Singular points and descriptors of the second image.
+	ffme->singPtoDetLut(img2_U81C, m_singPtos2, &noSingPtos2);
+	ffme->singPtoDescLut(m_singPtos2, noSingPtos2, m_descriptors2, true);
+
+	//Detection.
+	iniStage(stages + BENCH_GRADIENT_SOBEL, "gradientSobel", noPixels, false);
+	TIME_STAGE_M(stages + BENCH_GRADIENT_SOBEL, ffme->gradientSobel(img1_U81C));
+	iniStage(stages + BENCH_GRAD_MAG_FUNC, "gradMagFunc", noPixels, false);
+	TIME_STAGE_M(stages + BENCH_GRAD_MAG_FUNC, ffme->gradMagFunc());
+	iniStage(stages + BENCH_GRAD_MAG_LUT, "gradMagLut", noPixels, false);
+	TIME_STAGE_M(stages + BENCH_GRAD_MAG_LUT, ffme->gradMagLut());
+	iniStage(stages + BENCH_GRAD_MAG_THRESH, "gradMagThresh", noPixels, false);
+	TIME_STAGE_M(stages + BENCH_GRAD_MAG_THRESH, ffme->gradMagThresh(ffme->m_threshGradMag, 16));
+	iniStage(stages + BENCH_CORNER_THRESH, "cornerThresh", ffme->m_noPtosGrad, true);
+	TIME_STAGE_M(stages + BENCH_CORNER_THRESH, ffme->cornerThresh(ffme->m_threshHarris, ffme->m_widthWinHarris));
+	iniStage(stages + BENCH_NON_MIN_SUP_CORNER, "nonMinSupCorner", ffme->m_noPtosCornerness, true);
+	TIME_STAGE_M(stages + BENCH_NON_MIN_SUP_CORNER, ffme->nonMinSupCorner(ffme->m_widthWinNonMaxSup, m_singPtos1, &noSingPtos1));
+
+	//Description.
+	iniStage(stages + BENCH_GRAD_PHASE_FUNC, "gradPhaseFunc", noPixels, false);
+	TIME_STAGE_M(stages + BENCH_GRAD_PHASE_FUNC, ffme->gradPhaseFunc());
+	iniStage(stages + BENCH_GRAD_PHASE_LUT, "gradPhaseLut", noPixels, false);
+	TIME_STAGE_M(stages + BENCH_GRAD_PHASE_LUT, ffme->gradPhaseLut());
+	iniStage(stages + BENCH_ORIENT_HIST, "orientHist+normDescrip", noSingPtos1, true);
+	for(k=0;k<noRuns;k++)
+	{
+		t = (double)cvGetTickCount();
+		for(i=0;i<noSingPtos1;i++)
+		{
+			memset(m_descriptors1[i], 0, noBytesDescriptor);
+			pto.x = (m_singPtos1[i].x - offset) / ffme->m_decimation;
+			pto.y = (m_singPtos1[i].y - offset) / ffme->m_decimation;
+			ffme->orientHist(&pto, m_descriptors1[i]);
+			ffme->normDescrip(m_descriptors1[i], lengthDesc, ffme->m_maxRespCompDesc);
+		}
+		addTime(stages + BENCH_ORIENT_HIST, (double)cvGetTickCount() - t);
+	}
+
+	//Matching.
+	iniStage(stages + BENCH_MATCH_SING_PTOS, "matchSingPtos", noSingPtos1, true);
+	TIME_STAGE_M(stages + BENCH_MATCH_SING_PTOS, ffme->matchSingPtos(m_singPtos1, noSingPtos1, m_descriptors1,
+		         m_singPtos2, noSingPtos2, m_descriptors2, m_correspondences, &noCorr));
+}
+
+
+/* Throughput of a stage. It is computed with the minimum time per call, which is the least affected by the rest of
+   the processes of the system.
+   Inputs:
+   -stage: timing of the stage.
+   Outputs: items (pixels or points) per second.
+*/
+double FFMEBenchmark::throughput(FFMEStageTime* stage)
+{
+	if(stage->timeMin <= 0)
+	{
+		return 0;
+	}
+	return stage->noItems / (stage->timeMin / 1000.);
+}
+
+
+/* Initialization of the timing of a stage.
+   Inputs:
+   -stage: (input/output) timing of the stage.
+   -name: name of the stage.
+   -noItems: number of items processed per call.
+   -perPoint: flag to indicate if the items are points (true) or pixels (false).
+   Outputs: --
+*/
+void FFMEBenchmark::iniStage(FFMEStageTime* stage, const char* name, int noItems, bool perPoint)
+{
+	stage->name = name;
+	stage->timeAvg = 0;
+	stage->timeMin = DBL_MAX;
+	stage->noItems = noItems;
+	stage->perPoint = perPoint;
+	m_noCalls = 0;
+}
+
+
+/* Accumulation of the time of a call of a stage.
+   Inputs:
+   -stage: (input/output) timing of the stage.
+   -ticks: time of the call (ticks of 'cvGetTickCount()').
+   Outputs: --
+*/
+void FFMEBenchmark::addTime(FFMEStageTime* stage, double ticks)
+{
+	double time = ticks / (cvGetTickFrequency() * 1000.);
+	stage->timeAvg = (stage->timeAvg * m_noCalls + time) / (m_noCalls + 1);
+	if(time < stage->timeMin)
+	{
+		stage->timeMin = time;
+	}
+	m_noCalls++;
+}
+
+
+/* Reserve of the points, descriptors and correspondences. The memory is only reserved again if it is not big enough,
+   and it is released with a null size.
+   Inputs:
+   -maxNoKeyPoints: maximum number of singular points of an image.
+   -lengthDesc: length of the descriptors.
+   Outputs: --
+*/
+void FFMEBenchmark::reserve(int maxNoKeyPoints, int lengthDesc)
+{
+	int i;
+
+	if(maxNoKeyPoints <= m_capNoKeyPoints && lengthDesc <= m_capLengthDesc && maxNoKeyPoints > 0)
+	{
+		return;
+	}
+
+	//Release.
+	for(i=0;i<m_capNoKeyPoints;i++)
+	{
+		cvFree(m_descriptors1+i);
+		cvFree(m_descriptors2+i);
+		cvFree(m_correspondences+i);
+	}
+	if(m_capNoKeyPoints > 0)
+	{
+		cvFree(&m_singPtos1);
+		cvFree(&m_singPtos2);
+		cvFree(&m_descriptors1);
+		cvFree(&m_descriptors2);
+		cvFree(&m_correspondences);
+	}
+	m_capNoKeyPoints = 0;
+	m_capLengthDesc = 0;
+	if(maxNoKeyPoints <= 0)
+	{
+		return;
+	}
+
+	//Reserve.
+	m_capNoKeyPoints = maxNoKeyPoints;
+	m_capLengthDesc = lengthDesc;
+	m_singPtos1 = (CvPoint2D32f*)cvAlloc(maxNoKeyPoints * sizeof(CvPoint2D32f));
+	m_singPtos2 = (CvPoint2D32f*)cvAlloc(maxNoKeyPoints * sizeof(CvPoint2D32f));
+	m_descriptors1 = (float**)cvAlloc(maxNoKeyPoints * sizeof(float*));
+	m_descriptors2 = (float**)cvAlloc(maxNoKeyPoints * sizeof(float*));
+	m_correspondences = (CvPoint2D32f**)cvAlloc(maxNoKeyPoints * sizeof(CvPoint2D32f*));
+	for(i=0;i<maxNoKeyPoints;i++)
+	{
+		m_descriptors1[i] = (float*)cvAlloc(lengthDesc * sizeof(float));
+		m_descriptors2[i] = (float*)cvAlloc(lengthDesc * sizeof(float));
+		m_correspondences[i] = (CvPoint2D32f*)cvAlloc(2 * sizeof(CvPoint2D32f));
+	}
+}
@@ -0,0 +1,83 @@
+//-------------------------------------------------------------------------
+// FFMEBenchmark.h
+//-------------------------------------------------------------------------
+// Description: microbenchmark of the stages of the FFME class. Each stage
+// of the detection, the description and the matching is called
+// separately several times over the same data, and its time per call and
+// its throughput (pixels or points per second) are measured. The class is
+// a friend of FFME, so the private stages are timed without changes in
+// their code.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+#include "highgui.h"
+
+//Motion estimation class.
+#include "FFME.h"
+
+
+//Stages measured by the benchmark.
+#define BENCH_GRADIENT_SOBEL 0 //'gradientSobel()' (decimation included).
+#define BENCH_GRAD_MAG_FUNC 1 //'gradMagFunc()'.
+#define BENCH_GRAD_MAG_LUT 2 //'gradMagLut()'.
+#define BENCH_GRAD_MAG_THRESH 3 //'gradMagThresh()'.
+#define BENCH_CORNER_THRESH 4 //'cornerThresh()' (points: candidates of the gradient restriction).
+#define BENCH_NON_MIN_SUP_CORNER 5 //'nonMinSupCorner()' (points: candidates of the cornerness restriction).
+#define BENCH_GRAD_PHASE_FUNC 6 //'gradPhaseFunc()'.
+#define BENCH_GRAD_PHASE_LUT 7 //'gradPhaseLut()'.
+#define BENCH_ORIENT_HIST 8 //'orientHist()' and 'normDescrip()' (points: singular points).
+#define BENCH_MATCH_SING_PTOS 9 //'matchSingPtos()' (points: singular points of the first image).
+#define NO_BENCH_STAGES 10
+
+
+//Timing of a stage.
+typedef struct FFMEStageTime
+{
+	const char* name; //Name of the stage.
+	double timeAvg; //Average time per call (ms).
+	double timeMin; //Minimum time per call (ms).
+	int noItems; //Number of items processed per call (pixels or points).
+	bool perPoint; //Flag to indicate if the items are points (true) or pixels (false).
+}
+FFMEStageTime;
+
+
+class FFMEBenchmark
+{
+//Methods:
+public:
+	FFMEBenchmark(void);
+	~FFMEBenchmark(void);
+	//Timing of each stage of the detection, the description and the matching of a pair of images.
+	void benchStages(FFME* ffme, IplImage* img1_U81C, IplImage* img2_U81C, int noRuns, FFMEStageTime* stages);
+	//Throughput of a stage (items per second).
+	static double throughput(FFMEStageTime* stage);
+
+private:
+	//Initialization of the timing of a stage.
+	void iniStage(FFMEStageTime* stage, const char* name, int noItems, bool perPoint);
+	//Accumulation of the time of a call of a stage.
+	void addTime(FFMEStageTime* stage, double ticks);
+	//Reserve of the points, descriptors and correspondences.
+	void reserve(int maxNoKeyPoints, int lengthDesc);
+
+//Members:
+private:
+	//Singular points and descriptors of both images.
+	CvPoint2D32f* m_singPtos1;
+	CvPoint2D32f* m_singPtos2;
+	float** m_descriptors1;
+	float** m_descriptors2;
+	//Correspondences.
+	CvPoint2D32f** m_correspondences;
+	//Number of reserved points and length of the reserved descriptors.
+	int m_capNoKeyPoints;
+	int m_capLengthDesc;
+	//Number of calls of the current stage.
+	int m_noCalls;
+};
@@ -0,0 +1,121 @@
+//-------------------------------------------------------------------------
+// FFMEEngine.cpp
+//-------------------------------------------------------------------------
+// Description: shared configuration and look-up tables of the motion
+// estimation.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "FFME.h"
+
+
+FFMEEngine::FFMEEngine(void)
+{
+	m_LutMagGradient = 0;
+	m_LutPhaseGradient = 0;
+	m_LutAtanInt = 0;
+}
+
+FFMEEngine::~FFMEEngine(void)
+{
+	int i;
+	int noElem = 255*8+1; //Range of possible values for the gradient calculated using a Sobel mask.
+
+	if(m_LutMagGradient == 0)
+	{
+		return;
+	}
+
+	//Release LUTs memory.
+	for(i=0;i<noElem;i++)
+	{
+		cvFree(&(m_LutMagGradient[i]));
+	}
+	cvFree(&m_LutMagGradient);
+	for(i=0;i<noElem;i++)
+	{
+		cvFree(&(m_LutPhaseGradient[i]));
+	}
+	cvFree(&m_LutPhaseGradient);
+	cvFree(&m_LutAtanInt);
+}
+
+
+/* Initialization of the default configuration and of the look-up tables. The engine must not be modified while there
+   are FFME objects bound to it.
+   Inputs: --
+   Outputs: --
+*/
+void FFMEEngine::iniEngine()
+{
+	int i,j;
+	int noElem = 255*8+1; //Maximum value for the gradient calculated by means of a Sobel mask.
+	int shift = -255*4; 
+
+	m_widthArrayHist = WIDTH_ARRAY_HIST;
+	m_widthSubWinHist = WIDTH_SUBWIN_HIST;
+	m_noBinsOriHist = NO_BINS_ORI_HIST;
+	m_maxRespCompDesc = (float)MAX_RESP_COMP_DESC;
+	m_threshGradMag = THRESH_GRAD_MAG;
+	m_threshHarris = THRESH_HARRIS;
+	m_widthWinHarris = WIDTH_WIN_HARRIS;
+	m_widthWinNonMaxSup = WIDTH_WIN_NONMAXSUP;
+	m_threshRatSecBest = (float)THRESH_RATIO_SECOND_BEST_CORR;
+	m_radMaxSearch = RAD_MAX_SEARCH;
+
+	if(m_LutMagGradient != 0)
+	{
+		return; //The tables do not depend on the configuration.
+	}
+
+	//Gradient magnitude look-up table.
+	m_LutMagGradient = (float**)cvAlloc(noElem * sizeof(float*)); 
+	for(i=0;i<noElem;i++)
+	{
+		m_LutMagGradient[i] = (float*)cvAlloc(noElem * sizeof(float));
+	}
+	for(i=0;i<noElem;i++) //Setup of the table.
+	{
+		for(j=0;j<noElem;j++)
+		{
+			m_LutMagGradient[i][j] = sqrt((float)((shift+i)*(shift+i)+(shift+j)*(shift+j)));
+		}
+	}
+
+
+	//Gradient phase look-up table (0,2*pi).
+	m_LutPhaseGradient = (float**)cvAlloc(noElem * sizeof(float*)); //Memory reserving.
+	const float c2pi = (float)(2*CV_PI);
+	for(i=0;i<noElem;i++)
+	{
+		m_LutPhaseGradient[i] = (float*)cvAlloc(noElem * sizeof(float));
+	}
+	for(i=0;i<noElem;i++) //Setup of the table.
+	{
+		for(j=0;j<noElem;j++)
+		{
+			float tmp = atan2((float)(shift+i), (float)(shift+j));
+			//Correct the phase to [0,2pi].
+			if(tmp >= 0)
+			{
+				m_LutPhaseGradient[i][j] = tmp;
+			}
+			else
+			{
+				m_LutPhaseGradient[i][j] = tmp + c2pi;
+			}
+		}
+	}
+
+
+	//Arctangent look-up table of the integer pipeline. The angles of the first octant (ratios [0,1]) are binary angles
+	//in the range [0,8192], and the rest of octants are obtained by symmetry.
+	noElem = (1 << NO_BITS_ATAN_INT) + 1;
+	m_LutAtanInt = (unsigned short*)cvAlloc(noElem * sizeof(unsigned short));
+	for(i=0;i<noElem;i++)
+	{
+		m_LutAtanInt[i] = (unsigned short)cvRound(atan((double)i / (1 << NO_BITS_ATAN_INT)) * 65536 / (2 * CV_PI));
+	}
+}
@@ -0,0 +1,106 @@
+//-------------------------------------------------------------------------
+// FFMEEngine.h
+//-------------------------------------------------------------------------
+// Description: shared part of the motion estimation: the default
+// configuration and the look-up tables of the gradient magnitude and
+// phase (about 33 MB). An engine is read-only once initialized, so it can
+// be shared without locks by several FFME objects (workspaces), one per
+// thread, which only hold the per-frame buffers.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+
+
+//********************************************Parameters******************************************
+#define NO_BITS_ATAN_INT 10 //Number of bits of the ratios of the arctangent look-up table (integer pipeline).
+//************************************************************************************************
+
+
+class FFMEEngine
+{
+//Methods:
+public:
+	FFMEEngine(void);
+	~FFMEEngine(void);
+	//Initialization of the default configuration and of the look-up tables.
+	void iniEngine();
+
+	//--get and set functions--//
+	//Set the default feature selection parameters.
+	void setFeatParam(float threshGradMag, float threshHarris, int widthWinHarris, int widthWinNonMaxSup)
+	{
+		m_threshGradMag = threshGradMag;
+		m_threshHarris = threshHarris;
+		m_widthWinHarris = widthWinHarris;
+		m_widthWinNonMaxSup = widthWinNonMaxSup;
+	}
+
+	//Set the default descriptor parameters.
+	void setDescParam(int widthArrayHist, int widthSubWinHist, int noBinsOriHist, float maxRespCompDesc)
+	{
+		m_widthArrayHist = widthArrayHist;
+		m_widthSubWinHist = widthSubWinHist;
+		m_noBinsOriHist = noBinsOriHist;
+		m_maxRespCompDesc = maxRespCompDesc;
+	}
+
+	//Set the default matching parameters.
+	void setMatchParam(float threshRatSecBest, float radMaxSearch)
+	{
+		m_threshRatSecBest = threshRatSecBest;
+		m_radMaxSearch = radMaxSearch;
+	}
+
+	//Get the gradient magnitude look-up table.
+	float** getLutMagGradient()
+	{
+		return m_LutMagGradient;
+	}
+
+	//Get the gradient phase look-up table.
+	float** getLutPhaseGradient()
+	{
+		return m_LutPhaseGradient;
+	}
+
+	//Get the arctangent look-up table of the integer pipeline.
+	unsigned short* getLutAtanInt()
+	{
+		return m_LutAtanInt;
+	}
+
+//Members:
+public:
+	//--Default configuration of the FFME objects bound to the engine--//
+	//Threshold for the gradient magnitude image.
+	float m_threshGradMag;
+	//Cornerness threshold based on Harris condition (ratio of eigenvalues).
+	float m_threshHarris;
+	//Size of the window used to calculate the cornerness.
+	int m_widthWinHarris;
+	//Size of the window used to calculate the non-maximal supression.
+	int m_widthWinNonMaxSup;
+	//Width of the square array of orientations histograms.
+	int m_widthArrayHist;
+	//Width in pixels of the sub-windows where a orientation histogram is computed.
+	int m_widthSubWinHist;
+	//Number of bins of each orientation histogram.
+	int m_noBinsOriHist;
+	//Maximum value allowed for each component of the vector descriptor.
+	float m_maxRespCompDesc;
+	//Second nearest neighbor restriction threshold.
+	float m_threshRatSecBest;
+	//Maximum radius of search in the correspondence process.
+	float m_radMaxSearch;
+private:
+	/*Look-up tables*/
+	float** m_LutMagGradient;
+	float** m_LutPhaseGradient;
+	//Arctangent of the ratios [0,1] with NO_BITS_ATAN_INT bits, as binary angles (a full turn is 65536).
+	unsigned short* m_LutAtanInt;
+};
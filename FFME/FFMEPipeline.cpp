@@ -0,0 +1,471 @@
+//-------------------------------------------------------------------------
+// FFMEPipeline.cpp
+//-------------------------------------------------------------------------
+// Description: pipelined processing of video frames.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "FFMEPipeline.h"
+
+
+FFMEPipeline::FFMEPipeline(void)
+{
+	m_noSlots = 0;
+	m_noResults = 0;
+	m_ffmeSlots = 0;
+	m_running = false;
+}
+
+FFMEPipeline::~FFMEPipeline(void)
+{
+	releasePipeline();
+}
+
+
+/* Release of the slots and the results. The threads are stopped before if they are running.
+   Inputs: --
+   Outputs: --
+*/
+void FFMEPipeline::releasePipeline()
+{
+	int i, j;
+
+	if(m_noSlots == 0)
+	{
+		return;
+	}
+	if(m_running)
+	{
+		stopPipeline();
+	}
+
+	//Release memory.
+	for(i=0;i<m_noSlots;i++)
+	{
+		cvReleaseImage(m_imgSlots+i);
+		cvFree(m_ptosSlots+i);
+		for(j=0;j<m_maxNoKeyPoints;j++)
+		{
+			cvFree(m_descSlots[i]+j);
+		}
+		cvFree(m_descSlots+i);
+	}
+	delete [] m_ffmeSlots;
+	cvFree(&m_imgSlots);
+	cvFree(&m_ptosSlots);
+	cvFree(&m_noPtosSlots);
+	cvFree(&m_descSlots);
+	cvFree(&m_idxFrameSlots);
+	for(i=0;i<m_noResults;i++)
+	{
+		cvReleaseImage(m_imgResults+i);
+		for(j=0;j<m_maxNoKeyPoints;j++)
+		{
+			cvFree(m_corrResults[i]+j);
+		}
+		cvFree(m_corrResults+i);
+	}
+	cvFree(&m_corrResults);
+	cvFree(&m_noCorrResults);
+	cvFree(&m_imgResults);
+	cvFree(&m_idxFrameResults);
+	m_ffmeSlots = 0;
+	m_noSlots = 0;
+	m_noResults = 0;
+}
+
+
+/* Initialization of memory. Every slot has a workspace bound to the engine, so the configuration of the detection and
+   the description is the one of the engine. The number of results is twice the number of slots. If the pipeline was
+   already initialized, its memory is released before (and its threads are stopped).
+   Inputs:
+   -engine: initialized engine. It must outlive the pipeline.
+   -width: image width.
+   -height: image height.
+   -origin: image origin (field of the OpenCV IplImage structure).
+   -maxNoKeyPoints: maximum number of keypoints that can be detected in an image.
+   -noSlots: number of frames in flight. At least 2 are needed, since the matching stage keeps the slot of the previous
+    frame (with a single slot a blocking insertion would never find a free one), so smaller values are raised to 2.
+   Outputs: --
+*/
+void FFMEPipeline::iniPipeline(FFMEEngine* engine, int width, int height, int origin, int maxNoKeyPoints, int noSlots)
+{
+	int i, j;
+
+	releasePipeline();
+	noSlots = MAX(noSlots, 2);
+	m_backpressure = PIPELINE_BLOCK;
+	m_LUT = true;
+	m_motionPriorGrid = true;
+	m_noSlots = noSlots;
+	m_noResults = 2*noSlots;
+	m_maxNoKeyPoints = maxNoKeyPoints;
+	m_lengthDesc = engine->m_widthArrayHist*engine->m_widthArrayHist*engine->m_noBinsOriHist;
+	m_curResult = -1;
+	m_noFrames = 0;
+	m_noDropped = 0;
+
+	//Slots.
+	m_ffmeSlots = new FFME[noSlots];
+	m_imgSlots = (IplImage**)cvAlloc(noSlots * sizeof(IplImage*));
+	m_ptosSlots = (CvPoint2D32f**)cvAlloc(noSlots * sizeof(CvPoint2D32f*));
+	m_noPtosSlots = (int*)cvAlloc(noSlots * sizeof(int));
+	m_descSlots = (float***)cvAlloc(noSlots * sizeof(float**));
+	m_idxFrameSlots = (int*)cvAlloc(noSlots * sizeof(int));
+	for(i=0;i<noSlots;i++)
+	{
+		m_ffmeSlots[i].iniFFME(engine, width, height, origin, maxNoKeyPoints);
+		m_imgSlots[i] = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+		m_imgSlots[i]->origin = origin;
+		m_ptosSlots[i] = (CvPoint2D32f*)cvAlloc(maxNoKeyPoints * sizeof(CvPoint2D32f));
+		m_descSlots[i] = (float**)cvAlloc(maxNoKeyPoints * sizeof(float*));
+		for(j=0;j<maxNoKeyPoints;j++)
+		{
+			m_descSlots[i][j] = (float*)cvAlloc(m_lengthDesc * sizeof(float));
+		}
+	}
+
+	//Results.
+	m_ffmeMatch.iniFFME(engine, width, height, origin, maxNoKeyPoints, true); //Only matching and prior.
+	m_corrResults = (CvPoint2D32f***)cvAlloc(m_noResults * sizeof(CvPoint2D32f**));
+	m_noCorrResults = (int*)cvAlloc(m_noResults * sizeof(int));
+	m_imgResults = (IplImage**)cvAlloc(m_noResults * sizeof(IplImage*));
+	m_idxFrameResults = (int*)cvAlloc(m_noResults * sizeof(int));
+	for(i=0;i<m_noResults;i++)
+	{
+		m_imgResults[i] = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+		m_imgResults[i]->origin = origin;
+		m_corrResults[i] = (CvPoint2D32f**)cvAlloc(maxNoKeyPoints * sizeof(CvPoint2D32f*));
+		for(j=0;j<maxNoKeyPoints;j++)
+		{
+			m_corrResults[i][j] = (CvPoint2D32f*)cvAlloc(2 * sizeof(CvPoint2D32f));
+		}
+	}
+
+	//Queues. All of them can hold every slot (or result), so the insertions between stages never fail.
+	m_freeQueue.iniQueue(noSlots);
+	m_detectQueue.iniQueue(noSlots);
+	m_describeQueue.iniQueue(noSlots);
+	m_matchQueue.iniQueue(noSlots);
+	m_resultQueue.iniQueue(m_noResults);
+	m_freeResultQueue.iniQueue(m_noResults);
+	for(i=0;i<noSlots;i++)
+	{
+		m_freeQueue.push(i);
+	}
+	for(i=0;i<m_noResults;i++)
+	{
+		m_freeResultQueue.push(i);
+	}
+}
+
+
+/* Start of the stage threads.
+   Inputs: --
+   Outputs: --
+*/
+void FFMEPipeline::startPipeline()
+{
+	int i;
+
+	m_stop = 0;
+	for(i=0;i<3;i++)
+	{
+		m_stageDone[i] = 0;
+	}
+	m_running = true;
+	createThread(m_threads, detectStage, this);
+	createThread(m_threads+1, describeStage, this);
+	createThread(m_threads+2, matchStage, this);
+}
+
+
+/* End of the stage threads. The frames already inserted are processed before, and their results can still be 
+   extracted. If there are no free results, because they have not been extracted, the last results are discarded.
+   Inputs: --
+   Outputs: --
+*/
+void FFMEPipeline::stopPipeline()
+{
+	int i;
+
+	memoryBarrier();
+	m_stop = 1;
+	for(i=0;i<3;i++)
+	{
+		joinThread(m_threads+i);
+	}
+	m_running = false;
+}
+
+
+/* Insertion of a new frame. The frame is copied, so the image can be reused after the call. If all the slots are in use,
+   the call waits for a free slot or drops the frame, depending on the backpressure policy. The frame indices count also
+   the dropped frames.
+   Inputs:
+   -img_U81C: unsigned 8 bit input image.
+   Outputs: false if the frame is dropped.
+*/
+bool FFMEPipeline::pushFrame(IplImage* img_U81C)
+{
+	int slot, noSpins = 0;
+	int idxFrame = m_noFrames++;
+
+	while(!m_freeQueue.pop(&slot))
+	{
+		if(m_backpressure == PIPELINE_DROP)
+		{
+			m_noDropped++;
+			return false;
+		}
+		waitThread(&noSpins);
+	}
+
+	cvCopy(img_U81C, m_imgSlots[slot]);
+	m_idxFrameSlots[slot] = idxFrame;
+	m_detectQueue.push(slot);
+	return true;
+}
+
+
+/* Insertion of a new frame given as a luma view. See the other version of the function.
+   Inputs:
+   -luma: view of the unsigned 8 bit luma plane.
+   Outputs: false if the frame is dropped.
+*/
+bool FFMEPipeline::pushFrame(FFMELumaView* luma)
+{
+	IplImage header;
+
+	cvInitImageHeader(&header, cvSize(luma->width, luma->height), IPL_DEPTH_8U, 1, m_imgSlots[0]->origin);
+	cvSetData(&header, luma->data, luma->stride);
+	return pushFrame(&header);
+}
+
+
+/* Extraction of the result of the oldest processed frame. The results are extracted in the order of the frames. The
+   previous result is released, and the data of the new one are valid until it is released.
+   Inputs:
+   -idxFrame: (input/output) index of the frame.
+   -correspondences: (input/output) array of correspondences between the previous processed frame (first point) and the
+    frame (second point). It is empty for the first frame.
+   -noCorr: (input/output) number of correspondences.
+   -img_U81C: (input/output) image of the frame. It must not be modified.
+   -wait: flag to indicate if the call waits for a result (true) or returns immediately (false). It does not wait if the
+    pipeline is stopped.
+   Outputs: false if there is no result.
+*/
+bool FFMEPipeline::popResult(int* idxFrame, CvPoint2D32f*** correspondences, int* noCorr, IplImage** img_U81C, bool wait)
+{
+	int result, noSpins = 0;
+	long done;
+
+	if(m_curResult != -1)
+	{
+		releaseResult();
+	}
+
+	while(true)
+	{
+		done = m_stageDone[2] || !m_running;
+		memoryBarrier();
+		if(m_resultQueue.pop(&result))
+		{
+			break;
+		}
+		if(!wait || done)
+		{
+			return false;
+		}
+		waitThread(&noSpins);
+	}
+
+	m_curResult = result;
+	*idxFrame = m_idxFrameResults[result];
+	*correspondences = m_corrResults[result];
+	*noCorr = m_noCorrResults[result];
+	*img_U81C = m_imgResults[result];
+	return true;
+}
+
+
+/* Release of the last extracted result, so its memory can be reused by the pipeline.
+   Inputs: --
+   Outputs: --
+*/
+void FFMEPipeline::releaseResult()
+{
+	if(m_curResult != -1)
+	{
+		m_freeResultQueue.push(m_curResult);
+		m_curResult = -1;
+	}
+}
+
+
+/* Detection stage. It ends when the pipeline is stopped and there are no more frames.
+   Inputs:
+   -arg: pipeline.
+   Outputs: --
+*/
+FFME_THREAD_FUNC(FFMEPipeline::detectStage)
+{
+	FFMEPipeline* pipeline = (FFMEPipeline*)arg;
+	int slot, noSpins = 0;
+	long done;
+
+	while(true)
+	{
+		done = pipeline->m_stop;
+		memoryBarrier();
+		if(pipeline->m_detectQueue.pop(&slot))
+		{
+			noSpins = 0;
+			if(pipeline->m_LUT)
+			{
+				pipeline->m_ffmeSlots[slot].singPtoDetLut(pipeline->m_imgSlots[slot], pipeline->m_ptosSlots[slot], pipeline->m_noPtosSlots+slot);
+			}
+			else
+			{
+				pipeline->m_ffmeSlots[slot].singPtoDetFunc(pipeline->m_imgSlots[slot], pipeline->m_ptosSlots[slot], pipeline->m_noPtosSlots+slot);
+			}
+			pipeline->m_describeQueue.push(slot);
+		}
+		else if(done)
+		{
+			break;
+		}
+		else
+		{
+			waitThread(&noSpins);
+		}
+	}
+
+	memoryBarrier();
+	pipeline->m_stageDone[0] = 1;
+	return 0;
+}
+
+
+/* Description stage. The gradients of each frame are the ones computed by the detection in the workspace of its slot.
+   It ends when the detection stage has ended and there are no more frames.
+   Inputs:
+   -arg: pipeline.
+   Outputs: --
+*/
+FFME_THREAD_FUNC(FFMEPipeline::describeStage)
+{
+	FFMEPipeline* pipeline = (FFMEPipeline*)arg;
+	int slot, noSpins = 0;
+	long done;
+
+	while(true)
+	{
+		done = pipeline->m_stageDone[0];
+		memoryBarrier();
+		if(pipeline->m_describeQueue.pop(&slot))
+		{
+			noSpins = 0;
+			if(pipeline->m_LUT)
+			{
+				pipeline->m_ffmeSlots[slot].singPtoDescLut(pipeline->m_ptosSlots[slot], pipeline->m_noPtosSlots[slot], pipeline->m_descSlots[slot], true);
+			}
+			else
+			{
+				pipeline->m_ffmeSlots[slot].singPtoDescFunc(pipeline->m_ptosSlots[slot], pipeline->m_noPtosSlots[slot], pipeline->m_descSlots[slot], true);
+			}
+			pipeline->m_matchQueue.push(slot);
+		}
+		else if(done)
+		{
+			break;
+		}
+		else
+		{
+			waitThread(&noSpins);
+		}
+	}
+
+	memoryBarrier();
+	pipeline->m_stageDone[1] = 1;
+	return 0;
+}
+
+
+/* Matching stage. Each frame is matched with the previous one, whose slot is kept until then. The correspondences are 
+   stored in a free result, waiting for it if necessary. It ends when the description stage has ended and there are no 
+   more frames.
+   Inputs:
+   -arg: pipeline.
+   Outputs: --
+*/
+FFME_THREAD_FUNC(FFMEPipeline::matchStage)
+{
+	FFMEPipeline* pipeline = (FFMEPipeline*)arg;
+	int slot, prevSlot = -1, result, noSpins = 0;
+	long done;
+
+	while(true)
+	{
+		done = pipeline->m_stageDone[1];
+		memoryBarrier();
+		if(pipeline->m_matchQueue.pop(&slot))
+		{
+			noSpins = 0;
+
+			//Free result. If the pipeline is stopping and the results are not extracted, the result is discarded.
+			while(!pipeline->m_freeResultQueue.pop(&result))
+			{
+				if(pipeline->m_stop)
+				{
+					result = -1;
+					break;
+				}
+				waitThread(&noSpins);
+			}
+
+			if(result != -1)
+			{
+				pipeline->m_noCorrResults[result] = 0;
+				if(prevSlot != -1)
+				{
+					pipeline->m_ffmeMatch.matchSingPtos(pipeline->m_ptosSlots[prevSlot], pipeline->m_noPtosSlots[prevSlot], pipeline->m_descSlots[prevSlot],
+					                                pipeline->m_ptosSlots[slot], pipeline->m_noPtosSlots[slot], pipeline->m_descSlots[slot],
+					                                pipeline->m_corrResults[result], pipeline->m_noCorrResults+result);
+					if(pipeline->m_motionPriorGrid)
+					{
+						pipeline->m_ffmeMatch.setMotionPriorGrid(pipeline->m_corrResults[result], pipeline->m_noCorrResults[result]);
+					}
+				}
+				cvCopy(pipeline->m_imgSlots[slot], pipeline->m_imgResults[result]);
+				pipeline->m_idxFrameResults[result] = pipeline->m_idxFrameSlots[slot];
+				pipeline->m_resultQueue.push(result);
+			}
+
+			//The previous slot is not needed any more.
+			if(prevSlot != -1)
+			{
+				pipeline->m_freeQueue.push(prevSlot);
+			}
+			prevSlot = slot;
+		}
+		else if(done)
+		{
+			break;
+		}
+		else
+		{
+			waitThread(&noSpins);
+		}
+	}
+
+	if(prevSlot != -1)
+	{
+		pipeline->m_freeQueue.push(prevSlot);
+	}
+	memoryBarrier();
+	pipeline->m_stageDone[2] = 1;
+	return 0;
+}
@@ -0,0 +1,139 @@
+//-------------------------------------------------------------------------
+// FFMEPipeline.h
+//-------------------------------------------------------------------------
+// Description: pipelined processing of video frames. The detection, the
+// description and the matching run on dedicated threads connected by
+// bounded lock-free queues, so the detection of frame t+1, the
+// description of frame t and the matching of frame t-1 are done at the
+// same time, and the throughput approaches the one of the slowest stage.
+// Each frame in flight uses a buffer (slot) with its own FFME workspace
+// bound to a shared engine, so the look-up tables are not duplicated.
+// The frames are processed in order.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+
+//Motion estimation class.
+#include "FFME.h"
+//Threads and queues.
+#include "FFMEThreads.h"
+
+
+//********************************************Parameters******************************************
+#define NO_SLOTS_PIPELINE 6 //Number of frames in flight (at least 4 to overlap the three stages).
+//************************************************************************************************
+
+
+//Backpressure policies, applied when a new frame arrives and all the slots are in use.
+#define PIPELINE_BLOCK 0 //The insertion waits until a slot is free.
+#define PIPELINE_DROP 1 //The new frame is dropped.
+
+
+class FFMEPipeline
+{
+//Methods:
+public:
+	FFMEPipeline(void);
+	~FFMEPipeline(void);
+	//Initialization of memory. The configuration of the stages is the one of the engine.
+	void iniPipeline(FFMEEngine* engine, int width, int height, int origin, int maxNoKeyPoints, 
+		             int noSlots = NO_SLOTS_PIPELINE);
+	//Start of the stage threads.
+	void startPipeline();
+	//End of the stage threads once the frames in flight are processed.
+	void stopPipeline();
+	//Insertion of a new frame (it is copied). Returns false if the frame is dropped.
+	bool pushFrame(IplImage* img_U81C);
+	//Insertion of a new frame given as a luma view (it is copied). Returns false if the frame is dropped.
+	bool pushFrame(FFMELumaView* luma);
+	//Extraction of the result of the oldest processed frame. Returns false if there is no result.
+	bool popResult(int* idxFrame, CvPoint2D32f*** correspondences, int* noCorr, IplImage** img_U81C, bool wait = true);
+	//Release of the last extracted result.
+	void releaseResult();
+
+	//--get and set functions--//
+	//Set the backpressure policy (PIPELINE_BLOCK or PIPELINE_DROP).
+	void setBackpressure(int backpressure)
+	{
+		m_backpressure = backpressure;
+	}
+
+	//Get the number of dropped frames.
+	int getNoDropped()
+	{
+		return m_noDropped;
+	}
+
+	//Get the workspace of the matching stage (e.g. to set its matching parameters before the start).
+	FFME* getMatchFFME()
+	{
+		return &m_ffmeMatch;
+	}
+
+private:
+	//Release of the slots and the results.
+	void releasePipeline();
+	//Stage threads.
+	static FFME_THREAD_FUNC(detectStage);
+	static FFME_THREAD_FUNC(describeStage);
+	static FFME_THREAD_FUNC(matchStage);
+
+//Members:
+public:
+	//Backpressure policy.
+	int m_backpressure;
+	//Flag to indicate if the detection and description are based on LUTs (true) or functions (false).
+	bool m_LUT;
+	//Flag to indicate if the correspondences of each frame are used as motion prior of the next one.
+	bool m_motionPriorGrid;
+private:
+	//Number of slots, maximum number of singular points and length of the descriptors.
+	int m_noSlots;
+	int m_maxNoKeyPoints;
+	int m_lengthDesc;
+
+	/*Slots (frames in flight)*/
+	//Workspace, image, singular points, descriptors and frame index of each slot.
+	FFME* m_ffmeSlots;
+	IplImage** m_imgSlots;
+	CvPoint2D32f** m_ptosSlots;
+	int* m_noPtosSlots;
+	float*** m_descSlots;
+	int* m_idxFrameSlots;
+
+	/*Results*/
+	//Workspace of the matching stage (it keeps the motion prior). It does not reserve the memory of the detection.
+	FFME m_ffmeMatch;
+	//Correspondences, image and frame index of each result.
+	int m_noResults;
+	CvPoint2D32f*** m_corrResults;
+	int* m_noCorrResults;
+	IplImage** m_imgResults;
+	int* m_idxFrameResults;
+	//Result extracted by the consumer (-1 if there is none).
+	int m_curResult;
+
+	/*Queues*/
+	//Free slots, slots waiting for each stage, finished results and free results.
+	FFMEQueue m_freeQueue;
+	FFMEQueue m_detectQueue;
+	FFMEQueue m_describeQueue;
+	FFMEQueue m_matchQueue;
+	FFMEQueue m_resultQueue;
+	FFMEQueue m_freeResultQueue;
+
+	/*Threads*/
+	FFMEThread m_threads[3];
+	//Flag to stop the threads, and flags of the finished stages.
+	volatile long m_stop;
+	volatile long m_stageDone[3];
+	bool m_running;
+	//Number of inserted (including the dropped ones) and dropped frames.
+	int m_noFrames;
+	int m_noDropped;
+};
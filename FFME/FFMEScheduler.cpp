@@ -0,0 +1,562 @@
+//-------------------------------------------------------------------------
+// FFMEScheduler.cpp
+//-------------------------------------------------------------------------
+// Description: motion estimation of many video streams with a shared
+// pool of worker threads.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "FFMEScheduler.h"
+
+
+FFMEScheduler::FFMEScheduler(void)
+{
+	m_engine = 0;
+	m_noStreams = 0;
+	m_streams = 0;
+	m_noWorkers = 0;
+	m_running = false;
+}
+
+FFMEScheduler::~FFMEScheduler(void)
+{
+	int i, j, k;
+	FFMEStream* stream;
+
+	if(m_engine == 0)
+	{
+		return;
+	}
+	if(m_running)
+	{
+		stopScheduler();
+	}
+
+	//Release memory.
+	for(k=0;k<m_noStreams;k++)
+	{
+		stream = m_streams+k;
+		for(i=0;i<m_noSlots;i++)
+		{
+			cvReleaseImage(stream->img+i);
+			cvFree(stream->ptos+i);
+			for(j=0;j<m_maxNoKeyPoints;j++)
+			{
+				cvFree(stream->desc[i]+j);
+				cvFree(stream->corr[i]+j);
+			}
+			cvFree(stream->desc+i);
+			cvFree(stream->corr+i);
+		}
+		delete stream->ffme;
+		cvFree(&stream->img);
+		cvFree(&stream->ptos);
+		cvFree(&stream->noPtos);
+		cvFree(&stream->desc);
+		cvFree(&stream->corr);
+		cvFree(&stream->noCorr);
+		cvFree(&stream->idxFrame);
+		cvFree(&stream->state);
+		cvFree(&stream->refs);
+		cvFree(&stream->freeSlots);
+		cvFree(&stream->seqSlot);
+		releaseMutex(&stream->mutex);
+	}
+	cvFree(&m_streams);
+	releaseMutex(&m_mutexStreams);
+	for(i=0;i<m_noWorkers;i++)
+	{
+		cvFree(m_tasks+i);
+		releaseMutex(m_mutexTasks+i);
+	}
+	delete [] m_ffmeWorkers;
+	cvFree(&m_threads);
+	cvFree(&m_workers);
+	cvFree(&m_tasks);
+	cvFree(&m_headTasks);
+	cvFree(&m_tailTasks);
+	cvFree(&m_mutexTasks);
+}
+
+
+/* Initialization of memory. The memory of the streams is allocated when they are registered.
+   Inputs:
+   -engine: initialized engine. It must outlive the scheduler.
+   -width: image width (all the streams).
+   -height: image height (all the streams).
+   -origin: image origin (field of the OpenCV IplImage structure).
+   -maxNoKeyPoints: maximum number of keypoints that can be detected in an image.
+   -maxNoStreams: maximum number of streams.
+   -noWorkers: number of worker threads. If it is 0, the number of processors is used.
+   -maxInFlight: maximum number of frames in flight of a stream, from the submission to the release of the result.
+   Outputs: --
+*/
+void FFMEScheduler::iniScheduler(FFMEEngine* engine, int width, int height, int origin, int maxNoKeyPoints, int maxNoStreams,
+                                 int noWorkers, int maxInFlight)
+{
+	int i;
+
+	m_engine = engine;
+	m_width = width;
+	m_height = height;
+	m_origin = origin;
+	m_maxNoKeyPoints = maxNoKeyPoints;
+	m_lengthDesc = engine->m_widthArrayHist*engine->m_widthArrayHist*engine->m_noBinsOriHist;
+	m_LUT = true;
+	m_motionPriorGrid = true;
+	m_noStolen = 0;
+
+	//Streams.
+	m_maxNoStreams = maxNoStreams;
+	m_noStreams = 0;
+	m_noSlots = maxInFlight + 1;
+	m_streams = (FFMEStream*)cvAlloc(maxNoStreams * sizeof(FFMEStream));
+	iniMutex(&m_mutexStreams);
+
+	//Workers. Each queue can hold all the tasks.
+	m_noWorkers = (noWorkers > 0) ? noWorkers : getNoProcessors();
+	m_threads = (FFMEThread*)cvAlloc(m_noWorkers * sizeof(FFMEThread));
+	m_workers = (FFMEWorker*)cvAlloc(m_noWorkers * sizeof(FFMEWorker));
+	m_ffmeWorkers = new FFME[m_noWorkers];
+	m_capTasks = maxNoStreams*m_noSlots;
+	m_tasks = (int**)cvAlloc(m_noWorkers * sizeof(int*));
+	m_headTasks = (int*)cvAlloc(m_noWorkers * sizeof(int));
+	m_tailTasks = (int*)cvAlloc(m_noWorkers * sizeof(int));
+	m_mutexTasks = (FFMEMutex*)cvAlloc(m_noWorkers * sizeof(FFMEMutex));
+	for(i=0;i<m_noWorkers;i++)
+	{
+		m_workers[i].scheduler = this;
+		m_workers[i].idxWorker = i;
+		m_ffmeWorkers[i].iniFFME(engine, width, height, origin, maxNoKeyPoints);
+		m_tasks[i] = (int*)cvAlloc(m_capTasks * sizeof(int));
+		m_headTasks[i] = 0;
+		m_tailTasks[i] = 0;
+		iniMutex(m_mutexTasks+i);
+	}
+}
+
+
+/* Start of the worker threads.
+   Inputs: --
+   Outputs: --
+*/
+void FFMEScheduler::startScheduler()
+{
+	int i;
+
+	m_stop = 0;
+	m_running = true;
+	for(i=0;i<m_noWorkers;i++)
+	{
+		createThread(m_threads+i, workerThread, m_workers+i);
+	}
+}
+
+
+/* End of the worker threads. The submitted frames are processed before, and their results can still be extracted.
+   Inputs: --
+   Outputs: --
+*/
+void FFMEScheduler::stopScheduler()
+{
+	int i;
+
+	memoryBarrier();
+	m_stop = 1;
+	for(i=0;i<m_noWorkers;i++)
+	{
+		joinThread(m_threads+i);
+	}
+	m_running = false;
+}
+
+
+/* Registration of a new stream. It can be done while the workers are running. The workspace of the stream is only used
+   for the matching and its motion prior (the detection and description are done by the workspaces of the workers), so
+   it does not reserve the images of the detection.
+   Inputs: --
+   Outputs: identifier of the stream, or -1 if the maximum number of streams is reached.
+*/
+int FFMEScheduler::addStream()
+{
+	int i, j, idStream;
+	FFMEStream* stream;
+
+	lockMutex(&m_mutexStreams);
+	if(m_noStreams == m_maxNoStreams)
+	{
+		unlockMutex(&m_mutexStreams);
+		return -1;
+	}
+	idStream = m_noStreams;
+	stream = m_streams+idStream;
+
+	stream->ffme = new FFME;
+	stream->ffme->iniFFME(m_engine, m_width, m_height, m_origin, m_maxNoKeyPoints, true); //Only matching and prior.
+	stream->img = (IplImage**)cvAlloc(m_noSlots * sizeof(IplImage*));
+	stream->ptos = (CvPoint2D32f**)cvAlloc(m_noSlots * sizeof(CvPoint2D32f*));
+	stream->noPtos = (int*)cvAlloc(m_noSlots * sizeof(int));
+	stream->desc = (float***)cvAlloc(m_noSlots * sizeof(float**));
+	stream->corr = (CvPoint2D32f***)cvAlloc(m_noSlots * sizeof(CvPoint2D32f**));
+	stream->noCorr = (int*)cvAlloc(m_noSlots * sizeof(int));
+	stream->idxFrame = (int*)cvAlloc(m_noSlots * sizeof(int));
+	stream->state = (int*)cvAlloc(m_noSlots * sizeof(int));
+	stream->refs = (int*)cvAlloc(m_noSlots * sizeof(int));
+	stream->freeSlots = (int*)cvAlloc(m_noSlots * sizeof(int));
+	stream->seqSlot = (int*)cvAlloc(m_noSlots * sizeof(int));
+	for(i=0;i<m_noSlots;i++)
+	{
+		stream->img[i] = cvCreateImage(cvSize(m_width, m_height), IPL_DEPTH_8U, 1);
+		stream->img[i]->origin = m_origin;
+		stream->ptos[i] = (CvPoint2D32f*)cvAlloc(m_maxNoKeyPoints * sizeof(CvPoint2D32f));
+		stream->desc[i] = (float**)cvAlloc(m_maxNoKeyPoints * sizeof(float*));
+		stream->corr[i] = (CvPoint2D32f**)cvAlloc(m_maxNoKeyPoints * sizeof(CvPoint2D32f*));
+		for(j=0;j<m_maxNoKeyPoints;j++)
+		{
+			stream->desc[i][j] = (float*)cvAlloc(m_lengthDesc * sizeof(float));
+			stream->corr[i][j] = (CvPoint2D32f*)cvAlloc(2 * sizeof(CvPoint2D32f));
+		}
+		stream->state[i] = SLOT_FREE_SCHEDULER;
+		stream->refs[i] = 0;
+		stream->freeSlots[i] = m_noSlots - 1 - i;
+	}
+	stream->noFreeSlots = m_noSlots;
+	stream->nextSubmit = 0;
+	stream->nextMatch = 0;
+	stream->nextResult = 0;
+	stream->prevSlot = -1;
+	stream->curResult = -1;
+	stream->matching = 0;
+	stream->noFrames = 0;
+	stream->noRejected = 0;
+	iniMutex(&stream->mutex);
+
+	memoryBarrier();
+	m_noStreams++;
+	unlockMutex(&m_mutexStreams);
+	return idStream;
+}
+
+
+/* Submission of a frame of a stream. The frame is copied, so the image can be reused after the call. If the stream has
+   all its frames in flight (e.g. its results are not extracted), the frame is rejected, so a stream can not take more
+   than its share of the pool. The frame indices count also the rejected frames.
+   Inputs:
+   -idStream: identifier of the stream.
+   -img_U81C: unsigned 8 bit input image.
+   Outputs: false if the frame is rejected.
+*/
+bool FFMEScheduler::submitFrame(int idStream, IplImage* img_U81C)
+{
+	int slot;
+	FFMEStream* stream = m_streams+idStream;
+
+	lockMutex(&stream->mutex);
+	stream->noFrames++;
+	if(stream->noFreeSlots == 0)
+	{
+		stream->noRejected++;
+		unlockMutex(&stream->mutex);
+		return false;
+	}
+	slot = stream->freeSlots[--stream->noFreeSlots];
+	stream->idxFrame[slot] = stream->noFrames - 1;
+	stream->state[slot] = SLOT_SUBMITTED_SCHEDULER;
+	stream->seqSlot[stream->nextSubmit % m_noSlots] = slot;
+	stream->nextSubmit++;
+	unlockMutex(&stream->mutex);
+
+	//The task is queued in the worker associated with the stream.
+	cvCopy(img_U81C, stream->img[slot]);
+	pushTask(idStream % m_noWorkers, idStream*m_noSlots + slot);
+	return true;
+}
+
+
+/* Submission of a frame of a stream given as a luma view. See the other version of the function.
+   Inputs:
+   -idStream: identifier of the stream.
+   -luma: view of the unsigned 8 bit luma plane.
+   Outputs: false if the frame is rejected.
+*/
+bool FFMEScheduler::submitFrame(int idStream, FFMELumaView* luma)
+{
+	IplImage header;
+
+	cvInitImageHeader(&header, cvSize(luma->width, luma->height), IPL_DEPTH_8U, 1, m_origin);
+	cvSetData(&header, luma->data, luma->stride);
+	return submitFrame(idStream, &header);
+}
+
+
+/* Extraction of the result of the oldest matched frame of a stream. The results of a stream are extracted in the order
+   of its frames. The previous result of the stream is released, and the data of the new one are valid until it is
+   released. The call does not wait.
+   Inputs:
+   -idStream: identifier of the stream.
+   -idxFrame: (input/output) index of the frame in the stream.
+   -correspondences: (input/output) array of correspondences between the previous matched frame (first point) and the
+    frame (second point). It is empty for the first frame.
+   -noCorr: (input/output) number of correspondences.
+   -img_U81C: (input/output) image of the frame. It must not be modified.
+   Outputs: false if there is no result.
+*/
+bool FFMEScheduler::popResult(int idStream, int* idxFrame, CvPoint2D32f*** correspondences, int* noCorr, IplImage** img_U81C)
+{
+	int slot;
+	FFMEStream* stream = m_streams+idStream;
+
+	lockMutex(&stream->mutex);
+	if(stream->curResult != -1)
+	{
+		releaseSlot(stream, stream->curResult);
+		stream->curResult = -1;
+	}
+	if(stream->nextResult == stream->nextMatch)
+	{
+		unlockMutex(&stream->mutex);
+		return false;
+	}
+	slot = stream->seqSlot[stream->nextResult % m_noSlots];
+	stream->nextResult++;
+	stream->curResult = slot;
+	unlockMutex(&stream->mutex);
+
+	*idxFrame = stream->idxFrame[slot];
+	*correspondences = stream->corr[slot];
+	*noCorr = stream->noCorr[slot];
+	*img_U81C = stream->img[slot];
+	return true;
+}
+
+
+/* Release of the last extracted result of a stream, so its slot can be reused.
+   Inputs:
+   -idStream: identifier of the stream.
+   Outputs: --
+*/
+void FFMEScheduler::releaseResult(int idStream)
+{
+	FFMEStream* stream = m_streams+idStream;
+
+	lockMutex(&stream->mutex);
+	if(stream->curResult != -1)
+	{
+		releaseSlot(stream, stream->curResult);
+		stream->curResult = -1;
+	}
+	unlockMutex(&stream->mutex);
+}
+
+
+/* Worker thread. The worker processes the tasks of its queue, and when it is empty, it steals the oldest task of the
+   queues of the rest of workers. It ends when the scheduler is stopped and there are no more tasks.
+   Inputs:
+   -arg: worker (FFMEWorker structure).
+   Outputs: --
+*/
+FFME_THREAD_FUNC(FFMEScheduler::workerThread)
+{
+	FFMEWorker* worker = (FFMEWorker*)arg;
+	FFMEScheduler* scheduler = worker->scheduler;
+	int i, task, noSpins = 0;
+	long done;
+	bool found;
+
+	while(true)
+	{
+		done = scheduler->m_stop;
+		memoryBarrier();
+		found = scheduler->popTask(worker->idxWorker, &task);
+		for(i=1;i<scheduler->m_noWorkers && !found;i++)
+		{
+			found = scheduler->popTask((worker->idxWorker + i) % scheduler->m_noWorkers, &task);
+			if(found)
+			{
+				atomicIncrement(&scheduler->m_noStolen);
+			}
+		}
+
+		if(found)
+		{
+			noSpins = 0;
+			scheduler->processTask(worker->idxWorker, task);
+		}
+		else if(done)
+		{
+			break;
+		}
+		else
+		{
+			waitThread(&noSpins);
+		}
+	}
+	return 0;
+}
+
+
+/* Detection and description of a frame in the workspace of a worker, and matching of the stream if the frame is the
+   next one to be matched.
+   Inputs:
+   -idxWorker: index of the worker.
+   -task: task (identifier of the stream and slot of the frame).
+   Outputs: --
+*/
+void FFMEScheduler::processTask(int idxWorker, int task)
+{
+	int slot = task % m_noSlots;
+	FFMEStream* stream = m_streams + task/m_noSlots;
+	FFME* ffme = m_ffmeWorkers+idxWorker;
+
+	if(m_LUT)
+	{
+		ffme->singPtoDetLut(stream->img[slot], stream->ptos[slot], stream->noPtos+slot);
+		ffme->singPtoDescLut(stream->ptos[slot], stream->noPtos[slot], stream->desc[slot], true);
+	}
+	else
+	{
+		ffme->singPtoDetFunc(stream->img[slot], stream->ptos[slot], stream->noPtos+slot);
+		ffme->singPtoDescFunc(stream->ptos[slot], stream->noPtos[slot], stream->desc[slot], true);
+	}
+
+	lockMutex(&stream->mutex);
+	stream->state[slot] = SLOT_DESCRIBED_SCHEDULER;
+	unlockMutex(&stream->mutex);
+
+	matchStream(stream);
+}
+
+
+/* Matching of the described frames of a stream, in frame order. Only one worker matches a stream at a time: if other
+   worker is matching it, the call returns, and that worker matches the new frame when it ends. Each frame is matched
+   with the previous one, whose slot is kept until then.
+   Inputs:
+   -stream: stream.
+   Outputs: --
+*/
+void FFMEScheduler::matchStream(FFMEStream* stream)
+{
+	int slot, prevSlot;
+	bool ready;
+
+	while(true)
+	{
+		if(atomicCompareExchange(&stream->matching, 1, 0) != 0)
+		{
+			return;
+		}
+
+		while(true)
+		{
+			lockMutex(&stream->mutex);
+			if(stream->nextMatch == stream->nextSubmit)
+			{
+				unlockMutex(&stream->mutex);
+				break;
+			}
+			slot = stream->seqSlot[stream->nextMatch % m_noSlots];
+			if(stream->state[slot] != SLOT_DESCRIBED_SCHEDULER)
+			{
+				unlockMutex(&stream->mutex);
+				break;
+			}
+			prevSlot = stream->prevSlot;
+			unlockMutex(&stream->mutex);
+
+			stream->noCorr[slot] = 0;
+			if(prevSlot != -1)
+			{
+				stream->ffme->matchSingPtos(stream->ptos[prevSlot], stream->noPtos[prevSlot], stream->desc[prevSlot],
+				                            stream->ptos[slot], stream->noPtos[slot], stream->desc[slot],
+				                            stream->corr[slot], stream->noCorr+slot);
+				if(m_motionPriorGrid)
+				{
+					stream->ffme->setMotionPriorGrid(stream->corr[slot], stream->noCorr[slot]);
+				}
+			}
+
+			//The slot is referenced by its result and by the next matching.
+			lockMutex(&stream->mutex);
+			stream->state[slot] = SLOT_MATCHED_SCHEDULER;
+			stream->refs[slot] = 2;
+			if(prevSlot != -1)
+			{
+				releaseSlot(stream, prevSlot);
+			}
+			stream->prevSlot = slot;
+			stream->nextMatch++;
+			unlockMutex(&stream->mutex);
+		}
+
+		memoryBarrier();
+		stream->matching = 0;
+		memoryBarrier();
+
+		//A frame described while the matching was ending has not been matched by its worker.
+		lockMutex(&stream->mutex);
+		ready = stream->nextMatch != stream->nextSubmit &&
+		        stream->state[stream->seqSlot[stream->nextMatch % m_noSlots]] == SLOT_DESCRIBED_SCHEDULER;
+		unlockMutex(&stream->mutex);
+		if(!ready)
+		{
+			return;
+		}
+	}
+}
+
+
+/* Release of a reference to a matched slot. The slot is free when its result has been released and the next frame has
+   been matched. The mutex of the stream must be locked.
+   Inputs:
+   -stream: stream.
+   -slot: slot.
+   Outputs: --
+*/
+void FFMEScheduler::releaseSlot(FFMEStream* stream, int slot)
+{
+	stream->refs[slot]--;
+	if(stream->refs[slot] == 0)
+	{
+		stream->state[slot] = SLOT_FREE_SCHEDULER;
+		stream->freeSlots[stream->noFreeSlots++] = slot;
+	}
+}
+
+
+/* Insertion of a task at the end of the queue of a worker.
+   Inputs:
+   -idxWorker: index of the worker.
+   -task: task.
+   Outputs: --
+*/
+void FFMEScheduler::pushTask(int idxWorker, int task)
+{
+	lockMutex(m_mutexTasks+idxWorker);
+	m_tasks[idxWorker][m_tailTasks[idxWorker] % m_capTasks] = task;
+	m_tailTasks[idxWorker]++;
+	unlockMutex(m_mutexTasks+idxWorker);
+}
+
+
+/* Extraction of the oldest task of the queue of a worker.
+   Inputs:
+   -idxWorker: index of the worker.
+   -task: (input/output) task.
+   Outputs: false if the queue is empty.
+*/
+bool FFMEScheduler::popTask(int idxWorker, int* task)
+{
+	bool found = false;
+
+	lockMutex(m_mutexTasks+idxWorker);
+	if(m_headTasks[idxWorker] != m_tailTasks[idxWorker])
+	{
+		*task = m_tasks[idxWorker][m_headTasks[idxWorker] % m_capTasks];
+		m_headTasks[idxWorker]++;
+		found = true;
+	}
+	unlockMutex(m_mutexTasks+idxWorker);
+	return found;
+}
@@ -0,0 +1,192 @@
+//-------------------------------------------------------------------------
+// FFMEScheduler.h
+//-------------------------------------------------------------------------
+// Description: motion estimation of many video streams with a shared
+// pool of worker threads. Each stream is registered once and its frames
+// are submitted as they arrive. A frame is a task (detection and
+// description) that is queued in the worker associated with its stream,
+// and idle workers steal tasks from the rest, so bursty streams are
+// spread over all the processors. The matching of each stream is done in
+// frame order by the worker that completes the missing frame, and the
+// results are extracted in frame order. Each stream has a bounded number
+// of frames in flight, so a stream can not take the whole pool. All the
+// workers and streams share an engine, so the look-up tables are not
+// duplicated.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+
+//Motion estimation class.
+#include "FFME.h"
+//Threads and queues.
+#include "FFMEThreads.h"
+
+
+//********************************************Parameters******************************************
+#define MAX_IN_FLIGHT_SCHEDULER 4 //Maximum number of frames in flight of a stream (including the not extracted results).
+//************************************************************************************************
+
+
+//State of the slots of a stream.
+#define SLOT_FREE_SCHEDULER 0
+#define SLOT_SUBMITTED_SCHEDULER 1 //Waiting for the detection and description.
+#define SLOT_DESCRIBED_SCHEDULER 2 //Waiting for the matching.
+#define SLOT_MATCHED_SCHEDULER 3 //Result (and previous frame of the next matching).
+
+
+//State of a stream: frame buffers (slots), matching and results.
+struct FFMEStream
+{
+	//Workspace of the matching (it keeps the motion prior of the stream). It does not reserve the memory of the detection.
+	FFME* ffme;
+	//Image, singular points, descriptors, correspondences and frame index of each slot.
+	IplImage** img;
+	CvPoint2D32f** ptos;
+	int* noPtos;
+	float*** desc;
+	CvPoint2D32f*** corr;
+	int* noCorr;
+	int* idxFrame;
+	//State of each slot (free, submitted, described or matched) and number of references to a matched slot.
+	int* state;
+	int* refs;
+	//Free slots.
+	int* freeSlots;
+	int noFreeSlots;
+	//Slot of each frame in flight (circular buffer indexed by the sequence number).
+	int* seqSlot;
+	//Sequence numbers of the next submitted, matched and extracted frame.
+	int nextSubmit;
+	int nextMatch;
+	int nextResult;
+	//Slot of the last matched frame (-1 if there is none) and slot of the extracted result (-1 if there is none).
+	int prevSlot;
+	int curResult;
+	//Flag of the matching in progress.
+	volatile long matching;
+	//Mutex of the state.
+	FFMEMutex mutex;
+	//Number of submitted frames (including the rejected ones) and number of rejected frames.
+	int noFrames;
+	int noRejected;
+};
+
+
+class FFMEScheduler;
+
+//Argument of a worker thread.
+struct FFMEWorker
+{
+	FFMEScheduler* scheduler;
+	int idxWorker;
+};
+
+
+class FFMEScheduler
+{
+//Methods:
+public:
+	FFMEScheduler(void);
+	~FFMEScheduler(void);
+	//Initialization of memory. All the streams have the same image size.
+	void iniScheduler(FFMEEngine* engine, int width, int height, int origin, int maxNoKeyPoints, int maxNoStreams,
+		              int noWorkers = 0, int maxInFlight = MAX_IN_FLIGHT_SCHEDULER);
+	//Start of the worker threads.
+	void startScheduler();
+	//End of the worker threads once the submitted frames are processed.
+	void stopScheduler();
+	//Registration of a new stream. Returns its identifier, or -1 if the maximum number of streams is reached.
+	int addStream();
+	//Submission of a frame of a stream (it is copied). Returns false if the stream has no free slot.
+	bool submitFrame(int idStream, IplImage* img_U81C);
+	//Submission of a frame of a stream given as a luma view (it is copied). Returns false if the stream has no free slot.
+	bool submitFrame(int idStream, FFMELumaView* luma);
+	//Extraction of the result of the oldest matched frame of a stream. Returns false if there is no result.
+	bool popResult(int idStream, int* idxFrame, CvPoint2D32f*** correspondences, int* noCorr, IplImage** img_U81C);
+	//Release of the last extracted result of a stream.
+	void releaseResult(int idStream);
+
+	//--get and set functions--//
+	//Get the number of streams.
+	int getNoStreams()
+	{
+		return m_noStreams;
+	}
+
+	//Get the number of worker threads.
+	int getNoWorkers()
+	{
+		return m_noWorkers;
+	}
+
+	//Get the number of frames of a stream rejected because the stream had no free slot.
+	int getNoRejected(int idStream)
+	{
+		return m_streams[idStream].noRejected;
+	}
+
+	//Get the number of tasks stolen by idle workers.
+	int getNoStolen()
+	{
+		return (int)m_noStolen;
+	}
+
+private:
+	//Worker thread.
+	static FFME_THREAD_FUNC(workerThread);
+	//Detection and description of a frame.
+	void processTask(int idxWorker, int task);
+	//Matching of the described frames of a stream, in frame order.
+	void matchStream(FFMEStream* stream);
+	//Release of a reference to a matched slot.
+	void releaseSlot(FFMEStream* stream, int slot);
+	//Insertion and extraction of tasks in the queue of a worker.
+	void pushTask(int idxWorker, int task);
+	bool popTask(int idxWorker, int* task);
+
+//Members:
+public:
+	//Flag to indicate if the detection and description are based on LUTs (true) or functions (false).
+	bool m_LUT;
+	//Flag to indicate if the correspondences of each frame are used as motion prior of the next one.
+	bool m_motionPriorGrid;
+private:
+	//Engine, image size and origin, maximum number of singular points and length of the descriptors.
+	FFMEEngine* m_engine;
+	int m_width;
+	int m_height;
+	int m_origin;
+	int m_maxNoKeyPoints;
+	int m_lengthDesc;
+
+	/*Streams*/
+	int m_maxNoStreams;
+	volatile long m_noStreams;
+	//Number of slots of each stream (frames in flight plus the previous frame of the matching).
+	int m_noSlots;
+	FFMEStream* m_streams;
+	FFMEMutex m_mutexStreams;
+
+	/*Workers*/
+	int m_noWorkers;
+	FFMEThread* m_threads;
+	FFMEWorker* m_workers;
+	//Workspace of the detection and description of each worker.
+	FFME* m_ffmeWorkers;
+	//Queue of tasks of each worker (circular buffer, with the number of extractions and insertions) and its mutex.
+	int m_capTasks;
+	int** m_tasks;
+	int* m_headTasks;
+	int* m_tailTasks;
+	FFMEMutex* m_mutexTasks;
+	//Flag to stop the workers.
+	volatile long m_stop;
+	bool m_running;
+	//Number of stolen tasks.
+	volatile long m_noStolen;
+};
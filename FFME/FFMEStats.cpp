@@ -0,0 +1,107 @@
+//-------------------------------------------------------------------------
+// FFMEStats.cpp
+//-------------------------------------------------------------------------
+// Description: built-in instrumentation of the FFME class.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "FFMEStats.h"
+#include <stdlib.h>
+
+
+//Comparison of two floats (ascending order) for 'qsort()'.
+static int compareFloat(const void* a, const void* b)
+{
+	float fa = *(const float*)a;
+	float fb = *(const float*)b;
+	return (fa > fb) - (fa < fb);
+}
+
+
+FFMEStats::FFMEStats(void)
+{
+	resetStats();
+}
+
+FFMEStats::~FFMEStats(void)
+{
+}
+
+
+/* Reset of all the timings and counters.
+   Inputs: --
+   Outputs: --
+*/
+void FFMEStats::resetStats()
+{
+	int i;
+
+	for(i=0;i<NO_STATS_STAGES;i++)
+	{
+		m_lastTime[i] = 0;
+		m_totalTime[i] = 0;
+		m_noCalls[i] = 0;
+	}
+	for(i=0;i<NO_FUNNEL_STAGES;i++)
+	{
+		m_funnel[i] = 0;
+		m_totalFunnel[i] = 0;
+		m_noFunnel[i] = 0;
+	}
+}
+
+
+/* Record of the time of a call of a stage. The time is stored in the rolling window over the oldest call.
+   Inputs:
+   -stage: stage (STATS_XXX).
+   -ticks: time of the call (ticks of 'cvGetTickCount()').
+   Outputs: --
+*/
+void FFMEStats::addTime(int stage, double ticks)
+{
+	double time = ticks / (cvGetTickFrequency() * 1000.);
+
+	m_lastTime[stage] = time;
+	m_totalTime[stage] += time;
+	m_window[stage][m_noCalls[stage] % NO_SAMPLES_STATS] = (float)time;
+	m_noCalls[stage]++;
+}
+
+
+/* Record of the number of points that reach a stage of the funnel.
+   Inputs:
+   -stage: stage of the funnel (FUNNEL_XXX).
+   -noPtos: number of points.
+   Outputs: --
+*/
+void FFMEStats::setFunnel(int stage, int noPtos)
+{
+	m_funnel[stage] = noPtos;
+	m_totalFunnel[stage] += noPtos;
+	m_noFunnel[stage]++;
+}
+
+
+/* Percentile of the time per call of a stage over the last NO_SAMPLES_STATS calls (or all of them if there are less).
+   The window is copied and sorted, so the function is intended for queries, not for every frame.
+   Inputs:
+   -stage: stage (STATS_XXX).
+   -percentile: percentile between 0 (minimum) and 100 (maximum). The nearest sample is returned.
+   Outputs: time (ms), or 0 if the stage has not been called.
+*/
+double FFMEStats::getPercentile(int stage, float percentile)
+{
+	float sorted[NO_SAMPLES_STATS];
+	int noSamples = MIN(m_noCalls[stage], NO_SAMPLES_STATS);
+
+	if(noSamples == 0)
+	{
+		return 0;
+	}
+	memcpy(sorted, m_window[stage], noSamples * sizeof(float));
+	qsort(sorted, noSamples, sizeof(float), compareFloat);
+	percentile = MIN(MAX(percentile, 0.f), 100.f);
+	return sorted[cvRound(percentile / 100.f * (noSamples - 1))];
+}
@@ -0,0 +1,140 @@
+//-------------------------------------------------------------------------
+// FFMEStats.h
+//-------------------------------------------------------------------------
+// Description: built-in instrumentation of the FFME class. Each object
+// records the time of every call of the stages of the detection, the
+// description and the matching (last time, average and percentiles of a
+// rolling window of calls), and the number of points that survive each
+// stage of the funnel (gradient, cornerness, non-minimal supression,
+// description, matching and restrictions). The instrumentation is
+// compiled out, without any cost, if FFME_NO_STATS is defined in the
+// project.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+
+
+//********************************************Parameters******************************************
+#define NO_SAMPLES_STATS 128 //Number of calls of the rolling window used by the percentiles.
+//************************************************************************************************
+
+
+//Instrumentation switch. It changes the layout of the FFME class, so it must be the same in the library and in all the
+//projects that use it.
+#ifndef FFME_NO_STATS
+#define FFME_STATS
+#endif
+
+//Timed stages.
+#define STATS_GRADIENT 0 //Gradient (decimation and flat region pre-rejection included).
+#define STATS_GRAD_MAG 1 //Gradient magnitude.
+#define STATS_GRAD_MAG_THRESH 2 //Gradient magnitude restriction.
+#define STATS_CORNER_THRESH 3 //Cornerness restriction.
+#define STATS_NON_MIN_SUP 4 //Non-minimal supression.
+#define STATS_DETECTION 5 //Whole detection.
+#define STATS_GRAD_PHASE 6 //Gradient phase.
+#define STATS_ORIENT_HIST 7 //Orientation histograms and normalization of all the points.
+#define STATS_DESCRIPTION 8 //Whole description.
+#define STATS_MATCHING 9 //Whole matching.
+#define NO_STATS_STAGES 10
+
+//Stages of the funnel of points.
+#define FUNNEL_GRADIENT 0 //Candidates of the gradient magnitude restriction.
+#define FUNNEL_CORNERNESS 1 //Candidates of the cornerness restriction.
+#define FUNNEL_NON_MIN_SUP 2 //Singular points.
+#define FUNNEL_DESCRIBED 3 //Described points.
+#define FUNNEL_MATCHED 4 //Points of the first image with at least one candidate in the search window.
+#define FUNNEL_ACCEPTED 5 //Correspondences that fulfill the matching restrictions.
+#define NO_FUNNEL_STAGES 6
+
+
+//Macros used inside the FFME functions (they use the member 'm_stats'). Without FFME_STATS they are empty.
+#ifdef FFME_STATS
+//Start of a timing (declaration of the tick counter 'ticks').
+#define STATS_START_M(ticks) double ticks = (double)cvGetTickCount()
+//Time of a stage since the last start or lap, and restart of the tick counter.
+#define STATS_LAP_M(stage, ticks) \
+	{ \
+		double ticksLap = (double)cvGetTickCount(); \
+		m_stats.addTime(stage, ticksLap - (ticks)); \
+		ticks = ticksLap; \
+	}
+//Time of a stage since the start.
+#define STATS_STOP_M(stage, ticks) m_stats.addTime(stage, (double)cvGetTickCount() - (ticks))
+//Number of points that reach a stage of the funnel.
+#define STATS_FUNNEL_M(stage, noPtos) m_stats.setFunnel(stage, noPtos)
+//Code only used by the instrumentation.
+#define STATS_CODE_M(code) code
+#else
+#define STATS_START_M(ticks)
+#define STATS_LAP_M(stage, ticks)
+#define STATS_STOP_M(stage, ticks)
+#define STATS_FUNNEL_M(stage, noPtos)
+#define STATS_CODE_M(code)
+#endif
+
+
+class FFMEStats
+{
+//Methods:
+public:
+	FFMEStats(void);
+	~FFMEStats(void);
+	//Reset of all the timings and counters.
+	void resetStats();
+	//Record of the time of a call of a stage.
+	void addTime(int stage, double ticks);
+	//Record of the number of points that reach a stage of the funnel.
+	void setFunnel(int stage, int noPtos);
+	//Percentile of the time per call of a stage over the last NO_SAMPLES_STATS calls (ms).
+	double getPercentile(int stage, float percentile);
+
+	//--get functions--//
+	//Get the time of the last call of a stage (ms).
+	double getLastTime(int stage)
+	{
+		return m_lastTime[stage];
+	}
+
+	//Get the average time per call of a stage since the last reset (ms).
+	double getAvgTime(int stage)
+	{
+		return (m_noCalls[stage] > 0)? m_totalTime[stage] / m_noCalls[stage] : 0;
+	}
+
+	//Get the number of calls of a stage since the last reset.
+	int getNoCalls(int stage)
+	{
+		return m_noCalls[stage];
+	}
+
+	//Get the number of points of the last call that reached a stage of the funnel.
+	int getFunnel(int stage)
+	{
+		return m_funnel[stage];
+	}
+
+	//Get the average number of points per call that reached a stage of the funnel since the last reset.
+	double getAvgFunnel(int stage)
+	{
+		return (m_noFunnel[stage] > 0)? m_totalFunnel[stage] / m_noFunnel[stage] : 0;
+	}
+
+//Members:
+private:
+	/*Timings (ms)*/
+	double m_lastTime[NO_STATS_STAGES];
+	double m_totalTime[NO_STATS_STAGES];
+	int m_noCalls[NO_STATS_STAGES];
+	float m_window[NO_STATS_STAGES][NO_SAMPLES_STATS]; //Rolling window of the last calls (circular buffer).
+
+	/*Funnel*/
+	int m_funnel[NO_FUNNEL_STAGES];
+	double m_totalFunnel[NO_FUNNEL_STAGES];
+	int m_noFunnel[NO_FUNNEL_STAGES];
+};
@@ -0,0 +1,311 @@
+//-------------------------------------------------------------------------
+// FFMEThreads.cpp
+//-------------------------------------------------------------------------
+// Description: minimal portability layer for threads (Win32 and POSIX
+// threads) and single producer/single consumer lock-free queue.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "FFMEThreads.h"
+#include "cv.h"
+
+
+/* Creation of a thread.
+   Inputs:
+   -thread: (input/output) created thread.
+   -func: function executed by the thread. It must be declared with the FFME_THREAD_FUNC macro.
+   -arg: argument of the function.
+   Outputs: false if the thread can not be created.
+*/
+bool createThread(FFMEThread* thread, FFMEThreadFunc func, void* arg)
+{
+#ifdef _WIN32
+	*thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+	return *thread != NULL;
+#else
+	return pthread_create(thread, NULL, func, arg) == 0;
+#endif
+}
+
+
+/* Wait for the end of a thread and release of its resources.
+   Inputs:
+   -thread: thread.
+   Outputs: --
+*/
+void joinThread(FFMEThread* thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(*thread, INFINITE);
+	CloseHandle(*thread);
+#else
+	pthread_join(*thread, NULL);
+#endif
+}
+
+
+/* Yield of the processor to other threads.
+   Inputs: --
+   Outputs: --
+*/
+void yieldThread()
+{
+#ifdef _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+
+/* Sleep of the calling thread.
+   Inputs:
+   -ms: time in milliseconds.
+   Outputs: --
+*/
+void sleepThread(int ms)
+{
+#ifdef _WIN32
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+
+/* Wait step of a thread polling a condition. The first calls yield the processor, so short waits have low latency, and
+   the next ones sleep, so long waits do not consume processor time.
+   Inputs:
+   -noSpins: (input/output) number of consecutive calls. It must be reset to zero when the condition is fulfilled.
+   Outputs: --
+*/
+void waitThread(int* noSpins)
+{
+	if(*noSpins < NO_SPINS_WAIT_THREAD)
+	{
+		yieldThread();
+		(*noSpins)++;
+	}
+	else
+	{
+		sleepThread(1);
+	}
+}
+
+
+/* Number of processors of the system.
+   Inputs: --
+   Outputs: number of processors (at least one).
+*/
+int getNoProcessors()
+{
+	int noProcs;
+
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	noProcs = (int)info.dwNumberOfProcessors;
+#else
+	noProcs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return (noProcs > 0) ? noProcs : 1;
+}
+
+
+/* Initialization of a mutex.
+   Inputs:
+   -mutex: (input/output) mutex.
+   Outputs: --
+*/
+void iniMutex(FFMEMutex* mutex)
+{
+#ifdef _WIN32
+	InitializeCriticalSection(mutex);
+#else
+	pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+
+/* Release of a mutex.
+   Inputs:
+   -mutex: (input/output) mutex.
+   Outputs: --
+*/
+void releaseMutex(FFMEMutex* mutex)
+{
+#ifdef _WIN32
+	DeleteCriticalSection(mutex);
+#else
+	pthread_mutex_destroy(mutex);
+#endif
+}
+
+
+/* Lock of a mutex.
+   Inputs:
+   -mutex: (input/output) mutex.
+   Outputs: --
+*/
+void lockMutex(FFMEMutex* mutex)
+{
+#ifdef _WIN32
+	EnterCriticalSection(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
+
+
+/* Unlock of a mutex.
+   Inputs:
+   -mutex: (input/output) mutex.
+   Outputs: --
+*/
+void unlockMutex(FFMEMutex* mutex)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
+
+
+/* Atomic increment.
+   Inputs:
+   -value: (input/output) value.
+   Outputs: incremented value.
+*/
+long atomicIncrement(volatile long* value)
+{
+#ifdef _WIN32
+	return InterlockedIncrement(value);
+#else
+	return __sync_add_and_fetch(value, 1);
+#endif
+}
+
+
+/* Atomic decrement.
+   Inputs:
+   -value: (input/output) value.
+   Outputs: decremented value.
+*/
+long atomicDecrement(volatile long* value)
+{
+#ifdef _WIN32
+	return InterlockedDecrement(value);
+#else
+	return __sync_sub_and_fetch(value, 1);
+#endif
+}
+
+
+/* Atomic compare-exchange: the value is replaced by 'exchange' only if it is equal to 'comparand'.
+   Inputs:
+   -value: (input/output) value.
+   -exchange: new value.
+   -comparand: expected value.
+   Outputs: initial value (the exchange has been done if it is equal to 'comparand').
+*/
+long atomicCompareExchange(volatile long* value, long exchange, long comparand)
+{
+#ifdef _WIN32
+	return InterlockedCompareExchange(value, exchange, comparand);
+#else
+	return __sync_val_compare_and_swap(value, comparand, exchange);
+#endif
+}
+
+
+/* Full memory barrier: the memory operations before the barrier are visible to other threads before the ones after it.
+   Inputs: --
+   Outputs: --
+*/
+void memoryBarrier()
+{
+#ifdef _WIN32
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+}
+
+
+FFMEQueue::FFMEQueue(void)
+{
+	m_buffer = 0;
+	m_mask = 0;
+	m_head = 0;
+	m_tail = 0;
+}
+
+FFMEQueue::~FFMEQueue(void)
+{
+	cvFree(&m_buffer);
+}
+
+
+/* Initialization of memory.
+   Inputs:
+   -capacity: minimum capacity of the queue. It is rounded up to a power of two.
+   Outputs: --
+*/
+void FFMEQueue::iniQueue(int capacity)
+{
+	unsigned long size = 1;
+
+	while(size < (unsigned long)capacity)
+	{
+		size <<= 1;
+	}
+	cvFree(&m_buffer);
+	m_buffer = (int*)cvAlloc(size * sizeof(int));
+	m_mask = size - 1;
+	m_head = 0;
+	m_tail = 0;
+}
+
+
+/* Insertion at the end of the queue. Only one thread can insert elements.
+   Inputs:
+   -value: element.
+   Outputs: false if the queue is full.
+*/
+bool FFMEQueue::push(int value)
+{
+	unsigned long tail = m_tail;
+
+	if(tail - m_head > m_mask)
+	{
+		return false;
+	}
+	m_buffer[tail & m_mask] = value;
+	memoryBarrier(); //The element is written before it is published.
+	m_tail = tail + 1;
+	return true;
+}
+
+
+/* Extraction from the beginning of the queue. Only one thread can extract elements.
+   Inputs:
+   -value: (input/output) element.
+   Outputs: false if the queue is empty.
+*/
+bool FFMEQueue::pop(int* value)
+{
+	unsigned long head = m_head;
+
+	if(head == m_tail)
+	{
+		return false;
+	}
+	memoryBarrier(); //The element is read after its publication is seen.
+	*value = m_buffer[head & m_mask];
+	memoryBarrier(); //The element is read before its position is released.
+	m_head = head + 1;
+	return true;
+}
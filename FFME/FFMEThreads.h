@@ -0,0 +1,100 @@
+//-------------------------------------------------------------------------
+// FFMEThreads.h
+//-------------------------------------------------------------------------
+// Description: minimal portability layer for threads (Win32 and POSIX
+// threads): creation and join of threads, mutexes, atomic operations,
+// memory barriers, and a bounded lock-free queue with a single producer
+// and a single consumer, used to connect the stages of the video
+// processing.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+
+//********************************************Parameters******************************************
+#define NO_SPINS_WAIT_THREAD 64 //Number of yields of a waiting thread before it starts sleeping.
+//************************************************************************************************
+
+
+//Thread, thread function and mutex types.
+#ifdef _WIN32
+typedef HANDLE FFMEThread;
+typedef DWORD (WINAPI *FFMEThreadFunc)(void*);
+typedef CRITICAL_SECTION FFMEMutex;
+#define FFME_THREAD_FUNC(name) DWORD WINAPI name(void* arg)
+#else
+typedef pthread_t FFMEThread;
+typedef void* (*FFMEThreadFunc)(void*);
+typedef pthread_mutex_t FFMEMutex;
+#define FFME_THREAD_FUNC(name) void* name(void* arg)
+#endif
+
+
+//Creation of a thread. Returns false if the thread can not be created.
+bool createThread(FFMEThread* thread, FFMEThreadFunc func, void* arg);
+//Wait for the end of a thread and release of its resources.
+void joinThread(FFMEThread* thread);
+//Yield of the processor to other threads.
+void yieldThread();
+//Sleep of the calling thread.
+void sleepThread(int ms);
+//Wait step of a thread polling a condition: yields first, and sleeps after NO_SPINS_WAIT_THREAD calls.
+void waitThread(int* noSpins);
+//Number of processors of the system.
+int getNoProcessors();
+
+//Mutexes.
+void iniMutex(FFMEMutex* mutex);
+void releaseMutex(FFMEMutex* mutex);
+void lockMutex(FFMEMutex* mutex);
+void unlockMutex(FFMEMutex* mutex);
+
+//Atomic operations. They return the new value, except the compare-exchange, which returns the initial value.
+long atomicIncrement(volatile long* value);
+long atomicDecrement(volatile long* value);
+long atomicCompareExchange(volatile long* value, long exchange, long comparand);
+//Full memory barrier.
+void memoryBarrier();
+
+
+//Bounded lock-free queue of integers (e.g. indices of frame buffers) with a single producer thread and a single
+//consumer thread. No operation blocks: they fail when the queue is full or empty.
+class FFMEQueue
+{
+//Methods:
+public:
+	FFMEQueue(void);
+	~FFMEQueue(void);
+	//Initialization of memory. The capacity is rounded up to a power of two.
+	void iniQueue(int capacity);
+	//Insertion at the end of the queue (producer). Returns false if the queue is full.
+	bool push(int value);
+	//Extraction from the beginning of the queue (consumer). Returns false if the queue is empty.
+	bool pop(int* value);
+
+	//--get and set functions--//
+	//Get the number of elements of the queue (approximate if the queue is being used).
+	int getSize()
+	{
+		return (int)(m_tail - m_head);
+	}
+
+//Members:
+private:
+	//Circular buffer and mask of the indices (capacity - 1).
+	int* m_buffer;
+	unsigned long m_mask;
+	//Number of extractions (written only by the consumer) and number of insertions (written only by the producer).
+	volatile unsigned long m_head;
+	volatile unsigned long m_tail;
+};
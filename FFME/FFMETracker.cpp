@@ -0,0 +1,462 @@
+//-------------------------------------------------------------------------
+// FFMETracker.cpp
+//-------------------------------------------------------------------------
+// Description: persistent feature tracker built on top of the FFME class.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "FFMETracker.h"
+
+
+//Growth of a buffer keeping its content: a new buffer of 'newSize' bytes is reserved, the 'oldSize' bytes of the
+//old buffer are copied and the old buffer is released.
+static void* growBuffer(void* buffer, int oldSize, int newSize)
+{
+	void* newBuffer = cvAlloc(newSize);
+	memcpy(newBuffer, buffer, oldSize);
+	cvFree(&buffer);
+	return newBuffer;
+}
+
+
+FFMETracker::FFMETracker(void)
+{
+	m_ffme = 0;
+	m_maxNoTracks = 0;
+	m_noTracks = 0;
+	m_noBirths = 0;
+	m_noDeaths = 0;
+	m_noSkippedDesc = 0;
+	m_noFrames = 0;
+	m_nextId = 0;
+}
+
+FFMETracker::~FFMETracker(void)
+{
+	int i;
+
+	if(m_ffme == 0)
+	{
+		return;
+	}
+
+	//Release memory.
+	for(i=0;i<m_maxNoTracks;i++)
+	{
+		cvFree(m_descTracks+i);
+		cvFree(m_descriptors+i);
+	}
+	cvFree(&m_descTracks);
+	cvFree(&m_descriptors);
+	cvFree(&m_ptosTracks);
+	cvFree(&m_prevPtosTracks);
+	cvFree(&m_idTracks);
+	cvFree(&m_ageTracks);
+	cvFree(&m_singPtos);
+	cvFree(&m_prevSingPtos);
+	cvFree(&m_idSingPtos);
+	cvFree(&m_ageSingPtos);
+	cvFree(&m_idxCorr);
+	cvFree(&m_idxTrack);
+	cvFree(&m_idDeaths);
+	cvFree(&m_ptosDeaths);
+	cvFree(&m_ageDeaths);
+	cvFree(&m_ptosDesc);
+	cvFree(&m_descDesc);
+	cvFree(&m_idxDesc);
+	cvFree(&m_ptosMatch);
+	cvFree(&m_descMatch);
+	cvFree(&m_idxMatch);
+	cvFree(&m_idxCorrMatch);
+}
+
+
+/* Initialization of memory. The maximum number of tracks is the maximum number of keypoints of the FFME object.
+   Inputs:
+   -ffme: motion estimation object used for the detection, description and matching. It must be already initialized
+    and it is not owned by the tracker.
+   Outputs: --
+*/
+void FFMETracker::iniTracker(FFME* ffme)
+{
+	int i;
+
+	m_ffme = ffme;
+	m_maxNoTracks = ffme->m_maxNoKeyPoints;
+	m_lengthDesc = ffme->m_widthArrayHist*ffme->m_widthArrayHist*ffme->m_noBinsOriHist;
+	m_ageStableDesc = AGE_STABLE_DESC_TRACK;
+	m_periodRefreshDesc = PERIOD_REFRESH_DESC_TRACK;
+	m_radStableTrack = (float)RAD_STABLE_TRACK;
+	m_noTracks = 0;
+	m_noBirths = 0;
+	m_noDeaths = 0;
+	m_noSkippedDesc = 0;
+	m_noFrames = 0;
+	m_nextId = 0;
+
+	//Tracks and features of the new frame.
+	m_ptosTracks = (CvPoint2D32f*)cvAlloc(m_maxNoTracks * sizeof(CvPoint2D32f));
+	m_prevPtosTracks = (CvPoint2D32f*)cvAlloc(m_maxNoTracks * sizeof(CvPoint2D32f));
+	m_idTracks = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+	m_ageTracks = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+	m_singPtos = (CvPoint2D32f*)cvAlloc(m_maxNoTracks * sizeof(CvPoint2D32f));
+	m_prevSingPtos = (CvPoint2D32f*)cvAlloc(m_maxNoTracks * sizeof(CvPoint2D32f));
+	m_idSingPtos = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+	m_ageSingPtos = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+	m_descTracks = (float**)cvAlloc(m_maxNoTracks * sizeof(float*));
+	m_descriptors = (float**)cvAlloc(m_maxNoTracks * sizeof(float*));
+	for(i=0;i<m_maxNoTracks;i++)
+	{
+		m_descTracks[i] = (float*)cvAlloc(m_lengthDesc * sizeof(float));
+		m_descriptors[i] = (float*)cvAlloc(m_lengthDesc * sizeof(float));
+	}
+
+	//Association buffers.
+	m_idxCorr = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+	m_idxTrack = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+	m_ptosDesc = (CvPoint2D32f*)cvAlloc(m_maxNoTracks * sizeof(CvPoint2D32f));
+	m_descDesc = (float**)cvAlloc(m_maxNoTracks * sizeof(float*));
+	m_idxDesc = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+	m_ptosMatch = (CvPoint2D32f*)cvAlloc(m_maxNoTracks * sizeof(CvPoint2D32f));
+	m_descMatch = (float**)cvAlloc(m_maxNoTracks * sizeof(float*));
+	m_idxMatch = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+	m_idxCorrMatch = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+
+	//Dead tracks.
+	m_idDeaths = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+	m_ptosDeaths = (CvPoint2D32f*)cvAlloc(m_maxNoTracks * sizeof(CvPoint2D32f));
+	m_ageDeaths = (int*)cvAlloc(m_maxNoTracks * sizeof(int));
+}
+
+
+/* Growth of the memory of the tracker to a new maximum number of tracks, keeping the current tracks. It is needed if
+   the maximum number of keypoints of the FFME object is increased after the initialization (see 'reconfigureFFME()'),
+   since the detection writes up to that number of points.
+   Inputs:
+   -maxNoTracks: new maximum number of tracks. Nothing is done if it is not greater than the current one.
+   Outputs: --
+*/
+void FFMETracker::reserveTracks(int maxNoTracks)
+{
+	int i;
+	int old = m_maxNoTracks;
+
+	if(maxNoTracks <= old)
+	{
+		return;
+	}
+
+	//Tracks and features of the new frame.
+	m_ptosTracks = (CvPoint2D32f*)growBuffer(m_ptosTracks, old * sizeof(CvPoint2D32f), maxNoTracks * sizeof(CvPoint2D32f));
+	m_prevPtosTracks = (CvPoint2D32f*)growBuffer(m_prevPtosTracks, old * sizeof(CvPoint2D32f), maxNoTracks * sizeof(CvPoint2D32f));
+	m_idTracks = (int*)growBuffer(m_idTracks, old * sizeof(int), maxNoTracks * sizeof(int));
+	m_ageTracks = (int*)growBuffer(m_ageTracks, old * sizeof(int), maxNoTracks * sizeof(int));
+	m_singPtos = (CvPoint2D32f*)growBuffer(m_singPtos, old * sizeof(CvPoint2D32f), maxNoTracks * sizeof(CvPoint2D32f));
+	m_prevSingPtos = (CvPoint2D32f*)growBuffer(m_prevSingPtos, old * sizeof(CvPoint2D32f), maxNoTracks * sizeof(CvPoint2D32f));
+	m_idSingPtos = (int*)growBuffer(m_idSingPtos, old * sizeof(int), maxNoTracks * sizeof(int));
+	m_ageSingPtos = (int*)growBuffer(m_ageSingPtos, old * sizeof(int), maxNoTracks * sizeof(int));
+	//The descriptors are exchanged by pointer between both arrays, so the existing ones are kept.
+	m_descTracks = (float**)growBuffer(m_descTracks, old * sizeof(float*), maxNoTracks * sizeof(float*));
+	m_descriptors = (float**)growBuffer(m_descriptors, old * sizeof(float*), maxNoTracks * sizeof(float*));
+	for(i=old;i<maxNoTracks;i++)
+	{
+		m_descTracks[i] = (float*)cvAlloc(m_lengthDesc * sizeof(float));
+		m_descriptors[i] = (float*)cvAlloc(m_lengthDesc * sizeof(float));
+	}
+
+	//Association buffers (only used inside a frame).
+	cvFree(&m_idxCorr);
+	cvFree(&m_idxTrack);
+	cvFree(&m_ptosDesc);
+	cvFree(&m_descDesc);
+	cvFree(&m_idxDesc);
+	cvFree(&m_ptosMatch);
+	cvFree(&m_descMatch);
+	cvFree(&m_idxMatch);
+	cvFree(&m_idxCorrMatch);
+	m_idxCorr = (int*)cvAlloc(maxNoTracks * sizeof(int));
+	m_idxTrack = (int*)cvAlloc(maxNoTracks * sizeof(int));
+	m_ptosDesc = (CvPoint2D32f*)cvAlloc(maxNoTracks * sizeof(CvPoint2D32f));
+	m_descDesc = (float**)cvAlloc(maxNoTracks * sizeof(float*));
+	m_idxDesc = (int*)cvAlloc(maxNoTracks * sizeof(int));
+	m_ptosMatch = (CvPoint2D32f*)cvAlloc(maxNoTracks * sizeof(CvPoint2D32f));
+	m_descMatch = (float**)cvAlloc(maxNoTracks * sizeof(float*));
+	m_idxMatch = (int*)cvAlloc(maxNoTracks * sizeof(int));
+	m_idxCorrMatch = (int*)cvAlloc(maxNoTracks * sizeof(int));
+
+	//Dead tracks (the ones of the last frame are kept).
+	m_idDeaths = (int*)growBuffer(m_idDeaths, old * sizeof(int), maxNoTracks * sizeof(int));
+	m_ptosDeaths = (CvPoint2D32f*)growBuffer(m_ptosDeaths, old * sizeof(CvPoint2D32f), maxNoTracks * sizeof(CvPoint2D32f));
+	m_ageDeaths = (int*)growBuffer(m_ageDeaths, old * sizeof(int), maxNoTracks * sizeof(int));
+
+	m_maxNoTracks = maxNoTracks;
+}
+
+
+/* Processing of a new frame. The singular points of the frame are detected and described, and they are matched with
+   the current tracks. Each track with a reliable correspondence is continued (its age is increased), the rest of tracks
+   die, and the points without track give birth to new tracks. If two tracks correspond to the same point, only the
+   first one is continued.
+   The descriptor of a track is replaced by the one of the new frame, except for stable tracks (age greater or equal
+   than 'm_ageStableDesc'), which keep their descriptor and only refresh it every 'm_periodRefreshDesc' frames. This
+   limits the drift of long tracks, and the descriptors are exchanged by pointer, so no copies are done. Since the
+   descriptor of the new frame is not used by a stable track, a stable track is first associated geometrically (see
+   'describeFrame()'), and its point is not described. If the maximum number of keypoints of the FFME object has been
+   increased, the memory of the tracker grows first (see 'reserveTracks()').
+   Inputs:
+   -img_U81C: unsigned 8 bit input image.
+   -LUT: flag to indicate if the detection and description are based on LUTs (true) or functions (false).
+   Outputs: --
+*/
+void FFMETracker::trackFrame(IplImage* img_U81C, bool LUT)
+{
+	reserveTracks(m_ffme->m_maxNoKeyPoints);
+
+	//Singular point detection and description.
+	if(LUT)
+	{
+		m_ffme->singPtoDetLut(img_U81C, m_singPtos, &m_noSingPtos);
+	}
+	else
+	{
+		m_ffme->singPtoDetFunc(img_U81C, m_singPtos, &m_noSingPtos);
+	}
+	describeFrame(LUT);
+
+	updateTracks();
+}
+
+
+/* Processing of a new frame given as a luma view (e.g. the Y plane of a capture buffer). The view is processed in
+   place. See the other version of the function.
+   Inputs:
+   -luma: view of the unsigned 8 bit luma plane.
+   -LUT: flag to indicate if the detection and description are based on LUTs (true) or functions (false).
+   Outputs: --
+*/
+void FFMETracker::trackFrame(FFMELumaView* luma, bool LUT)
+{
+	reserveTracks(m_ffme->m_maxNoKeyPoints);
+
+	//Singular point detection and description.
+	if(LUT)
+	{
+		m_ffme->singPtoDetLut(luma, m_singPtos, &m_noSingPtos);
+	}
+	else
+	{
+		m_ffme->singPtoDetFunc(luma, m_singPtos, &m_noSingPtos);
+	}
+	describeFrame(LUT);
+
+	updateTracks();
+}
+
+
+/* Geometric association of the stable tracks and description of the rest of points of the new frame (already
+   detected). The location of each stable track (see 'stableDesc()') in the new frame is predicted with constant
+   velocity, and if only one point of the new frame is inside the radius 'm_radStableTrack' around it, the point 
+   continues the track. These points are not described, since the track keeps its own descriptor; the rest of points
+   are described and stored in the compact list of points associated by descriptor. The points of the new frame are
+   in raster order (as given by the detection functions), so the candidates of each track are searched by rows.
+   Inputs:
+   -LUT: flag to indicate if the description is based on LUTs (true) or functions (false).
+   Outputs: --
+*/
+void FFMETracker::describeFrame(bool LUT)
+{
+	int j, k, j0, j1, jBest, noInside;
+	float xPred, yPred, dx, dy;
+	float radSq = m_radStableTrack * m_radStableTrack;
+
+	for(j=0;j<m_noSingPtos;j++)
+	{
+		m_idxTrack[j] = -1;
+	}
+	for(k=0;k<m_noTracks;k++)
+	{
+		m_idxCorr[k] = -1;
+	}
+
+	//Geometric association of the stable tracks.
+	m_noSkippedDesc = 0;
+	for(k=0;k<m_noTracks && m_radStableTrack > 0;k++)
+	{
+		if(!stableDesc(k))
+		{
+			continue;
+		}
+
+		//Constant velocity prediction.
+		xPred = 2*m_ptosTracks[k].x - m_prevPtosTracks[k].x;
+		yPred = 2*m_ptosTracks[k].y - m_prevPtosTracks[k].y;
+
+		//First point whose row is inside the radius (binary search).
+		j0 = 0;
+		j1 = m_noSingPtos;
+		while(j0 < j1)
+		{
+			j = (j0 + j1) / 2;
+			if(m_singPtos[j].y < yPred - m_radStableTrack)
+			{
+				j0 = j + 1;
+			}
+			else
+			{
+				j1 = j;
+			}
+		}
+
+		//Points inside the radius.
+		noInside = 0;
+		jBest = -1;
+		for(j=j0;j<m_noSingPtos && m_singPtos[j].y <= yPred + m_radStableTrack;j++)
+		{
+			dx = m_singPtos[j].x - xPred;
+			dy = m_singPtos[j].y - yPred;
+			if(dx*dx + dy*dy <= radSq)
+			{
+				noInside++;
+				jBest = j;
+			}
+		}
+
+		//Only unambiguous associations with points that are not already taken.
+		if(noInside == 1 && m_idxTrack[jBest] == -1)
+		{
+			m_idxTrack[jBest] = k;
+			m_idxCorr[k] = jBest;
+			m_noSkippedDesc++;
+		}
+	}
+
+	//Description of the rest of points. The descriptors are written in the ones of the new frame.
+	m_noDesc = 0;
+	for(j=0;j<m_noSingPtos;j++)
+	{
+		if(m_idxTrack[j] == -1)
+		{
+			m_ptosDesc[m_noDesc] = m_singPtos[j];
+			m_descDesc[m_noDesc] = m_descriptors[j];
+			m_idxDesc[m_noDesc] = j;
+			m_noDesc++;
+		}
+	}
+	if(LUT)
+	{
+		m_ffme->singPtoDescLut(m_ptosDesc, m_noDesc, m_descDesc, true);
+	}
+	else
+	{
+		m_ffme->singPtoDescFunc(m_ptosDesc, m_noDesc, m_descDesc, true);
+	}
+}
+
+
+/* Association of the features of the new frame (see 'describeFrame()') with the tracks, and update of the tracks: 
+   continuations, deaths and births. The tracks that are not associated geometrically are matched with the described
+   points.
+   Inputs: --
+   Outputs: --
+*/
+void FFMETracker::updateTracks()
+{
+	int j, k, t, noMatch;
+	CvPoint2D32f* tmpPtos;
+	float** tmpDesc;
+	float* tmpVect;
+	int* tmpInt;
+
+	//Association by descriptor of the rest of tracks with the described points of the new frame.
+	noMatch = 0;
+	for(k=0;k<m_noTracks;k++)
+	{
+		if(m_idxCorr[k] == -1)
+		{
+			m_ptosMatch[noMatch] = m_ptosTracks[k];
+			m_descMatch[noMatch] = m_descTracks[k];
+			m_idxMatch[noMatch] = k;
+			noMatch++;
+		}
+	}
+	if(noMatch > 0 && m_noDesc > 0)
+	{
+		m_ffme->matchSingPtosIdx(m_ptosMatch, noMatch, m_descMatch, m_ptosDesc, m_noDesc, m_descDesc, m_idxCorrMatch);
+		for(t=0;t<noMatch;t++)
+		{
+			if(m_idxCorrMatch[t] != -1)
+			{
+				j = m_idxDesc[m_idxCorrMatch[t]];
+				k = m_idxMatch[t];
+				m_idxCorr[k] = j;
+				if(m_idxTrack[j] == -1)
+				{
+					m_idxTrack[j] = k;
+				}
+			}
+		}
+	}
+
+	//Deaths.
+	m_noDeaths = 0;
+	for(k=0;k<m_noTracks;k++)
+	{
+		j = m_idxCorr[k];
+		if(j == -1 || m_idxTrack[j] != k)
+		{
+			m_idDeaths[m_noDeaths] = m_idTracks[k];
+			m_ptosDeaths[m_noDeaths] = m_ptosTracks[k];
+			m_ageDeaths[m_noDeaths] = m_ageTracks[k];
+			m_noDeaths++;
+		}
+	}
+
+	//Continuations and births.
+	m_noBirths = 0;
+	for(j=0;j<m_noSingPtos;j++)
+	{
+		k = m_idxTrack[j];
+		if(k != -1)
+		{
+			m_idSingPtos[j] = m_idTracks[k];
+			m_ageSingPtos[j] = m_ageTracks[k] + 1;
+			m_prevSingPtos[j] = m_ptosTracks[k];
+
+			//Stable descriptor. The descriptor of the track is kept exchanging the pointers.
+			if(stableDesc(k))
+			{
+				tmpVect = m_descriptors[j];
+				m_descriptors[j] = m_descTracks[k];
+				m_descTracks[k] = tmpVect;
+			}
+		}
+		else
+		{
+			m_idSingPtos[j] = m_nextId++;
+			m_ageSingPtos[j] = 0;
+			m_prevSingPtos[j] = m_singPtos[j];
+			m_noBirths++;
+		}
+	}
+
+	//Update buffers. The features of the new frame become the current tracks.
+	tmpPtos = m_ptosTracks; //Exchange pointers.
+	m_ptosTracks = m_singPtos;
+	m_singPtos = tmpPtos;
+	tmpPtos = m_prevPtosTracks;
+	m_prevPtosTracks = m_prevSingPtos;
+	m_prevSingPtos = tmpPtos;
+	tmpDesc = m_descTracks;
+	m_descTracks = m_descriptors;
+	m_descriptors = tmpDesc;
+	tmpInt = m_idTracks;
+	m_idTracks = m_idSingPtos;
+	m_idSingPtos = tmpInt;
+	tmpInt = m_ageTracks;
+	m_ageTracks = m_ageSingPtos;
+	m_ageSingPtos = tmpInt;
+	m_noTracks = m_noSingPtos;
+	m_noFrames++;
+}
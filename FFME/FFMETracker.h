@@ -0,0 +1,184 @@
+//-------------------------------------------------------------------------
+// FFMETracker.h
+//-------------------------------------------------------------------------
+// Description: persistent feature tracker built on top of the FFME class.
+// It owns the features of the previous frame, and associates the singular
+// points of consecutive frames in tracks with a stable identifier. For
+// each frame, the births, deaths and continuations of the tracks are
+// available, so trajectories can be obtained without re-associating the
+// correspondences.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+
+//Motion estimation class.
+#include "FFME.h"
+
+
+//********************************************Parameters******************************************
+#define AGE_STABLE_DESC_TRACK 8 //Age (in frames) from which the descriptor of a track is considered stable.
+#define PERIOD_REFRESH_DESC_TRACK 8 //Period (in frames) of refresh of the stable descriptors.
+#define RAD_STABLE_TRACK 1.5 //Radius (in pixels) of the geometric association of the stable tracks. Zero disables it.
+//************************************************************************************************
+
+
+class FFMETracker
+{
+//Methods:
+public:
+	FFMETracker(void);
+	~FFMETracker(void);
+	//Initialization of memory. The FFME object must be already initialized.
+	void iniTracker(FFME* ffme);
+	//Processing of a new frame: detection, description, association with the tracks and update of the tracks.
+	void trackFrame(IplImage* img_U81C, bool LUT = true);
+	//Processing of a new frame given as a luma view (without copies).
+	void trackFrame(FFMELumaView* luma, bool LUT = true);
+	//Removal of all the tracks. The next frame starts new tracks.
+	void resetTracks()
+	{
+		m_noTracks = 0;
+		m_noBirths = 0;
+		m_noDeaths = 0;
+		m_noSkippedDesc = 0;
+		m_noFrames = 0;
+	}
+
+	//--get and set functions--//
+	//Set the descriptor refresh parameters.
+	void setDescParam(int ageStableDesc, int periodRefreshDesc)
+	{
+		m_ageStableDesc = ageStableDesc;
+		m_periodRefreshDesc = periodRefreshDesc;
+	}
+
+	//Set the radius of the geometric association of the stable tracks (zero disables it, so all the points are described).
+	void setStableTrackParam(float radStableTrack)
+	{
+		m_radStableTrack = radStableTrack;
+	}
+
+	//Get the current tracks: location in the current frame, location in the previous frame (only valid if the age is
+	//greater than zero), identifier and age (number of frames the track has been continued). Age zero means birth.
+	void getTracks(CvPoint2D32f** ptos, CvPoint2D32f** prevPtos, int** ids, int** ages, int* noTracks)
+	{
+		*ptos = m_ptosTracks;
+		*prevPtos = m_prevPtosTracks;
+		*ids = m_idTracks;
+		*ages = m_ageTracks;
+		*noTracks = m_noTracks;
+	}
+
+	//Get the descriptors of the current tracks.
+	void getDescTracks(float*** descriptors)
+	{
+		*descriptors = m_descTracks;
+	}
+
+	//Get the number of births, deaths and continuations of the last frame.
+	void getNoEvents(int* noBirths, int* noDeaths, int* noContinuations)
+	{
+		*noBirths = m_noBirths;
+		*noDeaths = m_noDeaths;
+		*noContinuations = m_noTracks - m_noBirths;
+	}
+
+	//Get the number of points of the last frame that were not described (continuations of stable tracks).
+	int getNoSkippedDesc()
+	{
+		return m_noSkippedDesc;
+	}
+
+	//Get the tracks that have died in the last frame: identifier, last location and age.
+	void getDeaths(int** ids, CvPoint2D32f** lastPtos, int** ages, int* noDeaths)
+	{
+		*ids = m_idDeaths;
+		*lastPtos = m_ptosDeaths;
+		*ages = m_ageDeaths;
+		*noDeaths = m_noDeaths;
+	}
+
+private:
+	//Growth of the memory of the tracker to a new maximum number of tracks, keeping the current tracks.
+	void reserveTracks(int maxNoTracks);
+	//Geometric association of the stable tracks and description of the rest of points of the new frame.
+	void describeFrame(bool LUT);
+	//Association of the features of the new frame with the tracks and update of the tracks.
+	void updateTracks();
+	//Check if the descriptor of a track is kept in the next frame (stable track out of its refresh frame).
+	bool stableDesc(int k)
+	{
+		return m_ageTracks[k] >= m_ageStableDesc &&
+			   (m_periodRefreshDesc <= 0 || ((m_ageTracks[k] + 1) % m_periodRefreshDesc) != 0);
+	}
+
+//Members:
+public:
+	//Age (in frames) from which the descriptor of a track is considered stable. The stable descriptors are not updated
+	//with the one of the new frame, unless the refresh period has expired.
+	int m_ageStableDesc;
+	//Period (in frames) of refresh of the stable descriptors.
+	int m_periodRefreshDesc;
+	//Radius (in pixels) of the geometric association of the stable tracks. A point of the new frame that is the only
+	//one inside the radius around the location predicted for a stable track (constant velocity) continues the track,
+	//and it is not described, since the track keeps its descriptor.
+	float m_radStableTrack;
+private:
+	//Motion estimation object (not owned).
+	FFME* m_ffme;
+	//Length of the descriptors.
+	int m_lengthDesc;
+	//Maximum number of tracks (maximum number of keypoints of the FFME object, see 'reserveTracks()').
+	int m_maxNoTracks;
+	//Number of processed frames.
+	int m_noFrames;
+	//Identifier of the next track.
+	int m_nextId;
+
+	/*Current tracks*/
+	CvPoint2D32f* m_ptosTracks;
+	CvPoint2D32f* m_prevPtosTracks;
+	float** m_descTracks;
+	int* m_idTracks;
+	int* m_ageTracks;
+	int m_noTracks;
+	//Number of tracks born in the last frame.
+	int m_noBirths;
+
+	/*Features of the new frame (and buffers for the update of the tracks)*/
+	CvPoint2D32f* m_singPtos;
+	CvPoint2D32f* m_prevSingPtos;
+	float** m_descriptors;
+	int* m_idSingPtos;
+	int* m_ageSingPtos;
+	int m_noSingPtos;
+	//Index of the corresponding point in the new frame of each track.
+	int* m_idxCorr;
+	//Index of the track associated to each point of the new frame.
+	int* m_idxTrack;
+	//Number of points of the new frame associated geometrically (not described).
+	int m_noSkippedDesc;
+
+	/*Points and tracks associated by descriptor (compact lists)*/
+	//Points of the new frame: location, descriptor and index in the new frame.
+	CvPoint2D32f* m_ptosDesc;
+	float** m_descDesc;
+	int* m_idxDesc;
+	int m_noDesc;
+	//Tracks: location, descriptor, index in the tracks and index of the correspondence in the compact list of points.
+	CvPoint2D32f* m_ptosMatch;
+	float** m_descMatch;
+	int* m_idxMatch;
+	int* m_idxCorrMatch;
+
+	/*Tracks that have died in the last frame*/
+	int* m_idDeaths;
+	CvPoint2D32f* m_ptosDeaths;
+	int* m_ageDeaths;
+	int m_noDeaths;
+};
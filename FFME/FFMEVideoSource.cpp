@@ -0,0 +1,256 @@
+//-------------------------------------------------------------------------
+// FFMEVideoSource.cpp
+//-------------------------------------------------------------------------
+// Description: asynchronous video ingest.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "FFMEVideoSource.h"
+
+
+FFMEVideoSource::FFMEVideoSource(void)
+{
+	m_capture = 0;
+	m_buffers = 0;
+	m_running = false;
+	m_timeDecode = 0;
+	iniMutex(&m_mutexStats);
+}
+
+FFMEVideoSource::~FFMEVideoSource(void)
+{
+	closeSource();
+	releaseMutex(&m_mutexStats);
+}
+
+
+/* Opening of a video file and start of the decode thread. All the buffers are allocated here. The first frame is
+   decoded before the return, to know the properties of the video.
+   Inputs:
+   -filename: name of the video file.
+   -noBuffers: number of decoded frames that can be stored ahead of the consumer.
+   Outputs: false if the file can not be opened.
+*/
+bool FFMEVideoSource::openSource(const char* filename, int noBuffers)
+{
+	int i;
+	IplImage* frame;
+
+	closeSource();
+
+	//Video file.
+	m_capture = cvCreateFileCapture(filename);
+	if(m_capture == 0)
+	{
+		return false;
+	}
+	frame = cvQueryFrame(m_capture);
+	if(frame == 0)
+	{
+		cvReleaseCapture(&m_capture);
+		return false;
+	}
+	m_width = frame->width;
+	m_height = frame->height;
+	m_origin = frame->origin;
+	m_fps = cvGetCaptureProperty(m_capture, CV_CAP_PROP_FPS);
+	m_noFramesVideo = (int)cvGetCaptureProperty(m_capture, CV_CAP_PROP_FRAME_COUNT);
+
+	//Ring of buffers.
+	m_noBuffers = noBuffers;
+	m_buffers = (IplImage**)cvAlloc(noBuffers * sizeof(IplImage*));
+	m_idxFrameBuffers = (int*)cvAlloc(noBuffers * sizeof(int));
+	for(i=0;i<noBuffers;i++)
+	{
+		m_buffers[i] = cvCreateImage(cvSize(m_width, m_height), IPL_DEPTH_8U, 1);
+		m_buffers[i]->origin = m_origin;
+	}
+	m_fullQueue.iniQueue(noBuffers);
+	m_freeQueue.iniQueue(noBuffers);
+	m_curBuffer = -1;
+
+	//The first frame is already decoded.
+	toLuma(frame, m_buffers[0]);
+	m_idxFrameBuffers[0] = 0;
+	m_fullQueue.push(0);
+	for(i=1;i<noBuffers;i++)
+	{
+		m_freeQueue.push(i);
+	}
+
+	//Statistics.
+	m_noDecoded = 1;
+	lockMutex(&m_mutexStats);
+	m_timeDecode = 0;
+	unlockMutex(&m_mutexStats);
+	m_noStalls = 0;
+	m_timeStall = 0;
+
+	//Decode thread.
+	m_stop = 0;
+	m_end = 0;
+	m_running = createThread(&m_thread, decodeThread, this);
+	if(!m_running)
+	{
+		m_end = 1;
+	}
+	return true;
+}
+
+
+/* End of the decode thread and closing of the video file. The buffers are released, so the last extracted frame is
+   not valid any more.
+   Inputs: --
+   Outputs: --
+*/
+void FFMEVideoSource::closeSource()
+{
+	int i;
+
+	if(m_running)
+	{
+		memoryBarrier();
+		m_stop = 1;
+		joinThread(&m_thread);
+		m_running = false;
+	}
+	if(m_capture != 0)
+	{
+		cvReleaseCapture(&m_capture);
+	}
+	if(m_buffers != 0)
+	{
+		for(i=0;i<m_noBuffers;i++)
+		{
+			cvReleaseImage(m_buffers+i);
+		}
+		cvFree(&m_buffers);
+		cvFree(&m_idxFrameBuffers);
+	}
+}
+
+
+/* Extraction of the next decoded frame. The previous extracted frame is recycled, so it is not valid any more. If the
+   decoder has not stored the next frame yet, the call waits for it, and the wait is accounted as a decode stall.
+   Inputs:
+   -img_U81C: (input/output) unsigned 8 bit luma image of the frame. It must not be modified.
+   -idxFrame: (input/output) index of the frame in the video.
+   Outputs: false at the end of the video.
+*/
+bool FFMEVideoSource::nextFrame(IplImage** img_U81C, int* idxFrame)
+{
+	int buffer, noSpins = 0;
+	long end;
+	double timeStall = 0;
+
+	if(m_buffers == 0)
+	{
+		return false;
+	}
+
+	//Recycle of the previous frame.
+	if(m_curBuffer != -1)
+	{
+		m_freeQueue.push(m_curBuffer);
+		m_curBuffer = -1;
+	}
+
+	while(true)
+	{
+		end = m_end;
+		memoryBarrier();
+		if(m_fullQueue.pop(&buffer))
+		{
+			break;
+		}
+		if(end)
+		{
+			return false;
+		}
+		if(timeStall == 0)
+		{
+			timeStall = (double)cvGetTickCount();
+			m_noStalls++;
+		}
+		waitThread(&noSpins);
+	}
+	if(timeStall != 0)
+	{
+		m_timeStall += (double)cvGetTickCount() - timeStall;
+	}
+
+	m_curBuffer = buffer;
+	*img_U81C = m_buffers[buffer];
+	*idxFrame = m_idxFrameBuffers[buffer];
+	return true;
+}
+
+
+/* Decode thread. It decodes frames while there are free buffers, and waits for the consumer otherwise. It ends at the
+   end of the video or when the source is closed.
+   Inputs:
+   -arg: video source.
+   Outputs: --
+*/
+FFME_THREAD_FUNC(FFMEVideoSource::decodeThread)
+{
+	FFMEVideoSource* source = (FFMEVideoSource*)arg;
+	int buffer, noSpins = 0;
+	double timeDecode;
+	IplImage* frame;
+
+	while(!source->m_stop)
+	{
+		if(!source->m_freeQueue.pop(&buffer))
+		{
+			waitThread(&noSpins);
+			continue;
+		}
+		noSpins = 0;
+
+		timeDecode = (double)cvGetTickCount();
+		frame = 0;
+		if(cvGrabFrame(source->m_capture))
+		{
+			frame = cvRetrieveFrame(source->m_capture);
+		}
+		if(frame == 0)
+		{
+			break;
+		}
+		source->toLuma(frame, source->m_buffers[buffer]);
+		timeDecode = (double)cvGetTickCount() - timeDecode;
+		lockMutex(&source->m_mutexStats);
+		source->m_timeDecode += timeDecode;
+		unlockMutex(&source->m_mutexStats);
+
+		source->m_idxFrameBuffers[buffer] = (int)source->m_noDecoded;
+		source->m_fullQueue.push(buffer);
+		atomicIncrement(&source->m_noDecoded);
+	}
+
+	memoryBarrier();
+	source->m_end = 1;
+	return 0;
+}
+
+
+/* Conversion of a decoded frame to luma.
+   Inputs:
+   -frame: decoded frame (BGR or gray).
+   -img_U81C: (input/output) unsigned 8 bit luma image.
+   Outputs: --
+*/
+void FFMEVideoSource::toLuma(IplImage* frame, IplImage* img_U81C)
+{
+	if(frame->nChannels == 1)
+	{
+		cvCopy(frame, img_U81C);
+	}
+	else
+	{
+		cvCvtColor(frame, img_U81C, CV_BGR2GRAY);
+	}
+}
@@ -0,0 +1,145 @@
+//-------------------------------------------------------------------------
+// FFMEVideoSource.h
+//-------------------------------------------------------------------------
+// Description: asynchronous video ingest. A decode thread grabs the
+// frames of a video file ahead of the consumer, converts them to luma and
+// stores them in a ring of buffers allocated once, so the motion
+// estimation of a frame does not wait on the decoder while the ring is
+// not empty. The buffers are recycled when the consumer requests the next
+// frame. The time the consumer waits for the decoder (decode stall) is
+// measured separately from the time of the decoding itself.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+#include "highgui.h"
+
+//Threads and queues.
+#include "FFMEThreads.h"
+
+
+//********************************************Parameters******************************************
+#define NO_BUFFERS_VIDEO_SOURCE 8 //Number of decoded frames that can be stored ahead of the consumer.
+//************************************************************************************************
+
+
+class FFMEVideoSource
+{
+//Methods:
+public:
+	FFMEVideoSource(void);
+	~FFMEVideoSource(void);
+	//Opening of a video file and start of the decode thread. Returns false if the file can not be opened.
+	bool openSource(const char* filename, int noBuffers = NO_BUFFERS_VIDEO_SOURCE);
+	//End of the decode thread and closing of the video file.
+	void closeSource();
+	//Extraction of the next decoded frame. Returns false at the end of the video.
+	bool nextFrame(IplImage** img_U81C, int* idxFrame);
+
+	//--get and set functions--//
+	//Get the frame width.
+	int getWidth()
+	{
+		return m_width;
+	}
+
+	//Get the frame height.
+	int getHeight()
+	{
+		return m_height;
+	}
+
+	//Get the frame origin (field of the OpenCV IplImage structure).
+	int getOrigin()
+	{
+		return m_origin;
+	}
+
+	//Get the frame rate of the video.
+	double getFps()
+	{
+		return m_fps;
+	}
+
+	//Get the number of frames of the video (as reported by the file).
+	int getNoFramesVideo()
+	{
+		return m_noFramesVideo;
+	}
+
+	//Get the number of decoded frames.
+	int getNoDecoded()
+	{
+		return (int)m_noDecoded;
+	}
+
+	//Get the number of times the consumer waited for the decoder.
+	int getNoStalls()
+	{
+		return m_noStalls;
+	}
+
+	//Get the total time (ms) the consumer waited for the decoder.
+	double getTimeStall()
+	{
+		return m_timeStall/(cvGetTickFrequency()*1000.);
+	}
+
+	//Get the total time (ms) of the decoding and conversion of the frames in the decode thread.
+	double getTimeDecode()
+	{
+		double timeDecode;
+
+		lockMutex(&m_mutexStats);
+		timeDecode = m_timeDecode;
+		unlockMutex(&m_mutexStats);
+		return timeDecode/(cvGetTickFrequency()*1000.);
+	}
+
+private:
+	//Decode thread.
+	static FFME_THREAD_FUNC(decodeThread);
+	//Conversion of a decoded frame to luma.
+	void toLuma(IplImage* frame, IplImage* img_U81C);
+
+//Members:
+private:
+	//Video file.
+	CvCapture* m_capture;
+	int m_width;
+	int m_height;
+	int m_origin;
+	double m_fps;
+	int m_noFramesVideo;
+
+	/*Ring of buffers*/
+	int m_noBuffers;
+	IplImage** m_buffers;
+	int* m_idxFrameBuffers;
+	//Decoded buffers (decode thread to consumer) and free buffers (consumer to decode thread).
+	FFMEQueue m_fullQueue;
+	FFMEQueue m_freeQueue;
+	//Buffer extracted by the consumer (-1 if there is none).
+	int m_curBuffer;
+
+	/*Decode thread*/
+	FFMEThread m_thread;
+	//Flag to stop the thread and flag of the end of the video.
+	volatile long m_stop;
+	volatile long m_end;
+	bool m_running;
+
+	/*Statistics*/
+	//Number of decoded frames and decoding time (ticks), updated by the decode thread. The decoding time is not atomic,
+	//so it is protected by a mutex.
+	volatile long m_noDecoded;
+	double m_timeDecode;
+	FFMEMutex m_mutexStats;
+	//Number of stalls and stall time (ticks), updated by the consumer.
+	int m_noStalls;
+	double m_timeStall;
+};
@@ -0,0 +1,652 @@
+//-------------------------------------------------------------------------
+// globalMotion.cpp
+//-------------------------------------------------------------------------
+// Description: robust estimation of the global (camera) motion from the
+// correspondences of the FFME class.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "globalMotion.h"
+
+
+//Minimum number of correspondences and number of parameters of each model.
+static const int noPtosModel[4] = {1, 2, 3, 4};
+static const int noParamModel[4] = {2, 4, 6, 8};
+//Number of bits set in a 4 bit mask.
+static const int noBits4[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+
+GlobalMotion::GlobalMotion(void)
+{
+	m_maxNoCorr = 0;
+	m_noCorr = 0;
+	m_x1 = 0;
+	m_y1 = 0;
+	m_x2 = 0;
+	m_y2 = 0;
+	m_score = 0;
+	m_order = 0;
+	m_histScore = 0;
+	m_mask = 0;
+	m_bestMask = 0;
+	m_idxInliers = 0;
+	m_rng = cvRNG(0x12345678);
+	m_noIter = 0;
+	m_noRejectedSPRT = 0;
+}
+
+GlobalMotion::~GlobalMotion(void)
+{
+	cvFree(&m_x1);
+	cvFree(&m_y1);
+	cvFree(&m_x2);
+	cvFree(&m_y2);
+	cvFree(&m_score);
+	cvFree(&m_order);
+	cvFree(&m_histScore);
+	cvFree(&m_mask);
+	cvFree(&m_bestMask);
+	cvFree(&m_idxInliers);
+}
+
+
+/* Initialization of memory. The coordinate arrays are padded to a multiple of four points.
+   Inputs:
+   -maxNoCorr: maximum number of correspondences.
+   Outputs: --
+*/
+void GlobalMotion::iniGlobalMotion(int maxNoCorr)
+{
+	int size = (maxNoCorr + 3) & ~3;
+
+	m_threshInlier = (float)THRESH_INLIER_GLOBAL_MOTION;
+	m_maxNoIter = MAX_NO_ITER_GLOBAL_MOTION;
+	m_confidence = (float)CONFIDENCE_GLOBAL_MOTION;
+	m_noIterRefine = NO_ITER_REFINE_GLOBAL_MOTION;
+	m_maxNoCorr = maxNoCorr;
+	m_noCorr = 0;
+
+	m_x1 = (float*)cvAlloc(size * sizeof(float));
+	m_y1 = (float*)cvAlloc(size * sizeof(float));
+	m_x2 = (float*)cvAlloc(size * sizeof(float));
+	m_y2 = (float*)cvAlloc(size * sizeof(float));
+	m_score = (float*)cvAlloc(size * sizeof(float));
+	m_order = (int*)cvAlloc(size * sizeof(int));
+	m_histScore = (int*)cvAlloc((NO_BINS_PROSAC_GLOBAL_MOTION + 1) * sizeof(int));
+	m_mask = (unsigned char*)cvAlloc(size * sizeof(unsigned char));
+	m_bestMask = (unsigned char*)cvAlloc(size * sizeof(unsigned char));
+	m_idxInliers = (int*)cvAlloc(size * sizeof(int));
+}
+
+
+/* Estimation of the global motion from a list of correspondences. The correspondences are sampled in order of
+   reliability (ratio between the distances to the best and second best candidates), so a good model is usually found
+   after a few hypotheses.
+   The motion is returned as a 3x3 matrix (row order) that maps the points of the first image to the second image in
+   homogeneous coordinates. For the translation, similarity and affine models the last row is (0,0,1), and the first six
+   elements can be used directly as an affine motion prior of the FFME class.
+   Inputs:
+   -corrList: list of correspondences. Only the first 'm_maxNoCorr' correspondences are used.
+   -singPtos1: array of locations related to the singular points in the first image.
+   -singPtos2: array of locations related to the singular points in the second image.
+   -model: motion model (GLOBAL_MOTION_TRANSLATION, GLOBAL_MOTION_SIMILARITY, GLOBAL_MOTION_AFFINE or
+    GLOBAL_MOTION_HOMOGRAPHY).
+   -motion: (input/output) array of 9 elements with the estimated motion.
+   -inlierMask: (input/output) array with 1 for the inliers and 0 for the outliers, in the order of the list. It can be
+    NULL.
+   Outputs: number of inliers.
+*/
+int GlobalMotion::estimateMotion(FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, int model,
+		                         float* motion, unsigned char* inlierMask)
+{
+	int i;
+	m_noCorr = MIN(corrList->noCorr, m_maxNoCorr);
+
+	//Load of the points and their reliability.
+	for(i=0;i<m_noCorr;i++)
+	{
+		m_x1[i] = singPtos1[corrList->idx1[i]].x;
+		m_y1[i] = singPtos1[corrList->idx1[i]].y;
+		m_x2[i] = singPtos2[corrList->idx2[i]].x;
+		m_y2[i] = singPtos2[corrList->idx2[i]].y;
+		if(corrList->dist2[i] == FLT_MAX)
+		{
+			m_score[i] = 1; //Without second candidate the reliability is unknown.
+		}
+		else
+		{
+			m_score[i] = MIN(corrList->dist1[i] / MAX(corrList->dist2[i], FLT_EPSILON), 1.f);
+		}
+	}
+	normalizePtos();
+	sortPtos();
+
+	return estimate(model, motion, inlierMask);
+}
+
+
+/* Estimation of the global motion from an array of correspondences. There is no information about the reliability of
+   the correspondences, so they are sampled in random order (RANSAC).
+   Inputs:
+   -correspondences: array of correspondences. Only the first 'm_maxNoCorr' correspondences are used.
+   -noCorr: number of correspondences.
+   -model: motion model (GLOBAL_MOTION_TRANSLATION, GLOBAL_MOTION_SIMILARITY, GLOBAL_MOTION_AFFINE or
+    GLOBAL_MOTION_HOMOGRAPHY).
+   -motion: (input/output) array of 9 elements with the estimated motion (see the other version of the function).
+   -inlierMask: (input/output) array with 1 for the inliers and 0 for the outliers. It can be NULL.
+   Outputs: number of inliers.
+*/
+int GlobalMotion::estimateMotion(CvPoint2D32f** correspondences, int noCorr, int model, float* motion, unsigned char* inlierMask)
+{
+	int i, j, tmp;
+	m_noCorr = MIN(noCorr, m_maxNoCorr);
+
+	//Load of the points.
+	for(i=0;i<m_noCorr;i++)
+	{
+		m_x1[i] = correspondences[i][0].x;
+		m_y1[i] = correspondences[i][0].y;
+		m_x2[i] = correspondences[i][1].x;
+		m_y2[i] = correspondences[i][1].y;
+		m_order[i] = i;
+	}
+	normalizePtos();
+
+	//Random order (Fisher-Yates shuffle).
+	for(i=m_noCorr-1;i>0;i--)
+	{
+		j = cvRandInt(&m_rng) % (i+1);
+		tmp = m_order[i];
+		m_order[i] = m_order[j];
+		m_order[j] = tmp;
+	}
+
+	return estimate(model, motion, inlierMask);
+}
+
+
+/* Robust estimation over the loaded points. The hypotheses are generated with the PROSAC schedule over the sampling
+   order, and verified with the SPRT. The sampling stops when the confidence is reached or when the maximum number of
+   hypotheses is generated. The best model is refined by least squares over its inliers.
+   Inputs:
+   -model: motion model.
+   -motion: (input/output) array of 9 elements with the estimated motion.
+   -inlierMask: (input/output) inlier mask. It can be NULL.
+   Outputs: number of inliers.
+*/
+int GlobalMotion::estimate(int model, float* motion, unsigned char* inlierMask)
+{
+	int i, k, t;
+	int m = noPtosModel[model];
+	int N = m_noCorr;
+	int n, maxNoIter;
+	int sample[4];
+	int noInliers, noTested, bestNoInliers = 0;
+	unsigned char* tmpMask;
+	float h[9], bestH[9];
+	double Tn, Tn1, TnPrime, epsM;
+	double T[9], invT[9], M[9], H[9];
+
+	m_noIter = 0;
+	m_noRejectedSPRT = 0;
+	m_thresh2Norm = (float)(m_threshInlier * m_scale * m_threshInlier * m_scale);
+	m_epsilon = EPSILON_SPRT_GLOBAL_MOTION;
+	m_delta = DELTA_SPRT_GLOBAL_MOTION;
+	updateSPRT();
+
+	//Identity motion if there are not enough correspondences.
+	for(i=0;i<9;i++)
+	{
+		motion[i] = (i % 4 == 0) ? 1.f : 0.f;
+	}
+	if(inlierMask)
+	{
+		memset(inlierMask, 0, N * sizeof(unsigned char));
+	}
+	if(N < m)
+	{
+		return 0;
+	}
+
+	//PROSAC growth function (initial values).
+	Tn = m_maxNoIter;
+	for(i=0;i<m;i++)
+	{
+		Tn *= (double)(m-i) / (double)(N-i);
+	}
+	TnPrime = 1;
+	n = m;
+	maxNoIter = m_maxNoIter;
+
+	for(t=1; t<=maxNoIter; t++)
+	{
+		//Growth of the sampling set.
+		if(t > TnPrime && n < N)
+		{
+			Tn1 = Tn * (n+1) / (n+1-m);
+			TnPrime += ceil(Tn1 - Tn);
+			Tn = Tn1;
+			n++;
+		}
+
+		//Sample: the last point of the sampling set and m-1 points of the rest, or m points of the whole set.
+		k = 0;
+		if(TnPrime >= t)
+		{
+			sample[k++] = m_order[n-1];
+		}
+		while(k < m)
+		{
+			int idx = m_order[cvRandInt(&m_rng) % (TnPrime >= t ? n-1 : n)];
+			bool repeated = false;
+			for(i=0;i<k;i++)
+			{
+				repeated = repeated || (sample[i] == idx);
+			}
+			if(!repeated)
+			{
+				sample[k++] = idx;
+			}
+		}
+
+		//Hypothesis.
+		m_noIter++;
+		if(!fitModel(model, sample, m, h))
+		{
+			continue;
+		}
+
+		//Verification.
+		if(!scoreModel(h, true, m_mask, &noInliers, &noTested))
+		{
+			//Rejected by the SPRT. Update of the probability of consistency with a bad model.
+			m_noRejectedSPRT++;
+			m_delta = 0.95 * m_delta + 0.05 * (double)noInliers / noTested;
+			m_delta = MAX(m_delta, 0.001);
+			updateSPRT();
+		}
+		else if(noInliers > bestNoInliers)
+		{
+			bestNoInliers = noInliers;
+			memcpy(bestH, h, 9*sizeof(float));
+			tmpMask = m_bestMask; //Exchange pointers.
+			m_bestMask = m_mask;
+			m_mask = tmpMask;
+
+			//Update of the probability of consistency with a good model and of the number of hypotheses.
+			m_epsilon = (double)bestNoInliers / N;
+			updateSPRT();
+			epsM = pow(m_epsilon, m);
+			if(epsM >= 1)
+			{
+				maxNoIter = t;
+			}
+			else
+			{
+				maxNoIter = MIN(m_maxNoIter, cvCeil(log(1 - m_confidence) / log(1 - epsM)));
+			}
+		}
+	}
+
+	if(bestNoInliers == 0)
+	{
+		return 0;
+	}
+
+	//Least-squares refinement over the inliers.
+	for(k=0;k<m_noIterRefine;k++)
+	{
+		n = 0;
+		for(i=0;i<N;i++)
+		{
+			if(m_bestMask[i])
+			{
+				m_idxInliers[n++] = i;
+			}
+		}
+		if(!fitModel(model, m_idxInliers, n, h))
+		{
+			break;
+		}
+		scoreModel(h, false, m_mask, &noInliers, &noTested);
+		if(noInliers < bestNoInliers)
+		{
+			break;
+		}
+		bestNoInliers = noInliers;
+		memcpy(bestH, h, 9*sizeof(float));
+		tmpMask = m_bestMask; //Exchange pointers.
+		m_bestMask = m_mask;
+		m_mask = tmpMask;
+	}
+
+	//Back to image coordinates: H = inv(T) * Hn * T.
+	T[0] = m_scale; T[1] = 0;       T[2] = -m_scale*m_cx;
+	T[3] = 0;       T[4] = m_scale; T[5] = -m_scale*m_cy;
+	T[6] = 0;       T[7] = 0;       T[8] = 1;
+	invT[0] = 1/m_scale; invT[1] = 0;         invT[2] = m_cx;
+	invT[3] = 0;         invT[4] = 1/m_scale; invT[5] = m_cy;
+	invT[6] = 0;         invT[7] = 0;         invT[8] = 1;
+	for(i=0;i<3;i++)
+	{
+		for(k=0;k<3;k++)
+		{
+			M[i*3+k] = bestH[i*3]*T[k] + bestH[i*3+1]*T[3+k] + bestH[i*3+2]*T[6+k];
+		}
+	}
+	for(i=0;i<3;i++)
+	{
+		for(k=0;k<3;k++)
+		{
+			H[i*3+k] = invT[i*3]*M[k] + invT[i*3+1]*M[3+k] + invT[i*3+2]*M[6+k];
+		}
+	}
+	for(i=0;i<9;i++)
+	{
+		motion[i] = (float)(H[i] / H[8]);
+	}
+
+	if(inlierMask)
+	{
+		memcpy(inlierMask, m_bestMask, N * sizeof(unsigned char));
+	}
+
+	return bestNoInliers;
+}
+
+
+/* Normalization of the coordinates of the loaded points. The same translation and scale are applied to both images, so
+   the motion models are preserved, and the points are moved to the origin with a mean distance of sqrt(2).
+   Inputs: --
+   Outputs: --
+*/
+void GlobalMotion::normalizePtos()
+{
+	int i;
+	double sumDist = 0;
+	float cx, cy, scale;
+	m_cx = 0;
+	m_cy = 0;
+
+	if(m_noCorr == 0)
+	{
+		m_scale = 1;
+		return;
+	}
+
+	for(i=0;i<m_noCorr;i++)
+	{
+		m_cx += m_x1[i] + m_x2[i];
+		m_cy += m_y1[i] + m_y2[i];
+	}
+	m_cx /= 2*m_noCorr;
+	m_cy /= 2*m_noCorr;
+	for(i=0;i<m_noCorr;i++)
+	{
+		sumDist += sqrt((m_x1[i]-m_cx)*(m_x1[i]-m_cx) + (m_y1[i]-m_cy)*(m_y1[i]-m_cy));
+		sumDist += sqrt((m_x2[i]-m_cx)*(m_x2[i]-m_cx) + (m_y2[i]-m_cy)*(m_y2[i]-m_cy));
+	}
+	m_scale = (sumDist > 0) ? sqrt(2.0) * 2*m_noCorr / sumDist : 1;
+
+	cx = (float)m_cx;
+	cy = (float)m_cy;
+	scale = (float)m_scale;
+	for(i=0;i<m_noCorr;i++)
+	{
+		m_x1[i] = (m_x1[i] - cx) * scale;
+		m_y1[i] = (m_y1[i] - cy) * scale;
+		m_x2[i] = (m_x2[i] - cx) * scale;
+		m_y2[i] = (m_y2[i] - cy) * scale;
+	}
+}
+
+
+/* Sort of the loaded points by reliability (counting sort over quantized scores). The order is stable, and the cost is
+   linear in the number of points.
+   Inputs: --
+   Outputs: --
+*/
+void GlobalMotion::sortPtos()
+{
+	int i, bin;
+
+	for(i=0;i<=NO_BINS_PROSAC_GLOBAL_MOTION;i++)
+	{
+		m_histScore[i] = 0;
+	}
+	for(i=0;i<m_noCorr;i++)
+	{
+		bin = MIN(cvFloor(m_score[i] * NO_BINS_PROSAC_GLOBAL_MOTION), NO_BINS_PROSAC_GLOBAL_MOTION-1);
+		m_histScore[bin+1]++;
+	}
+	for(i=1;i<=NO_BINS_PROSAC_GLOBAL_MOTION;i++) //First position of each bin.
+	{
+		m_histScore[i] += m_histScore[i-1];
+	}
+	for(i=0;i<m_noCorr;i++)
+	{
+		bin = MIN(cvFloor(m_score[i] * NO_BINS_PROSAC_GLOBAL_MOTION), NO_BINS_PROSAC_GLOBAL_MOTION-1);
+		m_order[m_histScore[bin]++] = i;
+	}
+}
+
+
+/* Least-squares fitting of a model to a set of points (normalized coordinates). The homography is fitted with the
+   direct linear transformation and the last element fixed to 1.
+   Inputs:
+   -model: motion model.
+   -idx: array of indices of the points.
+   -noPtos: number of points.
+   -h: (input/output) array of 9 elements with the model.
+   Outputs: false if the system is degenerate.
+*/
+bool GlobalMotion::fitModel(int model, int* idx, int noPtos, float* h)
+{
+	int i, j, k;
+	int noParam = noParamModel[model];
+	double AtA[64], Atb[8], p[8];
+	double r1[8], r2[8], b1, b2;
+
+	if(noPtos < noPtosModel[model])
+	{
+		return false;
+	}
+
+	memset(AtA, 0, sizeof(AtA));
+	memset(Atb, 0, sizeof(Atb));
+	for(k=0;k<noPtos;k++)
+	{
+		double x1 = m_x1[idx[k]];
+		double y1 = m_y1[idx[k]];
+		double x2 = m_x2[idx[k]];
+		double y2 = m_y2[idx[k]];
+
+		//Two equations per point.
+		switch(model)
+		{
+		case GLOBAL_MOTION_TRANSLATION:
+			r1[0] = 1;  r1[1] = 0;  b1 = x2 - x1;
+			r2[0] = 0;  r2[1] = 1;  b2 = y2 - y1;
+			break;
+		case GLOBAL_MOTION_SIMILARITY:
+			r1[0] = x1; r1[1] = -y1; r1[2] = 1; r1[3] = 0; b1 = x2;
+			r2[0] = y1; r2[1] = x1;  r2[2] = 0; r2[3] = 1; b2 = y2;
+			break;
+		case GLOBAL_MOTION_AFFINE:
+			r1[0] = x1; r1[1] = y1; r1[2] = 1; r1[3] = 0;  r1[4] = 0;  r1[5] = 0; b1 = x2;
+			r2[0] = 0;  r2[1] = 0;  r2[2] = 0; r2[3] = x1; r2[4] = y1; r2[5] = 1; b2 = y2;
+			break;
+		default:
+			r1[0] = x1; r1[1] = y1; r1[2] = 1; r1[3] = 0;  r1[4] = 0;  r1[5] = 0; r1[6] = -x1*x2; r1[7] = -y1*x2; b1 = x2;
+			r2[0] = 0;  r2[1] = 0;  r2[2] = 0; r2[3] = x1; r2[4] = y1; r2[5] = 1; r2[6] = -x1*y2; r2[7] = -y1*y2; b2 = y2;
+		}
+
+		//Normal equations.
+		for(i=0;i<noParam;i++)
+		{
+			for(j=0;j<noParam;j++)
+			{
+				AtA[i*noParam+j] += r1[i]*r1[j] + r2[i]*r2[j];
+			}
+			Atb[i] += r1[i]*b1 + r2[i]*b2;
+		}
+	}
+
+	CvMat matA = cvMat(noParam, noParam, CV_64FC1, AtA);
+	CvMat matB = cvMat(noParam, 1, CV_64FC1, Atb);
+	CvMat matP = cvMat(noParam, 1, CV_64FC1, p);
+	if(!cvSolve(&matA, &matB, &matP, CV_LU))
+	{
+		return false;
+	}
+
+	//Model as a 3x3 matrix.
+	switch(model)
+	{
+	case GLOBAL_MOTION_TRANSLATION:
+		h[0] = 1;           h[1] = 0;            h[2] = (float)p[0];
+		h[3] = 0;           h[4] = 1;            h[5] = (float)p[1];
+		h[6] = 0;           h[7] = 0;            h[8] = 1;
+		break;
+	case GLOBAL_MOTION_SIMILARITY:
+		h[0] = (float)p[0]; h[1] = (float)-p[1]; h[2] = (float)p[2];
+		h[3] = (float)p[1]; h[4] = (float)p[0];  h[5] = (float)p[3];
+		h[6] = 0;           h[7] = 0;            h[8] = 1;
+		break;
+	case GLOBAL_MOTION_AFFINE:
+		h[0] = (float)p[0]; h[1] = (float)p[1];  h[2] = (float)p[2];
+		h[3] = (float)p[3]; h[4] = (float)p[4];  h[5] = (float)p[5];
+		h[6] = 0;           h[7] = 0;            h[8] = 1;
+		break;
+	default:
+		h[0] = (float)p[0]; h[1] = (float)p[1];  h[2] = (float)p[2];
+		h[3] = (float)p[3]; h[4] = (float)p[4];  h[5] = (float)p[5];
+		h[6] = (float)p[6]; h[7] = (float)p[7];  h[8] = 1;
+	}
+	return true;
+}
+
+
+/* Score of a model: number of points with a reprojection error lower than the threshold. The error is evaluated without
+   divisions, (xp - w*x2)^2 + (yp - w*y2)^2 <= thresh^2 * w^2, so all the models are scored in the same way, and the
+   points are processed in batches of four with SSE. With the SPRT, the likelihood ratio is updated after each batch,
+   and the model is rejected as soon as it exceeds the decision threshold.
+   Inputs:
+   -h: array of 9 elements with the model (normalized coordinates).
+   -sprt: flag to indicate if the SPRT is applied.
+   -mask: (input/output) inlier mask of the tested points.
+   -noInliers: (input/output) number of inliers among the tested points.
+   -noTested: (input/output) number of tested points.
+   Outputs: false if the model is rejected by the SPRT.
+*/
+bool GlobalMotion::scoreModel(float* h, bool sprt, unsigned char* mask, int* noInliers, int* noTested)
+{
+	int i = 0;
+	int inliers = 0;
+	double lambda = 1;
+	float thresh2 = m_thresh2Norm;
+
+#ifdef SSE_GLOBAL_MOTION
+	int noCorr4 = m_noCorr & ~3;
+	int bits;
+	__m128 h0 = _mm_set1_ps(h[0]), h1 = _mm_set1_ps(h[1]), h2 = _mm_set1_ps(h[2]);
+	__m128 h3 = _mm_set1_ps(h[3]), h4 = _mm_set1_ps(h[4]), h5 = _mm_set1_ps(h[5]);
+	__m128 h6 = _mm_set1_ps(h[6]), h7 = _mm_set1_ps(h[7]), h8 = _mm_set1_ps(h[8]);
+	__m128 t2 = _mm_set1_ps(thresh2);
+	__m128 zero = _mm_setzero_ps();
+
+	for(; i<noCorr4; i+=4)
+	{
+		__m128 x1 = _mm_load_ps(m_x1+i);
+		__m128 y1 = _mm_load_ps(m_y1+i);
+		__m128 xp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h0, x1), _mm_mul_ps(h1, y1)), h2);
+		__m128 yp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h3, x1), _mm_mul_ps(h4, y1)), h5);
+		__m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h6, x1), _mm_mul_ps(h7, y1)), h8);
+		__m128 ex = _mm_sub_ps(xp, _mm_mul_ps(w, _mm_load_ps(m_x2+i)));
+		__m128 ey = _mm_sub_ps(yp, _mm_mul_ps(w, _mm_load_ps(m_y2+i)));
+		__m128 e2 = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+		__m128 inl = _mm_and_ps(_mm_cmple_ps(e2, _mm_mul_ps(t2, _mm_mul_ps(w, w))), _mm_cmpgt_ps(w, zero));
+
+		bits = _mm_movemask_ps(inl);
+		mask[i] = (unsigned char)(bits & 1);
+		mask[i+1] = (unsigned char)((bits >> 1) & 1);
+		mask[i+2] = (unsigned char)((bits >> 2) & 1);
+		mask[i+3] = (unsigned char)((bits >> 3) & 1);
+		inliers += noBits4[bits];
+
+		if(sprt)
+		{
+			lambda *= m_lrSPRT[noBits4[bits]];
+			if(lambda > m_threshSPRT)
+			{
+				*noInliers = inliers;
+				*noTested = i+4;
+				return false;
+			}
+		}
+	}
+#endif
+
+	//Scalar version (and remaining points).
+	for(; i<m_noCorr; i++)
+	{
+		float xp = h[0]*m_x1[i] + h[1]*m_y1[i] + h[2];
+		float yp = h[3]*m_x1[i] + h[4]*m_y1[i] + h[5];
+		float w = h[6]*m_x1[i] + h[7]*m_y1[i] + h[8];
+		float ex = xp - w*m_x2[i];
+		float ey = yp - w*m_y2[i];
+
+		mask[i] = (unsigned char)(w > 0 && ex*ex + ey*ey <= thresh2*w*w);
+		inliers += mask[i];
+
+		if(sprt)
+		{
+			lambda *= mask[i] ? m_delta / m_epsilon : (1 - m_delta) / (1 - m_epsilon);
+			if(lambda > m_threshSPRT)
+			{
+				*noInliers = inliers;
+				*noTested = i+1;
+				return false;
+			}
+		}
+	}
+
+	*noInliers = inliers;
+	*noTested = m_noCorr;
+	return true;
+}
+
+
+/* Update of the decision threshold of the SPRT from the current probabilities of consistency with a good and a bad
+   model (Chum and Matas). If a good model is not more consistent than a bad one, the test is disabled.
+   Inputs: --
+   Outputs: --
+*/
+void GlobalMotion::updateSPRT()
+{
+	int i;
+	double C, A;
+
+	if(m_epsilon <= m_delta || m_epsilon >= 1)
+	{
+		m_threshSPRT = DBL_MAX;
+		return;
+	}
+
+	//Decision threshold.
+	C = (1 - m_delta) * log((1 - m_delta) / (1 - m_epsilon)) + m_delta * log(m_delta / m_epsilon);
+	A = COST_MODEL_SPRT_GLOBAL_MOTION * C + 1;
+	for(i=0;i<10;i++)
+	{
+		A = COST_MODEL_SPRT_GLOBAL_MOTION * C + 1 + log(A);
+	}
+	m_threshSPRT = A;
+
+	//Likelihood ratio of a batch of four points.
+	for(i=0;i<=4;i++)
+	{
+		m_lrSPRT[i] = pow(m_delta / m_epsilon, i) * pow((1 - m_delta) / (1 - m_epsilon), 4-i);
+	}
+}
@@ -0,0 +1,138 @@
+//-------------------------------------------------------------------------
+// globalMotion.h
+//-------------------------------------------------------------------------
+// Description: robust estimation of the global (camera) motion from the
+// correspondences of the FFME class. Translation, similarity, affine and
+// homography models are fitted with PROSAC sampling (the most reliable
+// correspondences are sampled first), early rejection of bad hypotheses
+// with the sequential probability ratio test (SPRT), hypothesis scoring
+// in batches of four points with SSE, and a final least-squares
+// refinement over the inliers. The number of hypotheses is bounded, so
+// the cost per frame is predictable.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+
+//Motion estimation class.
+#include "FFME.h"
+
+//SSE intrinsics for the scoring of the hypotheses.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SSE_GLOBAL_MOTION
+#include <xmmintrin.h>
+#endif
+
+
+//********************************************Parameters******************************************
+#define THRESH_INLIER_GLOBAL_MOTION 2.0 //Maximum reprojection error (pixels) of an inlier.
+#define MAX_NO_ITER_GLOBAL_MOTION 500 //Maximum number of hypotheses.
+#define CONFIDENCE_GLOBAL_MOTION 0.99 //Confidence of the estimation, used to stop the sampling.
+#define NO_ITER_REFINE_GLOBAL_MOTION 2 //Number of iterations of the least-squares refinement.
+#define NO_BINS_PROSAC_GLOBAL_MOTION 256 //Number of bins used to sort the correspondences by reliability.
+#define EPSILON_SPRT_GLOBAL_MOTION 0.2 //Initial probability of a point being consistent with a good model.
+#define DELTA_SPRT_GLOBAL_MOTION 0.05 //Initial probability of a point being consistent with a bad model.
+#define COST_MODEL_SPRT_GLOBAL_MOTION 200.0 //Cost of the generation of a hypothesis, in point evaluations.
+//************************************************************************************************
+
+
+//Motion models.
+#define GLOBAL_MOTION_TRANSLATION 0
+#define GLOBAL_MOTION_SIMILARITY 1
+#define GLOBAL_MOTION_AFFINE 2
+#define GLOBAL_MOTION_HOMOGRAPHY 3
+
+
+class GlobalMotion
+{
+//Methods:
+public:
+	GlobalMotion(void);
+	~GlobalMotion(void);
+	//Initialization of memory.
+	void iniGlobalMotion(int maxNoCorr);
+	//Estimation of the global motion from a list of correspondences. The reliability of the correspondences is used to
+	//guide the sampling. Returns the number of inliers.
+	int estimateMotion(FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, int model,
+		               float* motion, unsigned char* inlierMask);
+	//Estimation of the global motion from an array of correspondences. Returns the number of inliers.
+	int estimateMotion(CvPoint2D32f** correspondences, int noCorr, int model, float* motion, unsigned char* inlierMask);
+
+	//--get and set functions--//
+	//Get the number of hypotheses of the last estimation.
+	int getNoIter()
+	{
+		return m_noIter;
+	}
+	//Get the number of hypotheses rejected by the SPRT in the last estimation.
+	int getNoRejectedSPRT()
+	{
+		return m_noRejectedSPRT;
+	}
+
+private:
+	//Robust estimation over the loaded points.
+	int estimate(int model, float* motion, unsigned char* inlierMask);
+	//Normalization of the coordinates of the loaded points.
+	void normalizePtos();
+	//Sort of the loaded points by reliability.
+	void sortPtos();
+	//Least-squares fitting of a model to a set of points. Returns false if the system is degenerate.
+	bool fitModel(int model, int* idx, int noPtos, float* h);
+	//Score of a model (number of inliers). Returns false if the model is rejected by the SPRT.
+	bool scoreModel(float* h, bool sprt, unsigned char* mask, int* noInliers, int* noTested);
+	//Update of the decision threshold of the SPRT.
+	void updateSPRT();
+
+//Members:
+public:
+	//Maximum reprojection error (pixels) of an inlier.
+	float m_threshInlier;
+	//Maximum number of hypotheses.
+	int m_maxNoIter;
+	//Confidence of the estimation.
+	float m_confidence;
+	//Number of iterations of the least-squares refinement.
+	int m_noIterRefine;
+private:
+	//Maximum number of correspondences.
+	int m_maxNoCorr;
+	//Number of loaded correspondences.
+	int m_noCorr;
+	//Normalized coordinates of the correspondences, in contiguous arrays.
+	float* m_x1;
+	float* m_y1;
+	float* m_x2;
+	float* m_y2;
+	//Normalization: centroid and scale.
+	double m_cx, m_cy, m_scale;
+	//Squared inlier threshold in normalized coordinates.
+	float m_thresh2Norm;
+	//Reliability of the correspondences (lower is better) and order of the sampling.
+	float* m_score;
+	int* m_order;
+	int* m_histScore;
+	//Inlier masks of the current hypothesis and of the best one.
+	unsigned char* m_mask;
+	unsigned char* m_bestMask;
+	//Indices of the inliers (least-squares refinement).
+	int* m_idxInliers;
+	//Random number generator.
+	CvRNG m_rng;
+	//Number of hypotheses and number of hypotheses rejected by the SPRT of the last estimation.
+	int m_noIter;
+	int m_noRejectedSPRT;
+
+	/*SPRT*/
+	//Probability of a point being consistent with a good and with a bad model.
+	double m_epsilon;
+	double m_delta;
+	//Decision threshold.
+	double m_threshSPRT;
+	//Likelihood ratio factor for a batch of four points with 0 to 4 inliers.
+	double m_lrSPRT[5];
+};
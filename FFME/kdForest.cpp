@@ -0,0 +1,447 @@
+//-------------------------------------------------------------------------
+// kdForest.cpp
+//-------------------------------------------------------------------------
+// Description: randomized kd-forest for the approximate nearest neighbor
+// search of descriptors.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "kdForest.h"
+
+
+KdForest::KdForest(void)
+{
+	m_descriptors = 0;
+	m_noDesc = 0;
+	m_lengthDesc = 0;
+	m_noTrees = 0;
+	m_maxNoDesc = 0;
+	m_maxNoTrees = 0;
+	m_roots = 0;
+	m_divFeat = 0;
+	m_divVal = 0;
+	m_child1 = 0;
+	m_child2 = 0;
+	m_noNodes = 0;
+	m_idx = 0;
+	m_mean = 0;
+	m_var = 0;
+	m_rng = cvRNG(0x12345678);
+	m_heapNode = 0;
+	m_heapDist = 0;
+	m_heapSize = 0;
+	m_checked = 0;
+	m_query = 0;
+}
+
+KdForest::~KdForest(void)
+{
+	releaseForest();
+}
+
+
+/* Build of the forest over an array of descriptors. The descriptors are not copied, so they must not be modified
+   while the forest is used.
+   Inputs:
+   -descriptors: array of descriptors.
+   -noDesc: number of descriptors.
+   -lengthDesc: length of the descriptors.
+   -noTrees: number of randomized kd-trees.
+   Outputs: --
+*/
+void KdForest::buildForest(float** descriptors, int noDesc, int lengthDesc, int noTrees)
+{
+	int i,t;
+
+	//Memory reserving.
+	reserveForest(noDesc, noTrees);
+	if(lengthDesc != m_lengthDesc)
+	{
+		cvFree(&m_mean);
+		cvFree(&m_var);
+		m_mean = (float*)cvAlloc(lengthDesc * sizeof(float));
+		m_var = (float*)cvAlloc(lengthDesc * sizeof(float));
+	}
+
+	m_descriptors = descriptors;
+	m_noDesc = noDesc;
+	m_lengthDesc = lengthDesc;
+	m_noTrees = noTrees;
+	m_noNodes = 0;
+	for(i=0;i<noDesc;i++)
+	{
+		m_checked[i] = 0;
+	}
+	m_query = 0;
+
+	if(noDesc == 0)
+	{
+		return;
+	}
+
+	for(t=0;t<noTrees;t++)
+	{
+		int* idx = m_idx + t*m_maxNoDesc;
+
+		//Random permutation of the descriptors, so the variance is estimated from a random sample.
+		for(i=0;i<noDesc;i++)
+		{
+			idx[i] = i;
+		}
+		for(i=noDesc-1;i>0;i--)
+		{
+			int j = cvRandInt(&m_rng) % (i+1);
+			int tmp = idx[i];
+			idx[i] = idx[j];
+			idx[j] = tmp;
+		}
+
+		m_roots[t] = divideTree(m_idx, t*m_maxNoDesc, t*m_maxNoDesc + noDesc);
+	}
+}
+
+
+/* Search of the two approximate nearest neighbors of a descriptor. The trees are descended from their roots, and the
+   unexplored branches are visited in increasing order of distance to the query until 'maxChecks' descriptors have been
+   compared.
+   Inputs:
+   -desc: query descriptor.
+   -maxChecks: maximum number of descriptors compared. It controls the speed/accuracy trade-off.
+   -idx1: (input/output) index of the nearest neighbor, or -1 if there is none.
+   -dist1: (input/output) Euclidean distance to the nearest neighbor.
+   -idx2: (input/output) index of the second nearest neighbor, or -1 if there is none.
+   -dist2: (input/output) Euclidean distance to the second nearest neighbor.
+   Outputs: --
+*/
+void KdForest::searchNN2(float* desc, int maxChecks, int* idx1, float* dist1, int* idx2, float* dist2)
+{
+	int t, node;
+	int noChecks = 0;
+	float minDist;
+
+	*idx1 = -1;
+	*idx2 = -1;
+	*dist1 = FLT_MAX;
+	*dist2 = FLT_MAX;
+	m_heapSize = 0;
+	m_query++;
+
+	if(m_noDesc == 0)
+	{
+		return;
+	}
+
+	//First descent of each tree.
+	for(t=0;t<m_noTrees;t++)
+	{
+		descendTree(m_roots[t], 0, desc, &noChecks, idx1, dist1, idx2, dist2);
+	}
+
+	//Exploration of the closest branches.
+	while(m_heapSize > 0 && noChecks < maxChecks)
+	{
+		popBranch(&node, &minDist);
+		//The remaining branches can not improve the second nearest neighbor.
+		if(minDist > *dist2)
+		{
+			break;
+		}
+		descendTree(node, minDist, desc, &noChecks, idx1, dist1, idx2, dist2);
+	}
+
+	//Squared distances to Euclidean distances.
+	if(*idx1 != -1)
+	{
+		*dist1 = sqrt(*dist1);
+	}
+	if(*idx2 != -1)
+	{
+		*dist2 = sqrt(*dist2);
+	}
+}
+
+
+//****************************************************************************************
+// Private functions
+//****************************************************************************************
+
+
+/* Memory reserving for the forest. The previous memory is only released if it is not enough.
+   Inputs:
+   -noDesc: number of descriptors.
+   -noTrees: number of trees.
+   Outputs: --
+*/
+void KdForest::reserveForest(int noDesc, int noTrees)
+{
+	int maxNoNodes;
+
+	if(noDesc <= m_maxNoDesc && noTrees <= m_maxNoTrees)
+	{
+		return;
+	}
+	releaseForest();
+
+	m_maxNoDesc = noDesc;
+	m_maxNoTrees = noTrees;
+	//A tree with leaves of at least one descriptor has less than 2*noDesc nodes.
+	maxNoNodes = 2 * noDesc * noTrees;
+	m_roots = (int*)cvAlloc(noTrees * sizeof(int));
+	m_divFeat = (int*)cvAlloc(maxNoNodes * sizeof(int));
+	m_divVal = (float*)cvAlloc(maxNoNodes * sizeof(float));
+	m_child1 = (int*)cvAlloc(maxNoNodes * sizeof(int));
+	m_child2 = (int*)cvAlloc(maxNoNodes * sizeof(int));
+	m_idx = (int*)cvAlloc(noDesc * noTrees * sizeof(int));
+	//Every node is inserted at most once per query in the priority queue.
+	m_heapNode = (int*)cvAlloc(maxNoNodes * sizeof(int));
+	m_heapDist = (float*)cvAlloc(maxNoNodes * sizeof(float));
+	m_checked = (int*)cvAlloc(noDesc * sizeof(int));
+}
+
+
+//Release of the memory of the forest.
+void KdForest::releaseForest()
+{
+	cvFree(&m_roots);
+	cvFree(&m_divFeat);
+	cvFree(&m_divVal);
+	cvFree(&m_child1);
+	cvFree(&m_child2);
+	cvFree(&m_idx);
+	cvFree(&m_heapNode);
+	cvFree(&m_heapDist);
+	cvFree(&m_checked);
+	cvFree(&m_mean);
+	cvFree(&m_var);
+	m_lengthDesc = 0;
+	m_maxNoDesc = 0;
+	m_maxNoTrees = 0;
+}
+
+
+/* Recursive division of a set of descriptors. The split dimension is randomly chosen among the 'NO_DIM_SPLIT_KDFOREST'
+   dimensions of highest variance, and the split value is the mean of that dimension.
+   Inputs:
+   -idx: index array of the descriptors.
+   -start: first position of the set in the index array.
+   -end: position after the last one of the set in the index array.
+   Outputs: index of the created node.
+*/
+int KdForest::divideTree(int* idx, int start, int end)
+{
+	int i, k, d, lim;
+	int node = m_noNodes++;
+	int topDim[NO_DIM_SPLIT_KDFOREST];
+	int noTopDim = 0;
+
+	//Leaf node.
+	if(end - start <= SIZE_LEAF_KDFOREST)
+	{
+		m_divFeat[node] = -1;
+		m_child1[node] = start;
+		m_child2[node] = end;
+		return node;
+	}
+
+	//Mean and variance of each dimension over a sample of the set.
+	int noSamples = MIN(end - start, NO_SAMPLES_VAR_KDFOREST);
+	for(d=0;d<m_lengthDesc;d++)
+	{
+		m_mean[d] = 0;
+		m_var[d] = 0;
+	}
+	for(k=0;k<noSamples;k++)
+	{
+		float* desc = m_descriptors[idx[start+k]];
+		for(d=0;d<m_lengthDesc;d++)
+		{
+			m_mean[d] += desc[d];
+		}
+	}
+	for(d=0;d<m_lengthDesc;d++)
+	{
+		m_mean[d] /= noSamples;
+	}
+	for(k=0;k<noSamples;k++)
+	{
+		float* desc = m_descriptors[idx[start+k]];
+		for(d=0;d<m_lengthDesc;d++)
+		{
+			float dif = desc[d] - m_mean[d];
+			m_var[d] += dif * dif;
+		}
+	}
+
+	//Dimensions of highest variance (sorted insertion).
+	for(d=0;d<m_lengthDesc;d++)
+	{
+		if(noTopDim < NO_DIM_SPLIT_KDFOREST || m_var[d] > m_var[topDim[noTopDim-1]])
+		{
+			if(noTopDim < NO_DIM_SPLIT_KDFOREST)
+			{
+				noTopDim++;
+			}
+			for(i=noTopDim-1; i>0 && m_var[topDim[i-1]] < m_var[d]; i--)
+			{
+				topDim[i] = topDim[i-1];
+			}
+			topDim[i] = d;
+		}
+	}
+	d = topDim[cvRandInt(&m_rng) % noTopDim];
+	float divVal = m_mean[d];
+
+	//Partition of the set. Descriptors lower than the split value go to the first child.
+	lim = start;
+	for(i=start;i<end;i++)
+	{
+		if(m_descriptors[idx[i]][d] < divVal)
+		{
+			int tmp = idx[i];
+			idx[i] = idx[lim];
+			idx[lim] = tmp;
+			lim++;
+		}
+	}
+	//If all the descriptors fall on the same side, the set is split in halves.
+	if(lim == start || lim == end)
+	{
+		lim = (start + end) / 2;
+	}
+
+	m_divFeat[node] = d;
+	m_divVal[node] = divVal;
+	int child1 = divideTree(idx, start, lim);
+	int child2 = divideTree(idx, lim, end);
+	m_child1[node] = child1;
+	m_child2[node] = child2;
+
+	return node;
+}
+
+
+/* Descent of a tree from a node to a leaf, storing the unexplored branches in the priority queue. The descriptors of
+   the leaf are compared with the query, and the two nearest neighbors are updated.
+   Inputs:
+   -node: starting node.
+   -minDist: distance from the query to the region of the node.
+   -desc: query descriptor.
+   -noChecks: (input/output) number of descriptors compared.
+   -idx1, dist1, idx2, dist2: (input/output) nearest and second nearest neighbors, and their squared distances.
+   Outputs: --
+*/
+void KdForest::descendTree(int node, float minDist, float* desc, int* noChecks,
+						   int* idx1, float* dist1, int* idx2, float* dist2)
+{
+	int k, d;
+
+	while(m_divFeat[node] != -1)
+	{
+		float dif = desc[m_divFeat[node]] - m_divVal[node];
+		if(dif < 0)
+		{
+			pushBranch(m_child2[node], minDist + dif*dif);
+			node = m_child1[node];
+		}
+		else
+		{
+			pushBranch(m_child1[node], minDist + dif*dif);
+			node = m_child2[node];
+		}
+	}
+
+	for(k=m_child1[node]; k<m_child2[node]; k++)
+	{
+		int i = m_idx[k];
+		if(m_checked[i] == m_query)
+		{
+			continue;
+		}
+		m_checked[i] = m_query;
+		(*noChecks)++;
+
+		//Squared Euclidean distance. The computation stops when it can not improve the second nearest neighbor.
+		float* descTree = m_descriptors[i];
+		float dist = 0;
+		for(d=0; d<m_lengthDesc && dist < *dist2; d++)
+		{
+			float dif = desc[d] - descTree[d];
+			dist += dif * dif;
+		}
+
+		if(dist < *dist1)
+		{
+			*dist2 = *dist1;
+			*idx2 = *idx1;
+			*dist1 = dist;
+			*idx1 = i;
+		}
+		else if(dist < *dist2)
+		{
+			*dist2 = dist;
+			*idx2 = i;
+		}
+	}
+}
+
+
+/* Insertion of a branch in the priority queue.
+   Inputs:
+   -node: node of the branch.
+   -minDist: distance from the query to the region of the node.
+   Outputs: --
+*/
+void KdForest::pushBranch(int node, float minDist)
+{
+	int i = m_heapSize++;
+	while(i > 0)
+	{
+		int parent = (i-1) / 2;
+		if(m_heapDist[parent] <= minDist)
+		{
+			break;
+		}
+		m_heapNode[i] = m_heapNode[parent];
+		m_heapDist[i] = m_heapDist[parent];
+		i = parent;
+	}
+	m_heapNode[i] = node;
+	m_heapDist[i] = minDist;
+}
+
+
+/* Extraction of the closest branch from the priority queue.
+   Inputs:
+   -node: (input/output) node of the branch.
+   -minDist: (input/output) distance from the query to the region of the node.
+   Outputs: --
+*/
+void KdForest::popBranch(int* node, float* minDist)
+{
+	int i, child;
+	*node = m_heapNode[0];
+	*minDist = m_heapDist[0];
+
+	m_heapSize--;
+	int lastNode = m_heapNode[m_heapSize];
+	float lastDist = m_heapDist[m_heapSize];
+	i = 0;
+	while((child = 2*i + 1) < m_heapSize)
+	{
+		if(child + 1 < m_heapSize && m_heapDist[child+1] < m_heapDist[child])
+		{
+			child++;
+		}
+		if(lastDist <= m_heapDist[child])
+		{
+			break;
+		}
+		m_heapNode[i] = m_heapNode[child];
+		m_heapDist[i] = m_heapDist[child];
+		i = child;
+	}
+	m_heapNode[i] = lastNode;
+	m_heapDist[i] = lastDist;
+}
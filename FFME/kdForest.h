@@ -0,0 +1,92 @@
+//-------------------------------------------------------------------------
+// kdForest.h
+//-------------------------------------------------------------------------
+// Description: randomized kd-forest for the approximate nearest neighbor
+// search of descriptors. Several kd-trees are built splitting the data
+// along dimensions chosen randomly among the ones of highest variance,
+// and all of them are explored at the same time through a single
+// priority queue of branches. The number of descriptors compared per query
+// is bounded, which controls the speed/accuracy trade-off.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+
+
+//********************************************Parameters******************************************
+#define SIZE_LEAF_KDFOREST 4 //Maximum number of descriptors stored in a leaf of a kd-tree.
+#define NO_DIM_SPLIT_KDFOREST 5 //Number of dimensions of highest variance among which the split dimension is randomly chosen.
+#define NO_SAMPLES_VAR_KDFOREST 100 //Maximum number of descriptors used to estimate the variance of each dimension.
+//************************************************************************************************
+
+
+class KdForest
+{
+//Methods:
+public:
+	KdForest(void);
+	~KdForest(void);
+	//Build of the forest over an array of descriptors. The descriptors are not copied.
+	void buildForest(float** descriptors, int noDesc, int lengthDesc, int noTrees);
+	//Search of the two approximate nearest neighbors of a descriptor.
+	void searchNN2(float* desc, int maxChecks, int* idx1, float* dist1, int* idx2, float* dist2);
+
+private:
+	//Memory reserving for the forest. The previous memory is only released if it is not enough.
+	void reserveForest(int noDesc, int noTrees);
+	//Release of the memory of the forest.
+	void releaseForest();
+	//Recursive division of a set of descriptors. Returns the index of the created node.
+	int divideTree(int* idx, int start, int end);
+	//Descent of a tree from a node to a leaf, storing the unexplored branches in the priority queue.
+	void descendTree(int node, float minDist, float* desc, int* noChecks, int* idx1, float* dist1, int* idx2, float* dist2);
+	//Insertion of a branch in the priority queue.
+	void pushBranch(int node, float minDist);
+	//Extraction of the closest branch from the priority queue.
+	void popBranch(int* node, float* minDist);
+
+//Members:
+private:
+	//Descriptors indexed by the forest (not owned).
+	float** m_descriptors;
+	//Number of indexed descriptors.
+	int m_noDesc;
+	//Length of the descriptors.
+	int m_lengthDesc;
+	//Number of trees of the forest.
+	int m_noTrees;
+	//Capacity of the forest in number of descriptors and trees.
+	int m_maxNoDesc;
+	int m_maxNoTrees;
+
+	//Root node of each tree.
+	int* m_roots;
+	//Nodes of all the trees. Inner nodes store the split dimension and value, and the children. Leaf nodes store a
+	//split dimension of -1, and the range [child1,child2) of their descriptors in the index array.
+	int* m_divFeat;
+	float* m_divVal;
+	int* m_child1;
+	int* m_child2;
+	//Number of nodes.
+	int m_noNodes;
+	//Index arrays of the descriptors, one per tree.
+	int* m_idx;
+
+	//Mean and variance of each dimension (used during the build).
+	float* m_mean;
+	float* m_var;
+	//Random number generator.
+	CvRNG m_rng;
+
+	//Priority queue of branches (binary heap ordered by the distance to the query).
+	int* m_heapNode;
+	float* m_heapDist;
+	int m_heapSize;
+	//Mark of the last query that has compared each descriptor. It avoids comparing twice the same descriptor.
+	int* m_checked;
+	int m_query;
+};
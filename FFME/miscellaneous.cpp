@@ -11,6 +11,7 @@
 //-------------------------------------------------------------------------
 
 #include "miscellaneous.h"
+#include "FFME.h"
 
 
 /* Converts an image of type XX1C to U81C and scales the intensity values to show the maximum dynamic range of the image. It is used for display purposes. 
@@ -110,6 +111,28 @@ void drawCorr(IplImage* imgU83C, CvPoint2D32f** correspondences, int noCorr)
 }
 
 
+/* Draw a compact list of correspondences as a sparse motion vector field.
+   Inputs:
+   -img8U3C: (input/output) unsigned 8 bit 3 channel IplImage image where the motion vectors are going to be drawn.
+   -corrList: list of correspondences.
+   -singPtos1: array of locations related to the singular points in the first image.
+   -singPtos2: array of locations related to the singular points in the second image.
+   Outputs: --
+*/
+void drawCorrList(IplImage* imgU83C, FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2)
+{
+	int i;
+
+	for(i=0; i<corrList->noCorr; i++)
+	{
+		CvPoint pto1 = cvPointFrom32f(singPtos1[corrList->idx1[i]]);
+		CvPoint pto2 = cvPointFrom32f(singPtos2[corrList->idx2[i]]);
+		cvCircle(imgU83C, pto1, 1, CV_RGB(0,255,0), -1, 8,0);
+		cvLine(imgU83C, pto1, pto2, CV_RGB(0,255,0), 1, 8, 0);
+	}
+}
+
+
 /* Print correspondence vector values.
    Inputs:
    -correspondences: Nx2 array of correspondences. The first column stores the points of the first image and the
@@ -16,6 +16,9 @@
 #include "highgui.h"
 #include "cvaux.h"
 
+//Compact list of correspondences (defined in FFME.h).
+struct FFMECorrList;
+
 
 //***********************************Macros***********************************************
 // It is recommended to put into brackets all the arguments to avoid problems in the case that
@@ -25,6 +28,7 @@
 #define pixelImgU81C_M(img_U81C, i, j)  (((unsigned char*)((img_U81C)->imageData+(i)*(img_U81C)->widthStep))[(j)])
 #define pixelImgS161C_M(img_S161C, i, j)  (((short*)((img_S161C)->imageData+(i)*(img_S161C)->widthStep))[(j)])
 #define pixelImg32F1C_M(img_32F1C, i, j)  (((float*)((img_32F1C)->imageData+(i)*(img_32F1C)->widthStep))[(j)])
+#define pixelImgS321C_M(img_S321C, i, j)  (((int*)((img_S321C)->imageData+(i)*(img_S321C)->widthStep))[(j)])
 
 // Access to the matrix elements. (i, j) = (row, col).
 #define elemMat32F1C_M(mat_32F1C, i, j)  (((float*)((mat_32F1C)->data.ptr+(i)*(mat_32F1C)->step))[(j)])
@@ -55,5 +59,8 @@ void drawPtosIm(IplImage* imgU83C, CvPoint2D32f* singPtos, int noSingPtos);
 // Draw correspondences as a sparse motion vector field.
 void drawCorr(IplImage* imgU83C, CvPoint2D32f** correspondences, int noCorr);
 
+// Draw a compact list of correspondences as a sparse motion vector field.
+void drawCorrList(IplImage* imgU83C, FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2);
+
 //Print correspondence vector values.
 void printCorr(CvPoint2D32f** correspondences, int noCorr);	
@@ -0,0 +1,408 @@
+//-------------------------------------------------------------------------
+// motionField.cpp
+//-------------------------------------------------------------------------
+// Description: dense motion field from the sparse correspondences of the
+// FFME class.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "motionField.h"
+#include "miscellaneous.h"
+#include <limits.h>
+
+
+MotionField::MotionField(void)
+{
+	m_width = 0;
+	m_height = 0;
+	m_sizeBlock = 1;
+	m_noColsField = 0;
+	m_noRowsField = 0;
+	m_kernel = 0;
+	m_sumDx = 0;
+	m_sumDy = 0;
+	m_sumW = 0;
+	m_tmpDx = 0;
+	m_tmpDy = 0;
+	m_tmpW = 0;
+	m_sumSq = 0;
+}
+
+MotionField::~MotionField(void)
+{
+	cvFree(&m_kernel);
+	cvFree(&m_sumDx);
+	cvFree(&m_sumDy);
+	cvFree(&m_sumW);
+	cvFree(&m_tmpDx);
+	cvFree(&m_tmpDy);
+	cvFree(&m_tmpW);
+	cvFree(&m_sumSq);
+}
+
+
+/* Initialization of memory.
+   Inputs:
+   -width: width of the images.
+   -height: height of the images.
+   -sizeBlock: width in pixels of the blocks of the dense motion field (1 means per pixel).
+   Outputs: --
+*/
+void MotionField::iniMotionField(int width, int height, int sizeBlock)
+{
+	int size;
+
+	m_width = width;
+	m_height = height;
+	m_sizeBlock = sizeBlock;
+	m_noColsField = (width + sizeBlock - 1) / sizeBlock;
+	m_noRowsField = (height + sizeBlock - 1) / sizeBlock;
+	m_noThreads = NO_THREADS;
+
+	size = m_noColsField * m_noRowsField;
+	m_sumDx = (float*)cvAlloc(size * sizeof(float));
+	m_sumDy = (float*)cvAlloc(size * sizeof(float));
+	m_sumW = (float*)cvAlloc(size * sizeof(float));
+	m_tmpDx = (float*)cvAlloc(size * sizeof(float));
+	m_tmpDy = (float*)cvAlloc(size * sizeof(float));
+	m_tmpW = (float*)cvAlloc(size * sizeof(float));
+	m_sumSq = (float*)cvAlloc(size * sizeof(float));
+
+	setNormConvParam(RAD_NORM_CONV_MOTION_FIELD);
+}
+
+
+/* Set the radius of the normalized convolution. It is converted to blocks, and the Gaussian kernel has a standard
+   deviation of half the radius. Larger radii fill larger areas without correspondences, but smooth more the motion
+   boundaries.
+   Inputs:
+   -radNormConv: radius in pixels of the normalized convolution.
+   Outputs: --
+*/
+void MotionField::setNormConvParam(int radNormConv)
+{
+	int k;
+	float sigma;
+
+	cvFree(&m_kernel);
+	m_radNormConv = MAX(cvRound((float)radNormConv / m_sizeBlock), 1);
+	sigma = m_radNormConv * 0.5f;
+	m_kernel = (float*)cvAlloc((2*m_radNormConv+1) * sizeof(float));
+	for(k=-m_radNormConv;k<=m_radNormConv;k++)
+	{
+		m_kernel[k+m_radNormConv] = exp(-(k*k) / (2*sigma*sigma));
+	}
+}
+
+
+/* Dense motion field from a list of correspondences. The motion vectors are defined over the first image (from the
+   point of the first image to the point of the second image).
+   Inputs:
+   -corrList: list of correspondences.
+   -singPtos1: array of locations related to the singular points in the first image.
+   -singPtos2: array of locations related to the singular points in the second image.
+   -flow_32F2C: (input/output) float 2 channel image with the motion vector (dx,dy) of each block. Its size must be the
+    one returned by 'getSizeField'.
+   -weight_32F1C: (input/output) float image with the accumulated weight of each block, a measure of the density of
+    correspondences around the block. It can be NULL.
+   Outputs: --
+*/
+void MotionField::denseField(FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, 
+		                     IplImage* flow_32F2C, IplImage* weight_32F1C)
+{
+	int i;
+	CvPoint2D32f pto1, pto2;
+
+	resetSplat();
+	for(i=0;i<corrList->noCorr;i++)
+	{
+		pto1 = singPtos1[corrList->idx1[i]];
+		pto2 = singPtos2[corrList->idx2[i]];
+		splatVector(pto1.x, pto1.y, pto2.x-pto1.x, pto2.y-pto1.y);
+	}
+	normConv(flow_32F2C, weight_32F1C);
+}
+
+
+/* Dense motion field from an array of correspondences.
+   Inputs:
+   -correspondences: array of correspondences.
+   -noCorr: number of correspondences.
+   -flow_32F2C: (input/output) float 2 channel image with the motion vector (dx,dy) of each block. Its size must be the
+    one returned by 'getSizeField'.
+   -weight_32F1C: (input/output) float image with the accumulated weight of each block. It can be NULL.
+   Outputs: --
+*/
+void MotionField::denseField(CvPoint2D32f** correspondences, int noCorr, IplImage* flow_32F2C, IplImage* weight_32F1C)
+{
+	int i;
+
+	resetSplat();
+	for(i=0;i<noCorr;i++)
+	{
+		splatVector(correspondences[i][0].x, correspondences[i][0].y, 
+			        correspondences[i][1].x-correspondences[i][0].x, correspondences[i][1].y-correspondences[i][0].y);
+	}
+	normConv(flow_32F2C, weight_32F1C);
+}
+
+
+/* Block motion vectors from a list of correspondences, computed in a single pass over the list. Each block takes the
+   mean of the motion vectors of the correspondences located inside it. The blocks are the ones of the dense motion
+   field ('iniMotionField'), in row order. Like the lookahead of a video encoder, the blocks belong to the second
+   (current) image and the vectors point back to the first (reference) image: from the point of the second image to the
+   point of the first image.
+   Inputs:
+   -corrList: list of correspondences.
+   -singPtos1: array of locations related to the singular points in the first image.
+   -singPtos2: array of locations related to the singular points in the second image.
+   -blockMVs: (input/output) array of block motion vectors. Its size must be the one returned by 'getSizeField'.
+   Outputs: --
+*/
+void MotionField::blockVectors(FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, FFMEBlockMV* blockMVs)
+{
+	int i;
+	CvPoint2D32f pto1, pto2;
+
+	resetSplat();
+	for(i=0;i<corrList->noCorr;i++)
+	{
+		pto1 = singPtos1[corrList->idx1[i]];
+		pto2 = singPtos2[corrList->idx2[i]];
+		accumVector(pto2.x, pto2.y, pto1.x-pto2.x, pto1.y-pto2.y);
+	}
+	finishBlockVectors(blockMVs);
+}
+
+
+/* Block motion vectors from an array of correspondences, computed in a single pass over the array. The blocks belong
+   to the second image and the vectors point back to the first image (see the list version).
+   Inputs:
+   -correspondences: array of correspondences.
+   -noCorr: number of correspondences.
+   -blockMVs: (input/output) array of block motion vectors. Its size must be the one returned by 'getSizeField'.
+   Outputs: --
+*/
+void MotionField::blockVectors(CvPoint2D32f** correspondences, int noCorr, FFMEBlockMV* blockMVs)
+{
+	int i;
+
+	resetSplat();
+	for(i=0;i<noCorr;i++)
+	{
+		accumVector(correspondences[i][1].x, correspondences[i][1].y, 
+			        correspondences[i][0].x-correspondences[i][1].x, correspondences[i][0].y-correspondences[i][1].y);
+	}
+	finishBlockVectors(blockMVs);
+}
+
+
+/* Reset of the accumulators.
+   Inputs: --
+   Outputs: --
+*/
+void MotionField::resetSplat()
+{
+	int size = m_noColsField * m_noRowsField;
+
+	memset(m_sumDx, 0, size * sizeof(float));
+	memset(m_sumDy, 0, size * sizeof(float));
+	memset(m_sumW, 0, size * sizeof(float));
+	memset(m_sumSq, 0, size * sizeof(float));
+	m_meanDx = 0;
+	m_meanDy = 0;
+	m_noVect = 0;
+}
+
+
+/* Splat of a motion vector onto the four blocks whose centers are the nearest to its location (bilinear weights).
+   Inputs:
+   -x: horizontal coordinate of the vector.
+   -y: vertical coordinate of the vector.
+   -dx: horizontal component of the vector.
+   -dy: vertical component of the vector.
+   Outputs: --
+*/
+void MotionField::splatVector(float x, float y, float dx, float dy)
+{
+	int c, r, k;
+	float u, v, a, b, w;
+	int cs[2], rs[2];
+	float wc[2], wr[2];
+
+	//Location in block units, referred to the centers of the blocks.
+	u = (x - 0.5f*(m_sizeBlock-1)) / m_sizeBlock;
+	v = (y - 0.5f*(m_sizeBlock-1)) / m_sizeBlock;
+	c = cvFloor(u);
+	r = cvFloor(v);
+	a = u - c;
+	b = v - r;
+	cs[0] = MIN(MAX(c, 0), m_noColsField-1);
+	cs[1] = MIN(MAX(c+1, 0), m_noColsField-1);
+	rs[0] = MIN(MAX(r, 0), m_noRowsField-1);
+	rs[1] = MIN(MAX(r+1, 0), m_noRowsField-1);
+	wc[0] = 1-a;
+	wc[1] = a;
+	wr[0] = 1-b;
+	wr[1] = b;
+
+	for(k=0;k<4;k++)
+	{
+		int idx = rs[k>>1]*m_noColsField + cs[k&1];
+		w = wr[k>>1] * wc[k&1];
+		m_sumDx[idx] += w*dx;
+		m_sumDy[idx] += w*dy;
+		m_sumW[idx] += w;
+	}
+
+	m_meanDx += dx;
+	m_meanDy += dy;
+	m_noVect++;
+}
+
+
+/* Accumulation of a motion vector in the block that contains its location.
+   Inputs:
+   -x: horizontal coordinate of the vector.
+   -y: vertical coordinate of the vector.
+   -dx: horizontal component of the vector.
+   -dy: vertical component of the vector.
+   Outputs: --
+*/
+void MotionField::accumVector(float x, float y, float dx, float dy)
+{
+	int c = MIN(MAX(cvFloor(x / m_sizeBlock), 0), m_noColsField-1);
+	int r = MIN(MAX(cvFloor(y / m_sizeBlock), 0), m_noRowsField-1);
+	int idx = r*m_noColsField + c;
+
+	m_sumDx[idx] += dx;
+	m_sumDy[idx] += dy;
+	m_sumSq[idx] += dx*dx + dy*dy;
+	m_sumW[idx] += 1;
+}
+
+
+/* Computation of the block motion vectors from the accumulators. The vectors are rounded to quarter pixels. The
+   confidence grows with the number of vectors of the block (up to NO_VECT_SAT_BLOCK_MV) and decreases with their 
+   variance: 255 * min(n, NO_VECT_SAT_BLOCK_MV) / NO_VECT_SAT_BLOCK_MV * VAR_CONF_BLOCK_MV / (VAR_CONF_BLOCK_MV + var).
+   Inputs:
+   -blockMVs: (input/output) array of block motion vectors.
+   Outputs: --
+*/
+void MotionField::finishBlockVectors(FFMEBlockMV* blockMVs)
+{
+	int i;
+	int size = m_noColsField * m_noRowsField;
+
+	for(i=0;i<size;i++)
+	{
+		float n = m_sumW[i];
+		if(n == 0)
+		{
+			blockMVs[i].mvx = 0;
+			blockMVs[i].mvy = 0;
+			blockMVs[i].noVect = 0;
+			blockMVs[i].confidence = 0;
+			blockMVs[i].flags = BLOCK_MV_NO_DATA;
+		}
+		else
+		{
+			float meanDx = m_sumDx[i] / n;
+			float meanDy = m_sumDy[i] / n;
+			float var = MAX(m_sumSq[i] / n - meanDx*meanDx - meanDy*meanDy, 0.f);
+			float conf = MIN(n, (float)NO_VECT_SAT_BLOCK_MV) / NO_VECT_SAT_BLOCK_MV * 
+			             (float)(VAR_CONF_BLOCK_MV / (VAR_CONF_BLOCK_MV + var));
+			blockMVs[i].mvx = (short)MIN(MAX(cvRound(4*meanDx), SHRT_MIN), SHRT_MAX);
+			blockMVs[i].mvy = (short)MIN(MAX(cvRound(4*meanDy), SHRT_MIN), SHRT_MAX);
+			blockMVs[i].noVect = (unsigned short)MIN(cvRound(n), USHRT_MAX);
+			blockMVs[i].confidence = (unsigned char)cvRound(255 * conf);
+			blockMVs[i].flags = 0;
+		}
+	}
+}
+
+
+/* Normalized convolution of the accumulators: the weighted vectors and the weights are filtered with a separable
+   Gaussian kernel, and the motion vector of each block is their ratio. The taps outside the field are skipped, which
+   is compensated by the normalization. The blocks without correspondences in the support of the kernel take the mean
+   motion vector.
+   Inputs:
+   -flow_32F2C: (input/output) float 2 channel image with the motion vector of each block.
+   -weight_32F1C: (input/output) float image with the accumulated weight of each block. It can be NULL.
+   Outputs: --
+*/
+void MotionField::normConv(IplImage* flow_32F2C, IplImage* weight_32F1C)
+{
+	int r;
+	float meanDx = (m_noVect > 0) ? (float)(m_meanDx / m_noVect) : 0;
+	float meanDy = (m_noVect > 0) ? (float)(m_meanDy / m_noVect) : 0;
+#ifdef _OPENMP
+	int noThreads = (m_noThreads > 0) ? m_noThreads : omp_get_num_procs();
+#endif
+
+	//Horizontal filtering.
+#ifdef _OPENMP
+	#pragma omp parallel for num_threads(noThreads) schedule(static)
+#endif
+	for(r=0;r<m_noRowsField;r++)
+	{
+		int c, k;
+		int row = r*m_noColsField;
+		for(c=0;c<m_noColsField;c++)
+		{
+			float sDx = 0, sDy = 0, sW = 0;
+			int k0 = MAX(-m_radNormConv, -c);
+			int k1 = MIN(m_radNormConv, m_noColsField-1-c);
+			for(k=k0;k<=k1;k++)
+			{
+				float g = m_kernel[k+m_radNormConv];
+				sDx += g * m_sumDx[row+c+k];
+				sDy += g * m_sumDy[row+c+k];
+				sW += g * m_sumW[row+c+k];
+			}
+			m_tmpDx[row+c] = sDx;
+			m_tmpDy[row+c] = sDy;
+			m_tmpW[row+c] = sW;
+		}
+	}
+
+	//Vertical filtering and normalization.
+#ifdef _OPENMP
+	#pragma omp parallel for num_threads(noThreads) schedule(static)
+#endif
+	for(r=0;r<m_noRowsField;r++)
+	{
+		int c, k;
+		int k0 = MAX(-m_radNormConv, -r);
+		int k1 = MIN(m_radNormConv, m_noRowsField-1-r);
+		float* flow = (float*)(flow_32F2C->imageData + r*flow_32F2C->widthStep);
+		for(c=0;c<m_noColsField;c++)
+		{
+			float sDx = 0, sDy = 0, sW = 0;
+			for(k=k0;k<=k1;k++)
+			{
+				float g = m_kernel[k+m_radNormConv];
+				int idx = (r+k)*m_noColsField + c;
+				sDx += g * m_tmpDx[idx];
+				sDy += g * m_tmpDy[idx];
+				sW += g * m_tmpW[idx];
+			}
+			if(sW > MIN_WEIGHT_MOTION_FIELD)
+			{
+				flow[2*c] = sDx / sW;
+				flow[2*c+1] = sDy / sW;
+			}
+			else
+			{
+				flow[2*c] = meanDx;
+				flow[2*c+1] = meanDy;
+			}
+			if(weight_32F1C)
+			{
+				pixelImg32F1C_M(weight_32F1C, r, c) = sW;
+			}
+		}
+	}
+}
@@ -0,0 +1,120 @@
+//-------------------------------------------------------------------------
+// motionField.h
+//-------------------------------------------------------------------------
+// Description: dense motion field from the sparse correspondences of the
+// FFME class. The motion vectors are splatted onto a regular grid of
+// blocks, and the grid is interpolated with a normalized convolution
+// (separable Gaussian filtering of the weighted vectors and of the
+// weights). The cost is linear in the number of blocks and the filtering
+// is distributed among several threads. The correspondences can also be
+// aggregated in block motion vectors (e.g. macroblocks or CTUs of 16x16,
+// 32x32 or 64x64 pixels) to seed the motion search of a video encoder.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#pragma once
+//OpenCV
+#include "cv.h"
+
+//Motion estimation class.
+#include "FFME.h"
+
+
+//********************************************Parameters******************************************
+#define SIZE_BLOCK_MOTION_FIELD 8 //Width in pixels of the blocks of the dense motion field (1 means per pixel).
+#define RAD_NORM_CONV_MOTION_FIELD 48 //Radius in pixels of the normalized convolution.
+#define MIN_WEIGHT_MOTION_FIELD 1e-4 //Minimum weight of a block to be interpolated. Blocks with lower weight take the mean vector.
+#define NO_VECT_SAT_BLOCK_MV 4 //Number of vectors of a block from which the confidence does not increase.
+#define VAR_CONF_BLOCK_MV 1.0 //Variance (pixels^2) of the vectors of a block that halves its confidence.
+//************************************************************************************************
+
+
+//Flags of the block motion vectors.
+#define BLOCK_MV_NO_DATA 1 //There are no correspondences in the block. The motion vector is zero.
+
+
+//Motion vector of a block of the second (current) image pointing back to the first (reference) image, in a compact form
+//for the lookahead of video encoders.
+typedef struct FFMEBlockMV
+{
+	short mvx; //Horizontal component in quarter pixels.
+	short mvy; //Vertical component in quarter pixels.
+	unsigned short noVect; //Number of correspondences of the block.
+	unsigned char confidence; //Confidence (0-255) from the number and the agreement of the correspondences of the block.
+	unsigned char flags; //Flags (BLOCK_MV_NO_DATA).
+}
+FFMEBlockMV;
+
+
+class MotionField
+{
+//Methods:
+public:
+	MotionField(void);
+	~MotionField(void);
+	//Initialization of memory.
+	void iniMotionField(int width, int height, int sizeBlock = SIZE_BLOCK_MOTION_FIELD);
+	//Dense motion field from a list of correspondences.
+	void denseField(FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, 
+		            IplImage* flow_32F2C, IplImage* weight_32F1C = NULL);
+	//Dense motion field from an array of correspondences.
+	void denseField(CvPoint2D32f** correspondences, int noCorr, IplImage* flow_32F2C, IplImage* weight_32F1C = NULL);
+	//Block motion vectors from a list of correspondences.
+	void blockVectors(FFMECorrList* corrList, CvPoint2D32f* singPtos1, CvPoint2D32f* singPtos2, FFMEBlockMV* blockMVs);
+	//Block motion vectors from an array of correspondences.
+	void blockVectors(CvPoint2D32f** correspondences, int noCorr, FFMEBlockMV* blockMVs);
+
+	//--get and set functions--//
+	//Get the size of the dense motion field in blocks.
+	CvSize getSizeField()
+	{
+		return cvSize(m_noColsField, m_noRowsField);
+	}
+	//Set the radius (in pixels) of the normalized convolution. It must be called after 'iniMotionField()', which sets the
+	//default radius.
+	void setNormConvParam(int radNormConv);
+
+private:
+	//Reset of the accumulators.
+	void resetSplat();
+	//Splat of a motion vector onto the four nearest blocks.
+	void splatVector(float x, float y, float dx, float dy);
+	//Normalized convolution of the accumulators and computation of the dense motion field.
+	void normConv(IplImage* flow_32F2C, IplImage* weight_32F1C);
+	//Accumulation of a motion vector in the block that contains its location.
+	void accumVector(float x, float y, float dx, float dy);
+	//Computation of the block motion vectors from the accumulators.
+	void finishBlockVectors(FFMEBlockMV* blockMVs);
+
+//Members:
+public:
+	//Number of threads of the filtering (0 means one per processor).
+	int m_noThreads;
+private:
+	//Size of the image.
+	int m_width;
+	int m_height;
+	//Width in pixels of the blocks.
+	int m_sizeBlock;
+	//Size of the dense motion field in blocks.
+	int m_noColsField;
+	int m_noRowsField;
+	//Radius in blocks of the normalized convolution and Gaussian kernel.
+	int m_radNormConv;
+	float* m_kernel;
+	//Accumulators of the weighted vectors and of the weights (one plane each), and buffers of the horizontal filtering.
+	float* m_sumDx;
+	float* m_sumDy;
+	float* m_sumW;
+	float* m_tmpDx;
+	float* m_tmpDy;
+	float* m_tmpW;
+	//Accumulator of the squared norm of the vectors (block motion vectors).
+	float* m_sumSq;
+	//Mean motion vector (used in the blocks without data).
+	double m_meanDx;
+	double m_meanDy;
+	int m_noVect;
+};
@@ -0,0 +1,233 @@
+//-------------------------------------------------------------------------
+// bench1.cpp
+//-------------------------------------------------------------------------
+// Description: microbenchmark of the stages of the FFME class. A synthetic
+// image and the sample images are scaled to several resolutions, and for
+// each one the stages of the detection, the description and the matching
+// (against a translated copy) are timed separately. The time per call and
+// the throughput of each stage (pixels or points per second) are shown.
+//-------------------------------------------------------------------------
+// Requirements:
+// -OpenCV library.
+// -FFME library.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+//OpenCV dependencies.
+#include "cv.h"
+#include "highgui.h"
+#include "cvaux.h"
+
+//Motion estimation class and microbenchmark.
+#include "FFME.h"
+#include "FFMEBenchmark.h"
+
+
+//--Function declaration--//
+// Synthetic image with random rectangles and circles.
+void synthImg(IplImage* img_U81C, CvRNG* randGen);
+// Warping the image using a pure translation transformation with bilinear interpolation.
+void transImg(IplImage* img1_U81C, IplImage* img2_U81C, float transHor, float transVer, CvMat* mat1_32F1C);
+// Shows the timing of the stages.
+void showStages(FFMEStageTime* stages);
+
+
+//*****************************************Input*************************************************//
+//Images (a null name is the synthetic image).
+const char* filenames[] = {0, "1.jpeg", "2.jpeg"};
+int noImages = 3;
+//***********************************************************************************************//
+
+
+//*****************************************Parameters********************************************//
+//Resolutions.
+int widths[] = {320, 640, 1280, 1920};
+int heights[] = {240, 480, 720, 1080};
+int noResolutions = 4;
+
+//Geometric transformation of the second image.
+float transHor = 5; //Horizontal translation.
+float transVer = 3; //Vertical translation.
+
+//Gaussian noise parameters.
+int stdNoise = 3;
+
+//Estimation motion parameters.
+int noMaxPoints = 4000; //Maximum number of singular points.
+int decimation = 1; //Decimation factor (1, 2 or 4).
+
+//Number of calls of each stage.
+int noRuns = 20;
+//***********************************************************************************************//
+
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	//--Declarations--//.
+	int i, j;
+	IplImage* imgSrc_U81C;
+	IplImage* img1_U81C;
+	IplImage* img2_U81C;
+	FFME ffme;
+	FFMEBenchmark benchmark;
+	FFMEStageTime stages[NO_BENCH_STAGES];
+	CvMat* mat1_32F1C = cvCreateMat(2, 3, CV_32FC1);
+	int64 seed = -1;
+	CvRNG  randGen = cvRNG(seed);
+	CvMat* arrayGaussianNoise;
+
+
+	//--Initialization--//.
+	//Memory for the biggest resolution.
+	ffme.iniFFME(widths[noResolutions-1], heights[noResolutions-1], 0, noMaxPoints);
+	ffme.setDecimation(decimation);
+
+
+	for(i=0;i<noImages;i++)
+	{
+		//--Read images--//.
+		if(filenames[i] == 0)
+		{
+			imgSrc_U81C = cvCreateImage(cvSize(widths[noResolutions-1], heights[noResolutions-1]), IPL_DEPTH_8U, 1);
+			synthImg(imgSrc_U81C, &randGen);
+		}
+		else
+		{
+			imgSrc_U81C = cvLoadImage(filenames[i], CV_LOAD_IMAGE_GRAYSCALE);
+			if(!imgSrc_U81C)
+			{
+				printf("The image can not be opened: %s\n", filenames[i]);
+				continue;
+			}
+		}
+
+		for(j=0;j<noResolutions;j++)
+		{
+			//First image: scaled source image with Gaussian noise.
+			img1_U81C = cvCreateImage(cvSize(widths[j], heights[j]), IPL_DEPTH_8U, 1);
+			img1_U81C->origin = imgSrc_U81C->origin;
+			cvResize(imgSrc_U81C, img1_U81C, CV_INTER_LINEAR);
+			arrayGaussianNoise = cvCreateMat(heights[j], widths[j], CV_8UC1);
+			cvRandArr(&randGen, arrayGaussianNoise, CV_RAND_NORMAL, cvScalar(0), cvScalar(stdNoise));
+			cvAdd(img1_U81C, arrayGaussianNoise, img1_U81C, NULL);
+			//Second image: translated copy.
+			img2_U81C = cvCreateImage(cvGetSize(img1_U81C), IPL_DEPTH_8U, 1);
+			img2_U81C->origin = img1_U81C->origin;
+			transImg(img1_U81C, img2_U81C, transHor, transVer, mat1_32F1C);
+
+			//--Benchmark--//.
+			ffme.reconfigureFFME(widths[j], heights[j], img1_U81C->origin, noMaxPoints);
+			benchmark.benchStages(&ffme, img1_U81C, img2_U81C, noRuns, stages);
+
+			//Shows results.
+			printf("Image: %s, resolution: %dx%d, decimation: %d\n", (filenames[i] == 0)? "synthetic" : filenames[i],
+				   widths[j], heights[j], decimation);
+			showStages(stages);
+
+			cvReleaseImage(&img1_U81C);
+			cvReleaseImage(&img2_U81C);
+			cvReleaseMat(&arrayGaussianNoise);
+		}
+		cvReleaseImage(&imgSrc_U81C);
+	}
+
+
+	//*************************************Release memory********************************************//
+	cvReleaseMat(&mat1_32F1C);
+	//***********************************************************************************************//
+
+	return 0;
+}
+
+
+//-----------------------------Private functions-----------------------------------------//
+
+/* Synthetic image with random rectangles and circles of random intensity over a smooth background.
+   Inputs:
+   -img_U81C: (input/output) unsigned 8 bit 1 channel image.
+   -randGen: random number generator.
+   Outputs: --
+*/
+void synthImg(IplImage* img_U81C, CvRNG* randGen)
+{
+	int i, x, y, size;
+	int noShapes = img_U81C->width * img_U81C->height / 2000; //Density of shapes.
+	CvScalar intensity;
+
+	//Background.
+	for(y=0;y<img_U81C->height;y++)
+	{
+		for(x=0;x<img_U81C->width;x++)
+		{
+			pixelImgU81C_M(img_U81C, y, x) = (unsigned char)(128 + 40*sin(x*0.01) + 30*cos(y*0.013));
+		}
+	}
+
+	//Shapes.
+	for(i=0;i<noShapes;i++)
+	{
+		x = cvRandInt(randGen) % img_U81C->width;
+		y = cvRandInt(randGen) % img_U81C->height;
+		size = 4 + cvRandInt(randGen) % 40;
+		intensity = cvScalarAll(cvRandInt(randGen) % 256);
+		if(i % 2 == 0)
+		{
+			cvRectangle(img_U81C, cvPoint(x, y), cvPoint(x + size, y + size*3/4), intensity, CV_FILLED);
+		}
+		else
+		{
+			cvCircle(img_U81C, cvPoint(x, y), size/2, intensity, CV_FILLED);
+		}
+	}
+}
+
+
+/* Warping the image using a pure translation transformation with bilinear interpolation.
+   Pixels outside the image bounds are set to zero.
+   Inputs:
+   -img1_U81C: unsigned 8 bit 1 channel IplImage image to be translated.
+   -img2_U81C: (input/output)unsigned 8 bit 1 channel IplImage image translated.
+   -transHor: horizontal translation.
+   -transVer: vertical translation.
+   -mat1_32F1C: (input/output) 2x3 matrix. The function doesn't allocate memory.
+   Outputs: --
+*/
+void transImg(IplImage* img1_U81C, IplImage* img2_U81C, float transHor, float transVer, CvMat* mat1_32F1C)
+{
+	//2x3 geometric transformation initialization:
+	//|1 0 tx|  tx: horizontal translation.
+	//|0 1 ty|  ty: vertical translation.
+	elemMat32F1C_M(mat1_32F1C, 0, 0) = 1;
+	elemMat32F1C_M(mat1_32F1C, 0, 1) = 0;
+	elemMat32F1C_M(mat1_32F1C, 0, 2) = transHor;
+	elemMat32F1C_M(mat1_32F1C, 1, 0) = 0;
+	elemMat32F1C_M(mat1_32F1C, 1, 1) = 1;
+	elemMat32F1C_M(mat1_32F1C, 1, 2) = transVer;
+
+	//Image warping. Bilinear interpolation. Pixels outside the image bounds are set to zero.
+	cvWarpAffine(img1_U81C, img2_U81C, mat1_32F1C, CV_INTER_LINEAR+CV_WARP_FILL_OUTLIERS, cvScalarAll(0));
+}
+
+
+/* Shows the timing of the stages: average and minimum time per call, processed items and throughput.
+   Inputs:
+   -stages: array of NO_BENCH_STAGES timings.
+   Outputs: --
+*/
+void showStages(FFMEStageTime* stages)
+{
+	int i;
+
+	printf("%-24s %10s %10s %10s %14s\n", "Stage", "Avg (ms)", "Min (ms)", "Items", "Throughput");
+	for(i=0;i<NO_BENCH_STAGES;i++)
+	{
+		printf("%-24s %10.3f %10.3f %10d %9.2f %s\n", stages[i].name, stages[i].timeAvg, stages[i].timeMin, stages[i].noItems,
+			   stages[i].perPoint? FFMEBenchmark::throughput(stages+i) / 1e3 : FFMEBenchmark::throughput(stages+i) / 1e6,
+			   stages[i].perPoint? "kpts/s" : "Mpix/s");
+	}
+	printf("\n");
+}
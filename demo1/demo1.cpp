@@ -24,6 +24,8 @@
 
 //Motion estimation class.
 #include "FFME.h"
+//Asynchronous video ingest.
+#include "FFMEVideoSource.h"
 
 
 //*****************************************Input*************************************************//
@@ -43,7 +45,6 @@ int _tmain(int argc, _TCHAR* argv[])
 {
 	//--Declarations--//.
 	int i;
-	IplImage* img1_U83C = 0;
 	IplImage* img2_U81C = 0;
 	IplImage* img3_U83C = 0;
     FFME ffme;
@@ -58,25 +59,26 @@ int _tmain(int argc, _TCHAR* argv[])
 	int lengthDesc;
 	int noCorr;
 	CvPoint2D32f** correspondences;
-	CvCapture* capture;
+	FFMEVideoSource source;
 	int heigth;
 	int width;
 	int fps;
-	int noFrames;
-	int first;
-	int last;
+	int idxFrame;
 	CvVideoWriter *writer = 0; //To write videos.
 	int isColor = 1;
 	double timeMeasured;
 
 
 	//--Open video file--//
-	capture = cvCreateFileCapture(filename1);
-	img1_U83C = cvQueryFrame(capture); //Captures one frame to reaf the its properties.
-	heigth = (int) cvGetCaptureProperty(capture, CV_CAP_PROP_FRAME_HEIGHT);
-	width = (int) cvGetCaptureProperty(capture, CV_CAP_PROP_FRAME_WIDTH);
-	fps = (int) cvGetCaptureProperty(capture, CV_CAP_PROP_FPS);
-	noFrames = (int) cvGetCaptureProperty(capture,  CV_CAP_PROP_FRAME_COUNT);
+	//The frames are decoded ahead of the processing by the decode thread of the source.
+	if(!source.openSource(filename1))
+	{
+		printf("Could not open the video\n\7");
+		exit(-1);
+	}
+	heigth = source.getHeight();
+	width = source.getWidth();
+	fps = (int) source.getFps();
 
 
 	//--Inicializacin de la escritura de vdeo avi--//
@@ -88,7 +90,7 @@ int _tmain(int argc, _TCHAR* argv[])
 	singPoints1 = (CvPoint2D32f*)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f));
 	singPoints2 = (CvPoint2D32f*)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f));
 	//FFME class initialization.
-	ffme.iniFFME(img1_U83C->width, img1_U83C->height, img1_U83C->origin, noMaxPoints);
+	ffme.iniFFME(width, heigth, source.getOrigin(), noMaxPoints);
 	//Singular point description.
 	lengthDesc = ffme.m_widthArrayHist*ffme.m_widthArrayHist*ffme.m_noBinsOriHist; //Length of descriptor vector.
 	descriptors1 = (float**)cvAlloc(noMaxPoints * sizeof(float*));
@@ -109,33 +111,23 @@ int _tmain(int argc, _TCHAR* argv[])
 	}
 
 	//Allocate memory for results.
-	img2_U81C = cvCreateImage(cvGetSize(img1_U83C), IPL_DEPTH_8U, 1);
-	img2_U81C->origin = img1_U83C->origin; 
-	img3_U83C = cvCreateImage(cvGetSize(img1_U83C), IPL_DEPTH_8U, 3);
-	img3_U83C->origin = img1_U83C->origin; 
+	img3_U83C = cvCreateImage(cvSize(width, heigth), IPL_DEPTH_8U, 3);
+	img3_U83C->origin = source.getOrigin(); 
 	
 
 	//Processing loop.
-	first = 1;
-	last = noFrames;
-	for(i=first;i<last;i++)
+	//Get a pointer to the next luma frame in the ring of the source. The image must no be modified, and it is valid 
+	//until the next call.
+	while(source.nextFrame(&img2_U81C, &idxFrame))
 	{
-		//Store one frame in the internal memory.
-		if(!cvGrabFrame(capture))
-		{              
-		  printf("Could not grab a frame\n\7");
-		  exit(-1);
-		}
-		//Get a pointer to the frame in the internal buffer. The image must no be modified.
-		img1_U83C = cvRetrieveFrame(capture);
-		cvCvtColor( img1_U83C, img2_U81C, CV_BGR2GRAY );
-
-		if(i == first) //Initialization.
+		if(idxFrame == 0) //Initialization.
 		{
 			//Singular point detection.
 			ffme.singPtoDetLut(img2_U81C, singPoints1, &noSingPoints1);
 			//Singular point description.
 			ffme.singPtoDescLut(singPoints1, noSingPoints1, descriptors1, true);
+			//There is no motion prior for the first pair, so the search needs a large radius.
+			ffme.m_radMaxSearch = 32;
 
 			//Update buffers.
 			tmpPoints = singPoints2; //Exchange pointers.
@@ -156,8 +148,11 @@ int _tmain(int argc, _TCHAR* argv[])
 			//Singular point description.
 			ffme.singPtoDescLut(singPoints1, noSingPoints1, descriptors1, true);
 			//Matching of singular points. 
-			ffme.m_radMaxSearch = 32;
-			ffme.matchSingPtos(singPoints2, noSingPoints2, descriptors2, singPoints1, noSingPoints1, descriptors1, correspondences, &noCorr);
+			ffme.matchSingPtosPar(singPoints2, noSingPoints2, descriptors2, singPoints1, noSingPoints1, descriptors1, correspondences, &noCorr);
+			//Motion prior for the next frame.
+			ffme.setMotionPriorGrid(correspondences, noCorr);
+			//From now on the search window follows the motion of the previous frames, so a small radius is enough.
+			ffme.m_radMaxSearch = 16;
 
 			//Stops time counter.
 			timeMeasured = (double)cvGetTickCount() - timeMeasured;
@@ -185,10 +180,14 @@ int _tmain(int argc, _TCHAR* argv[])
 	}
 
 	
+	//Decode stalls: time the processing waited for the decoder.
+	printf("Decoded frames: %d, decode time: %.1f, stalls: %d, stall time: %.1f\n", source.getNoDecoded(), 
+		   source.getTimeDecode(), source.getNoStalls(), source.getTimeStall());
+
+	
 	//*************************************Release memory********************************************//
 	//Images.
-	//img1_U83C is managed by cvCaptured object.
-	cvReleaseImage(&img2_U81C);
+	//img2_U81C is managed by the video source.
 	cvReleaseImage(&img3_U83C);
 
 	//Data.
@@ -210,8 +209,8 @@ int _tmain(int argc, _TCHAR* argv[])
 	}
 	cvFree(&correspondences);
 
-	//Capture object.
-	cvReleaseCapture(&capture);
+	//Video source.
+	source.closeSource();
 
 	//Windows.
 	cvDestroyWindow( "MVF" );
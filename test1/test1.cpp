@@ -70,7 +70,10 @@ int _tmain(int argc, _TCHAR* argv[])
 	float** descriptors2;
 	int lengthDesc;
 	int noCorr;
+	float threshRatSecBest;
 	CvPoint2D32f** correspondences;
+	FFMEMatchResult* matchResult;
+	FFMECorrList* corrList;
 
 
 	//--Read images--//.
@@ -116,6 +119,8 @@ int _tmain(int argc, _TCHAR* argv[])
 	{
 		correspondences[i] = (CvPoint2D32f*)cvAlloc(2 * sizeof(CvPoint2D32f));
 	}
+	matchResult = createMatchResult(noMaxPoints);
+	corrList = createCorrList(noMaxPoints);
 
 	//Allocate memory for results.
 	img5_U81C = cvCreateImage(cvGetSize(img1_U81C), IPL_DEPTH_8U, 1);
@@ -165,14 +170,18 @@ int _tmain(int argc, _TCHAR* argv[])
 	cvWaitKey(0);
 	cvNamedWindow( "Gradient restriction points", 1 );
 	ffme.getNoGradPtos(&noGradPoints);
-	ffme.getGradPtos(&gradPoints);
+	gradPoints = (CvPoint2D32f*)cvAlloc(MAX(noGradPoints, 1) * sizeof(CvPoint2D32f));
+	ffme.getGradPtos(gradPoints);
 	drawPtosBW(img9_U81C, gradPoints, noGradPoints);
+	cvFree(&gradPoints);
 	cvShowImage( "Gradient restriction points", img9_U81C);
 	cvWaitKey(0);
 	cvNamedWindow( "Cornerness restriction points", 1 );
 	ffme.getNoCornerPtos(&noCornerPoints);
-	ffme.getCornerPtos(&cornerPoints);
+	cornerPoints = (CvPoint2D32f*)cvAlloc(MAX(noCornerPoints, 1) * sizeof(CvPoint2D32f));
+	ffme.getCornerPtos(cornerPoints);
 	drawPtosBW(img10_U81C, cornerPoints, noCornerPoints);
+	cvFree(&cornerPoints);
 	cvShowImage( "Cornerness restriction points", img10_U81C);
 	cvWaitKey(0);
 	cvNamedWindow( "Non-maximal supression and final singular point detection", 1 );
@@ -232,14 +241,18 @@ int _tmain(int argc, _TCHAR* argv[])
 	cvWaitKey(0);
 	cvNamedWindow( "Gradient restriction points", 1 );
 	ffme.getNoGradPtos(&noGradPoints);
-	ffme.getGradPtos(&gradPoints);
+	gradPoints = (CvPoint2D32f*)cvAlloc(MAX(noGradPoints, 1) * sizeof(CvPoint2D32f));
+	ffme.getGradPtos(gradPoints);
 	drawPtosBW(img9_U81C, gradPoints, noGradPoints);
+	cvFree(&gradPoints);
 	cvShowImage( "Gradient restriction points", img9_U81C);
 	cvWaitKey(0);
 	cvNamedWindow( "Cornerness restriction points", 1 );
 	ffme.getNoCornerPtos(&noCornerPoints);
-	ffme.getCornerPtos(&cornerPoints);
+	cornerPoints = (CvPoint2D32f*)cvAlloc(MAX(noCornerPoints, 1) * sizeof(CvPoint2D32f));
+	ffme.getCornerPtos(cornerPoints);
 	drawPtosBW(img10_U81C, cornerPoints, noCornerPoints);
+	cvFree(&cornerPoints);
 	cvShowImage( "Cornerness restriction points", img10_U81C);
 	cvWaitKey(0);
 	cvNamedWindow( "Non-maximal supression and final singular point detection", 1 );
@@ -291,6 +304,7 @@ int _tmain(int argc, _TCHAR* argv[])
 	cvWaitKey(0);
 
 	//Matching of singular points. Shows all correspondences without second nearest neighbor restriction.
+	threshRatSecBest = ffme.m_threshRatSecBest;
 	ffme.m_threshRatSecBest = 1;
 	ffme.matchSingPtos(singPoints1, noSingPoints1, descriptors1, singPoints2, noSingPoints2, descriptors2, correspondences, &noCorr);
 	printf("\nNumber of Corr: %d\n\n", noCorr);
@@ -300,6 +314,28 @@ int _tmain(int argc, _TCHAR* argv[])
 	cvNamedWindow( "Correspondences as MVF without restriction", 1 );
 	cvShowImage( "Correspondences as MVF without restriction", img12_U83C);
 	cvWaitKey(0);
+	ffme.m_threshRatSecBest = threshRatSecBest;
+
+
+	//Matching of singular points with a match result. The candidates are searched only once, and the restrictions are
+	//applied over them, so the correspondences are the ones of the previous matchings.
+	ffme.matchSingPtos(singPoints1, noSingPoints1, descriptors1, singPoints2, noSingPoints2, descriptors2, matchResult);
+	ffme.filterMatches(matchResult, singPoints1, singPoints2, noSingPoints2, ffme.m_threshRatSecBest, ffme.m_radMaxSearch, false, corrList);
+	printf("\nNumber of Corr (match result): %d\n\n", corrList->noCorr);
+	cvMerge(img2_U81C, img2_U81C, img2_U81C, NULL, img12_U83C);
+	drawCorrList(img12_U83C, corrList, singPoints1, singPoints2);
+	cvNamedWindow( "Correspondences as MVF (match result)", 1 );
+	cvShowImage( "Correspondences as MVF (match result)", img12_U83C);
+	cvWaitKey(0);
+
+	//Shows all correspondences without second nearest neighbor restriction. No new search is needed.
+	ffme.filterMatches(matchResult, singPoints1, singPoints2, noSingPoints2, 1, ffme.m_radMaxSearch, false, corrList);
+	printf("\nNumber of Corr (match result): %d\n\n", corrList->noCorr);
+	cvMerge(img2_U81C, img2_U81C, img2_U81C, NULL, img12_U83C);
+	drawCorrList(img12_U83C, corrList, singPoints1, singPoints2);
+	cvNamedWindow( "Correspondences as MVF without restriction (match result)", 1 );
+	cvShowImage( "Correspondences as MVF without restriction (match result)", img12_U83C);
+	cvWaitKey(0);
 	
 	//*************************************Release memory********************************************//
 	//Images.
@@ -333,6 +369,8 @@ int _tmain(int argc, _TCHAR* argv[])
 		cvFree(correspondences+i);
 	}
 	cvFree(&correspondences);
+	releaseMatchResult(&matchResult);
+	releaseCorrList(&corrList);
 
 	//Windows.
 	cvDestroyWindow( "Output1" );
@@ -347,6 +385,8 @@ int _tmain(int argc, _TCHAR* argv[])
 	cvDestroyWindow( "Singular points on an image 1" );
 	cvDestroyWindow( "Singular points on an image 2" );
 	cvDestroyWindow( "Correspondences as MVF without restriction" );
+	cvDestroyWindow( "Correspondences as MVF (match result)" );
+	cvDestroyWindow( "Correspondences as MVF without restriction (match result)" );
 	//***********************************************************************************************//
 
     return 0;
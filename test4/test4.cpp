@@ -0,0 +1,382 @@
+//-------------------------------------------------------------------------
+// test4.cpp
+//-------------------------------------------------------------------------
+// Description: validates the fixed-point integer pipeline of the FFME
+// class against the floating point reference. An image and a translated
+// and noisy copy are processed by both pipelines, and the detected points,
+// the descriptors and the correspondences are compared. The computation
+// time of both pipelines is also measured.
+//-------------------------------------------------------------------------
+// Requirements:
+// -OpenCV library.
+// -FFME library.
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+//OpenCV dependencies.
+#include "cv.h"
+#include "highgui.h"
+#include "cvaux.h"
+
+//Motion estimation class.
+#include "FFME.h"
+
+
+//--Function declaration--//
+// Warping the image using a pure translation transformation with bilinear interpolation.
+void transImg(IplImage* img1_U81C, IplImage* img2_U81C, float transHor, float transVer, CvMat* mat1_32F1C);
+// Computes the number of true correspondences between two array of points given the ground truth transformation.
+void evalCorr(CvPoint2D32f** correspondences, int noCorr, CvMat* mat1_32F1C, float dist, int* noTrueCorr);
+// Number of points of the first array that are also in the second one.
+int commonPtos(CvPoint2D32f* ptos1, int noPtos1, CvPoint2D32f* ptos2, int noPtos2, int* idx);
+// Number of correspondences of the first array that are also in the second one.
+int commonCorr(CvPoint2D32f** corr1, int noCorr1, CvPoint2D32f** corr2, int noCorr2);
+// Cosine similarity between a floating point descriptor and an integer one.
+float cosDesc(float* desc1, unsigned char* desc2, int length);
+
+
+//*****************************************Input*************************************************//
+//Image.
+const char* filename1 = "1.jpeg";
+//***********************************************************************************************//
+
+
+//*****************************************Parameters********************************************//
+//Geometric transformation.
+float transHor = 16; //Horizontal translation.
+float transVer = 16; //Vertical translation.
+
+//Gaussian noise parameters.
+int stdNoise = 3;
+
+//Estimation motion parameters.
+int noMaxPoints = 1000; //Maximum number of singular points.
+
+//Acceptance thresholds of the integer pipeline.
+float minRatioPtos = 0.95f; //Minimum ratio of the float points also detected by the integer pipeline.
+float minCosDesc = 0.99f; //Minimum average cosine similarity of the descriptors of the common points.
+float minRatioCorr = 0.90f; //Minimum ratio of the float correspondences also found by the integer pipeline.
+float minRatioTrueCorr = 0.95f; //Minimum ratio of true correspondences (integer over float).
+//***********************************************************************************************//
+
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	//--Declarations--//.
+	int i, j;
+	IplImage* img1_U81C = 0;
+	IplImage* img2_U81C = 0;
+	FFME ffme;
+	CvPoint2D32f* singPoints1;
+	CvPoint2D32f* singPoints2;
+	CvPoint2D32f* singPointsInt1;
+	CvPoint2D32f* singPointsInt2;
+	int noSingPoints1, noSingPoints2, noSingPointsInt1, noSingPointsInt2;
+	float** descriptors1;
+	float** descriptors2;
+	unsigned char** descriptorsInt1;
+	unsigned char** descriptorsInt2;
+	int* idxCommon;
+	int lengthDesc;
+	int noCorr, noCorrInt;
+	CvPoint2D32f** correspondences;
+	CvPoint2D32f** correspondencesInt;
+	CvMat* mat1_32F1C = cvCreateMat(2, 3, CV_32FC1);
+	int64 seed = -1;
+	CvRNG  randGen = cvRNG(seed);
+	CvMat* arrayGaussianNoise;
+	double timeFloat, timeInt;
+	int noTrueCorr, noTrueCorrInt, noCommonPtos, noCommonCorr;
+	float ratioPtos, avgCosDesc, ratioCorr, ratioTrueCorr;
+	bool pass;
+
+
+	//--Read images--//.
+	img1_U81C = cvLoadImage(filename1, CV_LOAD_IMAGE_GRAYSCALE);
+	if(!img1_U81C)
+	{
+		printf("The image can not be opened: %s\n", filename1);
+		return -1;
+	}
+
+
+	//--Initialization--//.
+	//Singular point locations.
+	singPoints1 = (CvPoint2D32f*)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f));
+	singPoints2 = (CvPoint2D32f*)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f));
+	singPointsInt1 = (CvPoint2D32f*)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f));
+	singPointsInt2 = (CvPoint2D32f*)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f));
+	idxCommon = (int*)cvAlloc(noMaxPoints * sizeof(int));
+	//FFME class initialization.
+	ffme.iniFFME(img1_U81C->width, img1_U81C->height, img1_U81C->origin, noMaxPoints);
+	//Singular point description.
+	lengthDesc = ffme.m_widthArrayHist*ffme.m_widthArrayHist*ffme.m_noBinsOriHist; //Length of descriptor vector.
+	descriptors1 = (float**)cvAlloc(noMaxPoints * sizeof(float*));
+	descriptors2 = (float**)cvAlloc(noMaxPoints * sizeof(float*));
+	descriptorsInt1 = (unsigned char**)cvAlloc(noMaxPoints * sizeof(unsigned char*));
+	descriptorsInt2 = (unsigned char**)cvAlloc(noMaxPoints * sizeof(unsigned char*));
+	for(i=0;i<noMaxPoints;i++)
+	{
+		descriptors1[i] = (float*)cvAlloc(lengthDesc * sizeof(float));
+		descriptors2[i] = (float*)cvAlloc(lengthDesc * sizeof(float));
+		descriptorsInt1[i] = (unsigned char*)cvAlloc(lengthDesc * sizeof(unsigned char));
+		descriptorsInt2[i] = (unsigned char*)cvAlloc(lengthDesc * sizeof(unsigned char));
+	}
+	//Correspondences.
+	correspondences = (CvPoint2D32f**)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f*));
+	correspondencesInt = (CvPoint2D32f**)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f*));
+	for(i=0;i<noMaxPoints;i++)
+	{
+		correspondences[i] = (CvPoint2D32f*)cvAlloc(2 * sizeof(CvPoint2D32f));
+		correspondencesInt[i] = (CvPoint2D32f*)cvAlloc(2 * sizeof(CvPoint2D32f));
+	}
+
+	//Second image: geometrical transformation and Gaussian noise.
+	img2_U81C = cvCreateImage(cvGetSize(img1_U81C), IPL_DEPTH_8U, 1);
+	img2_U81C->origin = img1_U81C->origin;
+	transImg(img1_U81C, img2_U81C, transHor, transVer, mat1_32F1C);
+	arrayGaussianNoise = cvCreateMat(img1_U81C->height, img1_U81C->width, CV_8UC1);
+	cvRandArr(&randGen, arrayGaussianNoise, CV_RAND_NORMAL, cvScalar(0), cvScalar(stdNoise));
+	cvAdd(img1_U81C, arrayGaussianNoise, img1_U81C, NULL);
+	cvAdd(img2_U81C, arrayGaussianNoise, img2_U81C, NULL);
+
+
+	//--Floating point reference--//.
+	timeFloat = (double)cvGetTickCount();
+	ffme.singPtoDetLut(img1_U81C, singPoints1, &noSingPoints1);
+	ffme.singPtoDescLut(singPoints1, noSingPoints1, descriptors1, true);
+	ffme.singPtoDetLut(img2_U81C, singPoints2, &noSingPoints2);
+	ffme.singPtoDescLut(singPoints2, noSingPoints2, descriptors2, true);
+	ffme.matchSingPtos(singPoints1, noSingPoints1, descriptors1, singPoints2, noSingPoints2, descriptors2, correspondences, &noCorr);
+	timeFloat = (double)cvGetTickCount() - timeFloat;
+
+
+	//--Integer pipeline--//.
+	timeInt = (double)cvGetTickCount();
+	ffme.singPtoDetInt(img1_U81C, singPointsInt1, &noSingPointsInt1);
+	ffme.singPtoDescInt(singPointsInt1, noSingPointsInt1, descriptorsInt1);
+	ffme.singPtoDetInt(img2_U81C, singPointsInt2, &noSingPointsInt2);
+	ffme.singPtoDescInt(singPointsInt2, noSingPointsInt2, descriptorsInt2);
+	ffme.matchSingPtosInt(singPointsInt1, noSingPointsInt1, descriptorsInt1, singPointsInt2, noSingPointsInt2, descriptorsInt2,
+		                  correspondencesInt, &noCorrInt);
+	timeInt = (double)cvGetTickCount() - timeInt;
+
+
+	//--Comparison--//.
+	//Detection.
+	noCommonPtos = commonPtos(singPoints1, noSingPoints1, singPointsInt1, noSingPointsInt1, idxCommon);
+	ratioPtos = (noSingPoints1 > 0)? (float)noCommonPtos / noSingPoints1 : 1;
+	//Description (common points of the first image).
+	avgCosDesc = 0;
+	for(i=0;i<noSingPoints1;i++)
+	{
+		j = idxCommon[i];
+		if(j != -1)
+		{
+			avgCosDesc += cosDesc(descriptors1[i], descriptorsInt1[j], lengthDesc);
+		}
+	}
+	avgCosDesc = (noCommonPtos > 0)? avgCosDesc / noCommonPtos : 1;
+	//Matching.
+	noCommonCorr = commonCorr(correspondences, noCorr, correspondencesInt, noCorrInt);
+	ratioCorr = (noCorr > 0)? (float)noCommonCorr / noCorr : 1;
+	evalCorr(correspondences, noCorr, mat1_32F1C, 1.5, &noTrueCorr);
+	evalCorr(correspondencesInt, noCorrInt, mat1_32F1C, 1.5, &noTrueCorrInt);
+	ratioTrueCorr = (noTrueCorr > 0)? (float)noTrueCorrInt / noTrueCorr : 1;
+
+
+	//Shows results.
+	printf("Number of points detected (float/integer/common): %d/%d/%d\n", noSingPoints1, noSingPointsInt1, noCommonPtos);
+	printf("Average cosine similarity of the descriptors: %.4f\n", avgCosDesc);
+	printf("Number of correspondences (float/integer/common): %d/%d/%d\n", noCorr, noCorrInt, noCommonCorr);
+	printf("Number of true correspondences (float/integer): %d/%d\n", noTrueCorr, noTrueCorrInt);
+	printf("Measured time (float/integer): %.1f/%.1f\n", timeFloat/(cvGetTickFrequency()*1000.),
+		   timeInt/(cvGetTickFrequency()*1000.));
+	pass = ratioPtos >= minRatioPtos && avgCosDesc >= minCosDesc && ratioCorr >= minRatioCorr && ratioTrueCorr >= minRatioTrueCorr;
+	printf("Integer pipeline: %s\n", pass? "PASS" : "FAIL");
+
+
+	//*************************************Release memory********************************************//
+	//Images.
+	cvReleaseImage(&img1_U81C);
+	cvReleaseImage(&img2_U81C);
+	cvReleaseMat(&mat1_32F1C);
+	cvReleaseMat(&arrayGaussianNoise);
+
+	//Data.
+	cvFree(&singPoints1);
+	cvFree(&singPoints2);
+	cvFree(&singPointsInt1);
+	cvFree(&singPointsInt2);
+	cvFree(&idxCommon);
+	for(i=0;i<noMaxPoints;i++)
+	{
+		cvFree(descriptors1+i);
+		cvFree(descriptors2+i);
+		cvFree(descriptorsInt1+i);
+		cvFree(descriptorsInt2+i);
+		cvFree(correspondences+i);
+		cvFree(correspondencesInt+i);
+	}
+	cvFree(&descriptors1);
+	cvFree(&descriptors2);
+	cvFree(&descriptorsInt1);
+	cvFree(&descriptorsInt2);
+	cvFree(&correspondences);
+	cvFree(&correspondencesInt);
+	//***********************************************************************************************//
+
+	return pass? 0 : 1;
+}
+
+
+//-----------------------------Private functions-----------------------------------------//
+
+/* Warping the image using a pure translation transformation with bilinear interpolation.
+   Pixels outside the image bounds are set to zero.
+   Inputs:
+   -img1_U81C: unsigned 8 bit 1 channel IplImage image to be translated.
+   -img2_U81C: (input/output)unsigned 8 bit 1 channel IplImage image translated.
+   -transHor: horizontal translation.
+   -transVer: vertical translation.
+   -mat1_32F1C: (input/output) 2x3 matrix. The function doesn't allocate memory.
+   Outputs: --
+*/
+void transImg(IplImage* img1_U81C, IplImage* img2_U81C, float transHor, float transVer, CvMat* mat1_32F1C)
+{
+	//2x3 geometric transformation initialization:
+	//|1 0 tx|  tx: horizontal translation.
+	//|0 1 ty|  ty: vertical translation.
+	elemMat32F1C_M(mat1_32F1C, 0, 0) = 1;
+	elemMat32F1C_M(mat1_32F1C, 0, 1) = 0;
+	elemMat32F1C_M(mat1_32F1C, 0, 2) = transHor;
+	elemMat32F1C_M(mat1_32F1C, 1, 0) = 0;
+	elemMat32F1C_M(mat1_32F1C, 1, 1) = 1;
+	elemMat32F1C_M(mat1_32F1C, 1, 2) = transVer;
+
+	//Image warping. Bilinear interpolation. Pixels outside the image bounds are set to zero.
+	cvWarpAffine(img1_U81C, img2_U81C, mat1_32F1C, CV_INTER_LINEAR+CV_WARP_FILL_OUTLIERS, cvScalarAll(0));
+}
+
+
+/* Computes the number of true correspondences given the ground truth transformation.
+   Inputs:
+   -correspondences: Nx2 array of correspondences.
+   -noCorr: number of correspondences.
+   -mat1_32F1C: 2x3 matrix storing the geometric transformation.
+   -dist: maximum distance allowed between points to be considered as true correspondence.
+   -noTrueCorr: (input/output) number of true correspondences.
+   Outputs: --
+*/
+void evalCorr(CvPoint2D32f** correspondences, int noCorr, CvMat* mat1_32F1C, float dist, int* noTrueCorr)
+{
+	int i;
+	float x, y, difx, dify;
+
+	*noTrueCorr = 0;
+	for(i=0;i<noCorr;i++)
+	{
+		//Application of the geometric transformation.
+		x = elemMat32F1C_M(mat1_32F1C, 0, 0)*correspondences[i][0].x + elemMat32F1C_M(mat1_32F1C, 0, 1)*correspondences[i][0].y +
+			elemMat32F1C_M(mat1_32F1C, 0, 2);
+		y = elemMat32F1C_M(mat1_32F1C, 1, 0)*correspondences[i][0].x + elemMat32F1C_M(mat1_32F1C, 1, 1)*correspondences[i][0].y +
+			elemMat32F1C_M(mat1_32F1C, 1, 2);
+
+		//Checks if the correspondence is true.
+		difx = x - correspondences[i][1].x;
+		dify = y - correspondences[i][1].y;
+		if(sqrt(difx * difx + dify * dify) <= dist)
+		{
+			(*noTrueCorr)++;
+		}
+	}
+}
+
+
+/* Number of points of the first array that are also in the second one (same location).
+   Inputs:
+   -ptos1: array of points.
+   -noPtos1: number of points of the first array.
+   -ptos2: array of points.
+   -noPtos2: number of points of the second array.
+   -idx: (input/output) index of each point of the first array in the second one (-1 if it is not found). The function
+    doesn't allocate memory.
+   Outputs: number of common points.
+*/
+int commonPtos(CvPoint2D32f* ptos1, int noPtos1, CvPoint2D32f* ptos2, int noPtos2, int* idx)
+{
+	int i, j, noCommon = 0;
+
+	for(i=0;i<noPtos1;i++)
+	{
+		idx[i] = -1;
+		for(j=0;j<noPtos2;j++)
+		{
+			if(ptos1[i].x == ptos2[j].x && ptos1[i].y == ptos2[j].y)
+			{
+				idx[i] = j;
+				noCommon++;
+				break;
+			}
+		}
+	}
+	return noCommon;
+}
+
+
+/* Number of correspondences of the first array that are also in the second one.
+   Inputs:
+   -corr1: Nx2 array of correspondences.
+   -noCorr1: number of correspondences of the first array.
+   -corr2: Nx2 array of correspondences.
+   -noCorr2: number of correspondences of the second array.
+   Outputs: number of common correspondences.
+*/
+int commonCorr(CvPoint2D32f** corr1, int noCorr1, CvPoint2D32f** corr2, int noCorr2)
+{
+	int i, j, noCommon = 0;
+
+	for(i=0;i<noCorr1;i++)
+	{
+		for(j=0;j<noCorr2;j++)
+		{
+			if(corr1[i][0].x == corr2[j][0].x && corr1[i][0].y == corr2[j][0].y &&
+			   corr1[i][1].x == corr2[j][1].x && corr1[i][1].y == corr2[j][1].y)
+			{
+				noCommon++;
+				break;
+			}
+		}
+	}
+	return noCommon;
+}
+
+
+/* Cosine similarity between a floating point descriptor and an integer one.
+   Inputs:
+   -desc1: floating point descriptor.
+   -desc2: integer descriptor.
+   -length: length of the descriptors.
+   Outputs: cosine similarity (1 if any of the descriptors is null).
+*/
+float cosDesc(float* desc1, unsigned char* desc2, int length)
+{
+	int i;
+	float dot = 0, norm1 = 0, norm2 = 0;
+
+	for(i=0;i<length;i++)
+	{
+		dot += desc1[i] * desc2[i];
+		norm1 += desc1[i] * desc1[i];
+		norm2 += (float)desc2[i] * desc2[i];
+	}
+	if(norm1 == 0 || norm2 == 0)
+	{
+		return 1;
+	}
+	return dot / sqrt(norm1 * norm2);
+}
@@ -0,0 +1,535 @@
+//-------------------------------------------------------------------------
+// test5.cpp
+//-------------------------------------------------------------------------
+// Description: speed and accuracy regression test of the FFME class. The
+// sample images are transformed by a sweep of translations, rotations
+// and scales, and corrupted by Gaussian noise of several levels. For each
+// configuration the whole pipeline (detection, description and matching)
+// is run in every mode: functions, LUT, integer, bands, quick rejection,
+// flat region pre-rejection and decimation, and the LUT features are also
+// matched with the fast paths of the matching (parallel, cross-check,
+// global and restrictions over a match result). The number of points, the
+// number of correspondences, the rate of true correspondences and the time
+// of each stage (median of several runs, measured by the instrumentation
+// of the class) are written to a CSV report, one row per configuration
+// and mode. It doesn't need user interaction.
+//-------------------------------------------------------------------------
+// Requirements:
+// -OpenCV library.
+// -FFME library (compiled without FFME_NO_STATS).
+//-------------------------------------------------------------------------
+// Author: Grupo de Tratamiento de Imagenes, GTI SSR, Madrid
+// Version 1.0
+//-------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+//OpenCV dependencies.
+#include "cv.h"
+#include "highgui.h"
+#include "cvaux.h"
+
+//Motion estimation class.
+#include "FFME.h"
+
+#ifndef FFME_STATS
+#error "test5 needs the instrumentation of the FFME class (FFME_NO_STATS must not be defined)."
+#endif
+
+
+//Modes of the pipeline.
+#define MODE_FUNC 0 //Detection and description based on functions.
+#define MODE_LUT 1 //Detection and description based on LUT.
+#define MODE_INT 2 //Integer pipeline.
+#define MODE_BAND 3 //Detection by bands and description based on LUT.
+#define MODE_PRE_FILTER 4 //LUT with quick rejection of the candidate points.
+#define MODE_FLAT_TILES 5 //LUT with flat region pre-rejection.
+#define MODE_DECIMATION 6 //LUT over the images decimated by 2.
+#define MODE_PAR 7 //LUT with the matching distributed among several threads.
+#define MODE_CROSS 8 //LUT with the mutual nearest neighbor restriction (cross-check).
+#define MODE_GLOBAL 9 //LUT with the global matching (without search radius).
+#define MODE_MATCH_RESULT 10 //LUT with the restrictions applied over a match result.
+#define NO_MODES 11
+
+
+//--Function declaration--//
+// Warping the image using a rotation, scale and translation transformation with bilinear interpolation.
+void affineImg(IplImage* img1_U81C, IplImage* img2_U81C, float angle, float scale, float transHor, float transVer,
+			   CvMat* mat1_32F1C);
+// Gaussian noise addition.
+void addNoise(IplImage* img_U81C, int stdNoise, CvRNG* randGen);
+// Configuration of the FFME object for a mode of the pipeline.
+void setMode(FFME* ffme, int mode);
+// Singular point detection and description in a mode of the pipeline.
+void detDesc(FFME* ffme, int mode, IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos, float** descriptors,
+			 unsigned char** descriptorsInt);
+// Singular point matching in a mode of the pipeline.
+void match(FFME* ffme, int mode, CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1,
+		   unsigned char** descriptorsInt1, CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2,
+		   unsigned char** descriptorsInt2, FFMEMatchResult* matchResult, FFMECorrList* corrList,
+		   CvPoint2D32f** correspondences, int* noCorr);
+// Computes the number of true correspondences given the ground truth transformation.
+void evalCorr(CvPoint2D32f** correspondences, int noCorr, CvMat* mat1_32F1C, float dist, int* noTrueCorr);
+// Euclidean distance between points.
+float euclDistPtos(CvPoint2D32f* pto1, CvPoint2D32f* pto2);
+
+
+//*****************************************Input*************************************************//
+//Images.
+const char* filenames[] = {"1.jpeg", "2.jpeg"};
+int noImages = 2;
+//***********************************************************************************************//
+
+
+//*****************************************Output************************************************//
+//Report.
+const char* filenameReport = "test5.csv";
+//***********************************************************************************************//
+
+
+//*****************************************Parameters********************************************//
+//Geometric transformations (rotation and scale around the center of the image, followed by a translation).
+float angles[] = {0, 0, 0, 5, 10, 0, 0}; //Rotation angle in degrees.
+float scales[] = {1, 1, 1, 1, 1, 0.9f, 1.1f}; //Scale.
+float transHors[] = {2.5f, 8, 16, 0, 0, 0, 0}; //Horizontal translation.
+float transVers[] = {1.5f, 4, 16, 0, 0, 0, 0}; //Vertical translation.
+int noTransforms = 7;
+
+//Gaussian noise parameters.
+int stdNoises[] = {0, 3, 6};
+int noNoises = 3;
+
+//Estimation motion parameters.
+int noMaxPoints = 2000; //Maximum number of singular points.
+bool motionPrior = true; //The ground truth transformation is used as motion prior, so the search radius is not exceeded
+                         //and the matching is only limited by the descriptors (except in the global matching, which
+                         //doesn't use it).
+
+//Evaluation parameters.
+float distTrueCorr = 1.5; //Maximum distance to the transformed point to be considered as true correspondence.
+int noRuns = 5; //Number of runs of each configuration (the time of the stages is the median).
+
+//Names of the modes.
+const char* modeNames[] = {"Func", "LUT", "Int", "Band", "PreFilter", "FlatTiles", "Decimation2", "Par", "Cross",
+						   "Global", "MatchResult"};
+//Names of the timed stages.
+const char* stageNames[] = {"gradient", "gradMag", "gradMagThresh", "cornerThresh", "nonMinSup", "detection",
+							"gradPhase", "orientHist", "description", "matching"};
+//***********************************************************************************************//
+
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	//--Declarations--//.
+	int i, j, k, t, n, mode;
+	IplImage* img1_U81C;
+	IplImage* img2_U81C;
+	IplImage* imgNoise1_U81C;
+	IplImage* imgNoise2_U81C;
+	FFME ffme;
+	FFMEStats* stats;
+	CvPoint2D32f* singPoints1;
+	CvPoint2D32f* singPoints2;
+	int noSingPoints1;
+	int noSingPoints2;
+	float** descriptors1;
+	float** descriptors2;
+	unsigned char** descriptorsInt1;
+	unsigned char** descriptorsInt2;
+	int lengthDesc;
+	int noCorr;
+	CvPoint2D32f** correspondences;
+	FFMEMatchResult* matchResult;
+	FFMECorrList* corrList;
+	CvMat* mat1_32F1C = cvCreateMat(2, 3, CV_32FC1);
+	float affine[6];
+	int64 seed = -1;
+	CvRNG  randGen = cvRNG(seed);
+	int noTrueCorr;
+	FILE* report;
+	bool ini = false;
+
+
+	//--Initialization--//.
+	report = fopen(filenameReport, "w");
+	if(!report)
+	{
+		printf("The report can not be created: %s\n", filenameReport);
+		return -1;
+	}
+	fprintf(report, "image,width,height,angle,scale,transHor,transVer,stdNoise,mode,noPoints1,noPoints2,noCorr,noTrueCorr,"
+		    "trueCorrRate,noGradPtos,noCornerPtos,noMatched");
+	for(k=0;k<NO_STATS_STAGES;k++)
+	{
+		fprintf(report, ",%s(ms)", stageNames[k]);
+	}
+	fprintf(report, "\n");
+
+	//Singular point locations.
+	singPoints1 = (CvPoint2D32f*)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f));
+	singPoints2 = (CvPoint2D32f*)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f));
+	//Singular point description (floating point and integer descriptors).
+	lengthDesc = WIDTH_ARRAY_HIST*WIDTH_ARRAY_HIST*NO_BINS_ORI_HIST; //Length of descriptor vector.
+	descriptors1 = (float**)cvAlloc(noMaxPoints * sizeof(float*));
+	descriptors2 = (float**)cvAlloc(noMaxPoints * sizeof(float*));
+	descriptorsInt1 = (unsigned char**)cvAlloc(noMaxPoints * sizeof(unsigned char*));
+	descriptorsInt2 = (unsigned char**)cvAlloc(noMaxPoints * sizeof(unsigned char*));
+	for(i=0;i<noMaxPoints;i++)
+	{
+		descriptors1[i] = (float*)cvAlloc(lengthDesc * sizeof(float));
+		descriptors2[i] = (float*)cvAlloc(lengthDesc * sizeof(float));
+		descriptorsInt1[i] = (unsigned char*)cvAlloc(lengthDesc * sizeof(unsigned char));
+		descriptorsInt2[i] = (unsigned char*)cvAlloc(lengthDesc * sizeof(unsigned char));
+	}
+	//Correspondences.
+	correspondences = (CvPoint2D32f**)cvAlloc(noMaxPoints * sizeof(CvPoint2D32f*));
+	for(i=0;i<noMaxPoints;i++)
+	{
+		correspondences[i] = (CvPoint2D32f*)cvAlloc(2 * sizeof(CvPoint2D32f));
+	}
+	matchResult = createMatchResult(noMaxPoints);
+	corrList = createCorrList(noMaxPoints);
+
+
+	for(i=0;i<noImages;i++)
+	{
+		//--Read images--//.
+		img1_U81C = cvLoadImage(filenames[i], CV_LOAD_IMAGE_GRAYSCALE);
+		if(!img1_U81C)
+		{
+			printf("The image can not be opened: %s\n", filenames[i]);
+			continue;
+		}
+		img2_U81C = cvCreateImage(cvGetSize(img1_U81C), IPL_DEPTH_8U, 1);
+		img2_U81C->origin = img1_U81C->origin;
+		imgNoise1_U81C = cvCreateImage(cvGetSize(img1_U81C), IPL_DEPTH_8U, 1);
+		imgNoise1_U81C->origin = img1_U81C->origin;
+		imgNoise2_U81C = cvCreateImage(cvGetSize(img1_U81C), IPL_DEPTH_8U, 1);
+		imgNoise2_U81C->origin = img1_U81C->origin;
+
+		//FFME class initialization (the memory is reused if the image is not bigger).
+		if(!ini)
+		{
+			ffme.iniFFME(img1_U81C->width, img1_U81C->height, img1_U81C->origin, noMaxPoints);
+			ini = true;
+		}
+		else
+		{
+			ffme.reconfigureFFME(img1_U81C->width, img1_U81C->height, img1_U81C->origin, noMaxPoints);
+		}
+
+		for(t=0;t<noTransforms;t++)
+		{
+			//Geometrical transformation.
+			affineImg(img1_U81C, img2_U81C, angles[t], scales[t], transHors[t], transVers[t], mat1_32F1C);
+			for(k=0;k<6;k++)
+			{
+				affine[k] = elemMat32F1C_M(mat1_32F1C, k/3, k%3);
+			}
+
+			for(n=0;n<noNoises;n++)
+			{
+				//Gaussian noise (different for each image).
+				cvCopy(img1_U81C, imgNoise1_U81C);
+				cvCopy(img2_U81C, imgNoise2_U81C);
+				addNoise(imgNoise1_U81C, stdNoises[n], &randGen);
+				addNoise(imgNoise2_U81C, stdNoises[n], &randGen);
+
+				for(mode=0;mode<NO_MODES;mode++)
+				{
+					//--Pipeline--//.
+					setMode(&ffme, mode);
+					//The motion prior is set after the mode, since the change of decimation resets it.
+					if(motionPrior)
+					{
+						ffme.setMotionPriorAffine(affine);
+					}
+					else
+					{
+						ffme.resetMotionPrior();
+					}
+					stats = ffme.getStats();
+					stats->resetStats();
+					for(j=0;j<noRuns;j++)
+					{
+						detDesc(&ffme, mode, imgNoise1_U81C, singPoints1, &noSingPoints1, descriptors1, descriptorsInt1);
+						detDesc(&ffme, mode, imgNoise2_U81C, singPoints2, &noSingPoints2, descriptors2, descriptorsInt2);
+						match(&ffme, mode, singPoints1, noSingPoints1, descriptors1, descriptorsInt1, singPoints2,
+							  noSingPoints2, descriptors2, descriptorsInt2, matchResult, corrList, correspondences, &noCorr);
+					}
+
+					//Tests correspondences.
+					evalCorr(correspondences, noCorr, mat1_32F1C, distTrueCorr, &noTrueCorr);
+
+					//--Report--//.
+					fprintf(report, "%s,%d,%d,%g,%g,%g,%g,%d,%s,%d,%d,%d,%d,%.4f,%d,%d,%d", filenames[i], img1_U81C->width,
+						    img1_U81C->height, angles[t], scales[t], transHors[t], transVers[t], stdNoises[n],
+							modeNames[mode], noSingPoints1, noSingPoints2, noCorr, noTrueCorr,
+							(noCorr > 0)? (float)noTrueCorr/noCorr : 0.f, stats->getFunnel(FUNNEL_GRADIENT),
+							stats->getFunnel(FUNNEL_CORNERNESS), stats->getFunnel(FUNNEL_MATCHED));
+					for(k=0;k<NO_STATS_STAGES;k++)
+					{
+						fprintf(report, ",%.3f", stats->getPercentile(k, 50));
+					}
+					fprintf(report, "\n");
+					fflush(report);
+
+					printf("%s angle %g scale %g trans (%g,%g) noise %d %-12s points %4d corr %4d true %4d time %.1f ms\n",
+						   filenames[i], angles[t], scales[t], transHors[t], transVers[t], stdNoises[n], modeNames[mode],
+						   noSingPoints1, noCorr, noTrueCorr, 2*stats->getPercentile(STATS_DETECTION, 50) +
+						   2*stats->getPercentile(STATS_DESCRIPTION, 50) + stats->getPercentile(STATS_MATCHING, 50));
+				}
+			}
+		}
+
+		cvReleaseImage(&img1_U81C);
+		cvReleaseImage(&img2_U81C);
+		cvReleaseImage(&imgNoise1_U81C);
+		cvReleaseImage(&imgNoise2_U81C);
+	}
+
+
+	//*************************************Release memory********************************************//
+	fclose(report);
+	cvReleaseMat(&mat1_32F1C);
+	cvFree(&singPoints1);
+	cvFree(&singPoints2);
+	for(i=0;i<noMaxPoints;i++)
+	{
+		cvFree(descriptors1+i);
+		cvFree(descriptors2+i);
+		cvFree(descriptorsInt1+i);
+		cvFree(descriptorsInt2+i);
+		cvFree(correspondences+i);
+	}
+	cvFree(&descriptors1);
+	cvFree(&descriptors2);
+	cvFree(&descriptorsInt1);
+	cvFree(&descriptorsInt2);
+	cvFree(&correspondences);
+	releaseMatchResult(&matchResult);
+	releaseCorrList(&corrList);
+	//***********************************************************************************************//
+
+	return 0;
+}
+
+
+//-----------------------------Private functions-----------------------------------------//
+
+/* Warping the image using a rotation and scale transformation around the center of the image followed by a translation,
+   with bilinear interpolation. Pixels outside the image bounds are set to zero.
+   Inputs:
+   -img1_U81C: unsigned 8 bit 1 channel IplImage image to be transformed.
+   -img2_U81C: (input/output)unsigned 8 bit 1 channel IplImage image transformed.
+   -angle: rotation angle in degrees.
+   -scale: scale.
+   -transHor: horizontal translation.
+   -transVer: vertical translation.
+   -mat1_32F1C: (input/output) 2x3 matrix of the transformation. The function doesn't allocate memory.
+   Outputs: --
+*/
+void affineImg(IplImage* img1_U81C, IplImage* img2_U81C, float angle, float scale, float transHor, float transVer,
+			   CvMat* mat1_32F1C)
+{
+	CvPoint2D32f center = cvPoint2D32f(img1_U81C->width/2.0f, img1_U81C->height/2.0f);
+
+	//2x3 geometric transformation initialization:
+	//|s*cos()  s*sin()  tx'|  tx' = tx + horizontal translation of the rotation around the center.
+	//|-s*sin() s*cos()  ty'|  ty' = ty + vertical translation of the rotation around the center.
+	cv2DRotationMatrix(center, angle, scale, mat1_32F1C);
+	elemMat32F1C_M(mat1_32F1C, 0, 2) += transHor;
+	elemMat32F1C_M(mat1_32F1C, 1, 2) += transVer;
+
+	//Image warping. Bilinear interpolation. Pixels outside the image bounds are set to zero.
+	cvWarpAffine(img1_U81C, img2_U81C, mat1_32F1C, CV_INTER_LINEAR+CV_WARP_FILL_OUTLIERS, cvScalarAll(0));
+}
+
+
+/* Gaussian noise addition.
+   Inputs:
+   -img_U81C: (input/output) unsigned 8 bit 1 channel image.
+   -stdNoise: standard deviation of the noise (no noise is added if it is zero).
+   -randGen: random number generator.
+   Outputs: --
+*/
+void addNoise(IplImage* img_U81C, int stdNoise, CvRNG* randGen)
+{
+	CvMat* arrayGaussianNoise;
+
+	if(stdNoise <= 0)
+	{
+		return;
+	}
+	arrayGaussianNoise = cvCreateMat(img_U81C->height, img_U81C->width, CV_8UC1);
+	cvRandArr(randGen, arrayGaussianNoise, CV_RAND_NORMAL, cvScalar(0), cvScalar(stdNoise));
+	cvAdd(img_U81C, arrayGaussianNoise, img_U81C, NULL);
+	cvReleaseMat(&arrayGaussianNoise);
+}
+
+
+/* Configuration of the FFME object for a mode of the pipeline. The options of the rest of modes are disabled. The
+   decimation factor is only changed if it is different, since the change reconfigures the object and resets the
+   motion prior.
+   Inputs:
+   -ffme: (input/output) initialized FFME object.
+   -mode: mode of the pipeline (MODE_XXX).
+   Outputs: --
+*/
+void setMode(FFME* ffme, int mode)
+{
+	int decimation = (mode == MODE_DECIMATION)? 2 : 1;
+
+	if(ffme->getDecimation() != decimation)
+	{
+		ffme->setDecimation(decimation);
+	}
+	ffme->setPreFilterParam(mode == MODE_PRE_FILTER, PRE_FILTER_FACTOR);
+	ffme->setFlatTileParam(mode == MODE_FLAT_TILES, WIDTH_TILE_FLAT);
+}
+
+
+/* Singular point detection and description in a mode of the pipeline.
+   Inputs:
+   -ffme: initialized FFME object configured for the mode (see 'setMode()').
+   -mode: mode of the pipeline (MODE_XXX).
+   -img_U81C: unsigned 8 bit input image.
+   -singPtos: (input/output) array of detected singular points. The function doesn't reserve memory.
+   -noSingPtos: (input/output) number of detected singular points.
+   -descriptors: (input/output) array of floating point descriptors (all the modes except MODE_INT).
+   -descriptorsInt: (input/output) array of integer descriptors (MODE_INT).
+   Outputs: --
+*/
+void detDesc(FFME* ffme, int mode, IplImage* img_U81C, CvPoint2D32f* singPtos, int* noSingPtos, float** descriptors,
+			 unsigned char** descriptorsInt)
+{
+	switch(mode)
+	{
+	case MODE_FUNC:
+		ffme->singPtoDetFunc(img_U81C, singPtos, noSingPtos);
+		ffme->singPtoDescFunc(singPtos, *noSingPtos, descriptors, true);
+		break;
+	case MODE_INT:
+		ffme->singPtoDetInt(img_U81C, singPtos, noSingPtos);
+		ffme->singPtoDescInt(singPtos, *noSingPtos, descriptorsInt);
+		break;
+	case MODE_BAND:
+		ffme->singPtoDetBand(img_U81C, singPtos, noSingPtos);
+		ffme->singPtoDescLut(singPtos, *noSingPtos, descriptors, true);
+		break;
+	default:
+		ffme->singPtoDetLut(img_U81C, singPtos, noSingPtos);
+		ffme->singPtoDescLut(singPtos, *noSingPtos, descriptors, true);
+		break;
+	}
+}
+
+
+/* Singular point matching in a mode of the pipeline. The correspondences of the match result mode are filtered with
+   the matching parameters of the object, so they are the ones of 'matchSingPtos()'.
+   Inputs:
+   -ffme: initialized FFME object configured for the mode (see 'setMode()').
+   -mode: mode of the pipeline (MODE_XXX).
+   -singPtos1: array of singular points of the first image.
+   -noSingPtos1: number of singular points of the first image.
+   -descriptors1: array of floating point descriptors of the first image (all the modes except MODE_INT).
+   -descriptorsInt1: array of integer descriptors of the first image (MODE_INT).
+   -singPtos2: array of singular points of the second image.
+   -noSingPtos2: number of singular points of the second image.
+   -descriptors2: array of floating point descriptors of the second image (all the modes except MODE_INT).
+   -descriptorsInt2: array of integer descriptors of the second image (MODE_INT).
+   -matchResult: (input/output) match result (MODE_MATCH_RESULT).
+   -corrList: (input/output) list of correspondences (MODE_MATCH_RESULT).
+   -correspondences: (input/output) Nx2 array of correspondences.
+   -noCorr: (input/output) number of correspondences.
+   Outputs: --
+*/
+void match(FFME* ffme, int mode, CvPoint2D32f* singPtos1, int noSingPtos1, float** descriptors1,
+		   unsigned char** descriptorsInt1, CvPoint2D32f* singPtos2, int noSingPtos2, float** descriptors2,
+		   unsigned char** descriptorsInt2, FFMEMatchResult* matchResult, FFMECorrList* corrList,
+		   CvPoint2D32f** correspondences, int* noCorr)
+{
+	int i;
+
+	switch(mode)
+	{
+	case MODE_INT:
+		ffme->matchSingPtosInt(singPtos1, noSingPtos1, descriptorsInt1, singPtos2, noSingPtos2, descriptorsInt2,
+							   correspondences, noCorr);
+		break;
+	case MODE_PAR:
+		ffme->matchSingPtosPar(singPtos1, noSingPtos1, descriptors1, singPtos2, noSingPtos2, descriptors2,
+							   correspondences, noCorr);
+		break;
+	case MODE_CROSS:
+		ffme->matchSingPtosCross(singPtos1, noSingPtos1, descriptors1, singPtos2, noSingPtos2, descriptors2,
+								 correspondences, noCorr);
+		break;
+	case MODE_GLOBAL:
+		ffme->matchSingPtosGlobal(singPtos1, noSingPtos1, descriptors1, singPtos2, noSingPtos2, descriptors2,
+								  correspondences, noCorr);
+		break;
+	case MODE_MATCH_RESULT:
+		ffme->matchSingPtos(singPtos1, noSingPtos1, descriptors1, singPtos2, noSingPtos2, descriptors2, matchResult);
+		ffme->filterMatches(matchResult, singPtos1, singPtos2, noSingPtos2, ffme->m_threshRatSecBest,
+							ffme->m_radMaxSearch, false, corrList);
+		for(i=0;i<corrList->noCorr;i++)
+		{
+			correspondences[i][0] = singPtos1[corrList->idx1[i]];
+			correspondences[i][1] = singPtos2[corrList->idx2[i]];
+		}
+		*noCorr = corrList->noCorr;
+		break;
+	default:
+		ffme->matchSingPtos(singPtos1, noSingPtos1, descriptors1, singPtos2, noSingPtos2, descriptors2,
+							correspondences, noCorr);
+		break;
+	}
+}
+
+
+/* Computes the number of true correspondences given the ground truth transformation.
+   Inputs:
+   -correspondences: Nx2 array of correspondences.
+   -noCorr: number of correspondences.
+   -mat1_32F1C: 2x3 matrix storing the geometric transformation.
+   -dist: maximum distance allowed between points to be considered as true correspondence.
+   -noTrueCorr: (input/output) number of true correspondences.
+   Outputs: --
+*/
+void evalCorr(CvPoint2D32f** correspondences, int noCorr, CvMat* mat1_32F1C, float dist, int* noTrueCorr)
+{
+	int i;
+	CvPoint2D32f pto3;
+
+	*noTrueCorr = 0;
+
+	for(i=0;i<noCorr;i++)
+	{
+		//Application of the geometric transformation.
+		pto3.x = elemMat32F1C_M(mat1_32F1C, 0, 0) * correspondences[i][0].x +
+			     elemMat32F1C_M(mat1_32F1C, 0, 1) * correspondences[i][0].y + elemMat32F1C_M(mat1_32F1C, 0, 2);
+		pto3.y = elemMat32F1C_M(mat1_32F1C, 1, 0) * correspondences[i][0].x +
+			     elemMat32F1C_M(mat1_32F1C, 1, 1) * correspondences[i][0].y + elemMat32F1C_M(mat1_32F1C, 1, 2);
+
+		//Checks if the correspondence is true.
+		if(euclDistPtos(&pto3, &correspondences[i][1]) <= dist)
+		{
+			(*noTrueCorr)++;
+		}
+	}
+}
+
+
+/* Euclidean distance between points.
+   Inputs:
+   -pto1: point.
+   -pto2: point.
+   Outputs: Euclidean distance.
+*/
+float euclDistPtos(CvPoint2D32f* pto1, CvPoint2D32f* pto2)
+{
+	float difx = (pto1->x - pto2->x);
+	float dify = (pto1->y - pto2->y);
+	return sqrt(difx * difx + dify * dify);
+}